@@ -33,6 +33,7 @@
 
 #include "sgx_utls.h"
 #include <string.h>
+#include <set>
 
 #include <openssl/bio.h>
 #include <openssl/err.h>
@@ -56,31 +57,92 @@ int verify_callback(int preverify_ok, X509_STORE_CTX* ctx);
 int create_socket(char* server_name, char* server_port);
 
 std::string client_session_id;
+WireFormat client_wire_format = WireFormat::JSON;   // encoding of transactions, negotiated in /get_session_id
+uint64_t client_session_tx_id = 0;                  // last per-session sequence number, echoed by the server in the response
+
+// The maximum number of outstanding transactions of /pipeline.
+// NOTE: must not exceed SESSION_TX_ID_WINDOW of the server, otherwise late requests are rejected as replays.
+#define PIPELINE_MAX_OUTSTANDING 1024
 
 /**
- * @brief Send data to the server.
- * @param data Data to send.
- * @param data_size Size of data.
+ * @brief Send data to the server without waiting for the response.
+ * @param data_str Data to send.
 */
-void send_data(SSL *ssl_session, const char *data, size_t data_size) {
-    std::string data_str(reinterpret_cast<const char*>(data), data_size);
-    std::cout << LOG_INFO "Send data to server: " << data_str << std::endl;
+void send_request(SSL *ssl_session, const std::string &data_str) {
+    if (is_binary_request(data_str)) {
+        std::cout << LOG_INFO "Send data to server: (binary, " << data_str.size() << " bytes)" << std::endl;
+    } else {
+        std::cout << LOG_INFO "Send data to server: " << data_str << std::endl;
+    }
     tls_write_to_session_peer(ssl_session, data_str);
+}
 
-    // ここで受け取るのは適切じゃないけどテストということで
+/**
+ * @brief Receive one response from the server and print it.
+ * @param is_session_id_response true if the response is the reply to /get_session_id.
+ * @return The session_tx_id echoed by the server, 0 if the response does not carry one.
+*/
+uint64_t receive_response(SSL *ssl_session, bool is_session_id_response) {
     std::string response;
     tls_read_from_session_peer(ssl_session, response);
 
-    // handle if reveiced data is command
-    std::string command;
-    std::istringstream iss(data_str);
-    std::getline(iss, command, ' ');    // get first token
-    if (command == "/get_session_id") {
+    if (is_session_id_response) {
         std::cout << LOG_INFO "Session ID: " << BGRN << response << CRESET << std::endl;
         client_session_id = response;
+        client_session_tx_id = 0;
+        return 0;
+    }
+
+    nlohmann::json response_json;
+    if (is_binary_response(response)) {
+        response_json = binary_response_to_json(response);
+        std::cout << LOG_INFO "Response from server: " << response_json.dump() << std::endl;
     } else {
+        response_json = nlohmann::json::parse(response, nullptr, false);
         std::cout << LOG_INFO "Response from server: " << response << std::endl;
     }
+
+    // echoed per-session sequence number (absent if the request was not pipelined)
+    if (response_json.is_object() && response_json.contains("session_tx_id") && response_json["session_tx_id"].is_number_unsigned()) {
+        return response_json["session_tx_id"].get<uint64_t>();
+    }
+    return 0;
+}
+
+/**
+ * @brief Send data to the server and wait for the response.
+ * @param data Data to send.
+ * @param data_size Size of data.
+*/
+void send_data(SSL *ssl_session, const char *data, size_t data_size) {
+    std::string data_str(reinterpret_cast<const char*>(data), data_size);
+    send_request(ssl_session, data_str);
+
+    // handle if reveiced data is command
+    std::string command;
+    std::istringstream iss(data_str);
+    std::getline(iss, command, ' ');    // get first token
+    receive_response(ssl_session, command == "/get_session_id");
+}
+
+/**
+ * @brief Encode a transaction in the negotiated wire format.
+ * @param operations operations of the transaction.
+ * @note Every transaction gets the next per-session sequence number (session_tx_id),
+ *       so that several transactions can be outstanding at the same time.
+*/
+std::string encode_transaction(const std::vector<std::string> &operations) {
+    // create timestamp
+    timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    long int timestamp_sec = ts.tv_sec;
+    long int timestamp_nsec = ts.tv_nsec;
+
+    uint64_t session_tx_id = ++client_session_tx_id;
+    if (client_wire_format == WireFormat::BINARY) {
+        return parse_command_binary(timestamp_sec, timestamp_nsec, client_session_id, session_tx_id, operations);
+    }
+    return parse_command(timestamp_sec, timestamp_nsec, client_session_id, session_tx_id, operations).dump();
 }
 
 /**
@@ -97,6 +159,10 @@ void request_session_id(SSL *ssl_session) {
     long int timestamp_nsec = ts.tv_nsec;
 
     std::string command = std::string("/get_session_id") + " " + std::to_string(timestamp_sec) + " " + std::to_string(timestamp_nsec);
+    if (client_wire_format == WireFormat::BINARY) {
+        // request binary encoded responses
+        command += std::string(" ") + BINARY_PROTOCOL_NEGOTIATION_TOKEN;
+    }
 
     // send the command to the server
     send_data(ssl_session, command.c_str(), command.length());
@@ -167,20 +233,11 @@ void handle_command(SSL *ssl_session) {
 
                 // check if the transaction has at least 1 operation (except BEGIN_TRANSACTION and END_TRANSACTION)
                 if (operations.size() > 0) {
-                    // create timestamp
-                    timespec ts;
-                    clock_gettime(CLOCK_REALTIME, &ts);
-                    long int timestamp_sec = ts.tv_sec;
-                    long int timestamp_nsec = ts.tv_nsec;
-
-                    // create JSON object for the transaction
-                    nlohmann::json transaction_json = parse_command(timestamp_sec, timestamp_nsec, client_session_id, operations);
-
-                    // dump json object to string
-                    std::string transaction_json_string = transaction_json.dump();
+                    // encode the transaction (JSON or binary)
+                    std::string transaction_string = encode_transaction(operations);
 
                     // send the transaction to the server
-                    send_data(ssl_session, transaction_json_string.c_str(), transaction_json_string.length());
+                    send_data(ssl_session, transaction_string.c_str(), transaction_string.length());
 
                     // CRESET the operations
                     operations.clear();
@@ -209,21 +266,47 @@ void handle_command(SSL *ssl_session) {
         }
 
         if (command == "/test") {
-            // create timestamp
-            timespec ts;
-            clock_gettime(CLOCK_REALTIME, &ts);
-            long int timestamp_sec = ts.tv_sec;
-            long int timestamp_nsec = ts.tv_nsec;
-
             // create JSON object for the transaction
             std::vector<std::string> op = {"INSERT hoge fuga", "INSERT piyo pao"};
 
-            // dump json object to string
-            nlohmann::json test_json = parse_command(timestamp_sec, timestamp_nsec, client_session_id, op);
-            std::string test_json_string = test_json.dump();
+            // encode the transaction (JSON or binary)
+            std::string test_string = encode_transaction(op);
 
             // send the transaction to the server
-            send_data(ssl_session, test_json_string.c_str(), test_json_string.length());
+            send_data(ssl_session, test_string.c_str(), test_string.length());
+            continue;
+        }
+
+        // handle /pipeline <n> command
+        if (command.compare(0, 10, "/pipeline ") == 0) {
+            if (in_transaction) {
+                std::cout << LOG_ERROR "You are in transaction. Please finish or abort the current transaction." << std::endl;
+                continue;
+            }
+            long num_transactions = strtol(command.c_str() + 10, nullptr, 10);
+            if (num_transactions <= 0 || num_transactions > PIPELINE_MAX_OUTSTANDING) {
+                std::cout << LOG_ERROR "Usage: /pipeline <n> (1 <= n <= " << PIPELINE_MAX_OUTSTANDING << ")" << std::endl;
+                continue;
+            }
+
+            // send all transactions back to back, each one is tagged with its own session_tx_id
+            std::set<uint64_t> outstanding;
+            for (long i = 0; i < num_transactions; i++) {
+                std::vector<std::string> op = {"INSERT " + client_session_id + "_" + std::to_string(client_session_tx_id + 1) + " pipeline"};
+                send_request(ssl_session, encode_transaction(op));
+                outstanding.insert(client_session_tx_id);
+            }
+
+            // responses may arrive in any order, match them by the echoed session_tx_id
+            for (long i = 0; i < num_transactions; i++) {
+                uint64_t session_tx_id = receive_response(ssl_session, false);
+                if (outstanding.erase(session_tx_id) == 0) {
+                    std::cout << LOG_WARN "Response does not match any outstanding transaction (session_tx_id: " << session_tx_id << ")" << std::endl;
+                }
+            }
+            for (uint64_t session_tx_id : outstanding) {
+                std::cout << LOG_WARN "No response for session_tx_id: " << session_tx_id << std::endl;
+            }
             continue;
         }
 
@@ -255,7 +338,7 @@ int parse_arguments(int argc, char** argv, char** server_name, char** server_por
     const char* option = nullptr;
     unsigned int param_len = 0;
 
-    if (argc != 3)
+    if (argc != 3 && argc != 4)
         goto print_usage;
 
     option = "-server:";
@@ -270,11 +353,24 @@ int parse_arguments(int argc, char** argv, char** server_name, char** server_por
         goto print_usage;
 
     *server_port = (char*)(argv[2] + param_len);
+
+    // optional: -protocol:<json|binary>
+    if (argc == 4) {
+        option = "-protocol:";
+        param_len = strlen(option);
+        if (strncmp(argv[3], option, param_len) != 0)
+            goto print_usage;
+        if (strcmp(argv[3] + param_len, "binary") == 0) {
+            client_wire_format = WireFormat::BINARY;
+        } else if (strcmp(argv[3] + param_len, "json") != 0) {
+            goto print_usage;
+        }
+    }
     ret = 0;
     goto done;
 
 print_usage:
-    std::cout << LOG_INFO "Usage: " << argv[0] << " -server:<name> -port:<port>" << std::endl;
+    std::cout << LOG_INFO "Usage: " << argv[0] << " -server:<name> -port:<port> [-protocol:<json|binary>]" << std::endl;
 done:
     return ret;
 }
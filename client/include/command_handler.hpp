@@ -32,6 +32,7 @@ public:
             << "  - " BGRN "[x]" CRESET " /maketx           : Create a new transaction.\n"
             << "  - " BGRN "[x]" CRESET " /endtx            : End the current transaction and send to the server.\n"
             << "  - " BGRN "[x]" CRESET " /undo             : Undo the last operation. (Only available in a transaction)\n"
+            << "  - " BGRN "[x]" CRESET " /pipeline <n>     : Send <n> INSERT transactions back to back, then wait for all responses.\n"
 
             << "=== Transaction operations ===\n"
             << "  - " BGRN "[x]" CRESET " INSERT <key> <value> : Insert a new key-value pair.\n"
@@ -39,7 +40,8 @@ public:
             << "  - " BGRN "[x]" CRESET " READ   <key>         : Retrieve the value associated with the specified key.\n"
             << "  - " BGRN "[x]" CRESET " WRITE  <key> <value> : Set a value associated with the specified key.\n"
             << "  - " BRED "[ ]" CRESET " RMW    <key> <value> : Read the value associated with the specified key, and then write the specified value.\n"
-            << "  - " BGRN "[x]" CRESET " SCAN   <left_key> <l_exclusive> <right_key> <r_exclusive> : Retrieve key-value pairs between left_key and right_key, with exclusivity flags.\n"
+            << "  - " BGRN "[x]" CRESET " SCAN   <left_key> <l_exclusive> <right_key> <r_exclusive> [LIMIT <n>] [REVERSE] : Retrieve key-value pairs between left_key and right_key, with exclusivity flags.\n"
+            << "                 LIMIT returns at most <n> pairs, REVERSE returns them in descending key order (e.g. the last <n> keys).\n"
 
             << "=== Examples ===\n"
             << "  > /maketx\n"
@@ -161,10 +163,22 @@ public:
                 return std::make_pair(false, "Error: Non-ASCII character detected in keys.");
             }
 
-            // check too many arguments
-            std::string extra;
-            if (stream >> extra) {
-                return std::make_pair(false, "Syntax error: Too many arguments for the " + operation_type + " operation.");
+            // optional LIMIT <n> and REVERSE, each at most once
+            bool has_limit = false, has_reverse = false;
+            std::string option;
+            while (stream >> option) {
+                if (option == "LIMIT" && !has_limit) {
+                    std::string limit_str;
+                    if (!(stream >> limit_str) || limit_str.empty() || limit_str.size() > 9 ||
+                        limit_str.find_first_not_of("0123456789") != std::string::npos) {
+                        return std::make_pair(false, "Syntax error: LIMIT requires a number of rows (0 for no limit).");
+                    }
+                    has_limit = true;
+                } else if (option == "REVERSE" && !has_reverse) {
+                    has_reverse = true;
+                } else {
+                    return std::make_pair(false, "Syntax error: Too many arguments for the " + operation_type + " operation.");
+                }
             }
 
         } else {
@@ -3,11 +3,34 @@
 #include <string>
 #include <sstream>
 #include <vector>
+#include <stdint.h>
 
 #include "../../common/third_party/json.hpp"
+#include "../../common/binary_protocol.hpp"
+
+/**
+ * @brief Parse the optional "LIMIT <n>" and "REVERSE" of a SCAN command
+ * @param[in] ss stream positioned after <r_exclusive>
+ * @param[out] limit maximum number of rows, 0 for no limit
+ * @param[out] reverse descending key order
+*/
+inline void parse_scan_options(std::istringstream &ss, uint32_t &limit, bool &reverse) {
+    limit = 0;
+    reverse = false;
+    std::string option;
+    while (ss >> option) {
+        if (option == "LIMIT") {
+            unsigned long n = 0;
+            if (ss >> n) limit = static_cast<uint32_t>(n);
+        } else if (option == "REVERSE") {
+            reverse = true;
+        }
+    }
+}
 
 /**
  * @brief Parse commands and generate JSON object
+ * @param[in] session_tx_id per-session sequence number of the transaction (0 = not pipelined)
  * @param[in] commands commands to parse
  * @return nlohmann::json JSON object
  * 
@@ -24,6 +47,7 @@
 nlohmann::json parse_command(long int timestamp_sec, 
                              long int timestamp_nsec, 
                              const std::string &session_id,
+                             uint64_t session_tx_id,
                              const std::vector<std::string> &commands) {
     // create JSON object for the transaction
     nlohmann::json transaction = nlohmann::json::object();
@@ -32,6 +56,9 @@ nlohmann::json parse_command(long int timestamp_sec,
     transaction["timestamp_sec"] = timestamp_sec;
     transaction["timestamp_nsec"] = timestamp_nsec;
     transaction["client_sessionID"] = session_id;
+    if (session_tx_id != 0) {
+        transaction["session_tx_id"] = session_tx_id;
+    }
 
     // add transaction array
     transaction["transaction"] = nlohmann::json::array();
@@ -46,7 +73,11 @@ nlohmann::json parse_command(long int timestamp_sec,
             std::string left_key, right_key;
             bool l_exclusive, r_exclusive;
 
+            uint32_t limit;
+            bool reverse;
+
             ss >> left_key >> std::boolalpha >> l_exclusive >> right_key >> std::boolalpha >> r_exclusive;
+            parse_scan_options(ss, limit, reverse);
 
             nlohmann::json operation = {
                 {"operation", "SCAN"},
@@ -55,6 +86,8 @@ nlohmann::json parse_command(long int timestamp_sec,
                 {"right_key", right_key},
                 {"r_exclusive", r_exclusive}
             };
+            if (limit != 0) operation["limit"] = limit;
+            if (reverse) operation["reverse"] = true;
 
             transaction["transaction"].push_back(operation);
         } else {
@@ -83,3 +116,82 @@ nlohmann::json parse_command(long int timestamp_sec,
 
     return transaction;
 }
+
+/**
+ * @brief Parse commands and generate a binary encoded request
+ * @param[in] commands commands to parse (same syntax as parse_command())
+ * @return std::string request encoded as described in common/binary_protocol.hpp
+*/
+std::string parse_command_binary(long int timestamp_sec,
+                                 long int timestamp_nsec,
+                                 const std::string &session_id,
+                                 uint64_t session_tx_id,
+                                 const std::vector<std::string> &commands) {
+    BinaryRequest request;
+    request.timestamp_sec = timestamp_sec;
+    request.timestamp_nsec = timestamp_nsec;
+    request.session_tx_id = session_tx_id;
+    request.session_id = session_id;
+
+    for (const auto &command : commands) {
+        std::istringstream ss(command);
+        std::string operation_type;
+        ss >> operation_type;
+
+        BinaryOperation operation;
+        if (operation_type == "SCAN") {
+            operation.op_code = BIN_OP_SCAN;
+            ss >> operation.key >> std::boolalpha >> operation.l_exclusive
+               >> operation.value >> std::boolalpha >> operation.r_exclusive;
+            parse_scan_options(ss, operation.limit, operation.reverse);
+        } else {
+            ss >> operation.key;
+            if (operation_type == "INSERT") {
+                operation.op_code = BIN_OP_INSERT;
+            } else if (operation_type == "WRITE") {
+                operation.op_code = BIN_OP_WRITE;
+            } else if (operation_type == "RMW") {
+                operation.op_code = BIN_OP_RMW;
+            } else if (operation_type == "READ") {
+                operation.op_code = BIN_OP_READ;
+            } else if (operation_type == "DELETE") {
+                operation.op_code = BIN_OP_DELETE;
+            } else {
+                continue;   // ignore unknown operations (same as parse_command())
+            }
+            if (operation.op_code == BIN_OP_INSERT || operation.op_code == BIN_OP_WRITE || operation.op_code == BIN_OP_RMW) {
+                ss >> operation.value;
+            }
+        }
+        request.operations.push_back(operation);
+    }
+
+    return encode_binary_request(request);
+}
+
+/**
+ * @brief Convert a binary response to the JSON representation (for display)
+ * @param[in] payload binary encoded response
+ * @return nlohmann::json same layout as create_message() on the server, or null if malformed
+*/
+nlohmann::json binary_response_to_json(const std::string &payload) {
+    BinaryResponse response;
+    if (!decode_binary_response(payload, response)) {
+        return nlohmann::json();
+    }
+
+    nlohmann::json msg_json = nlohmann::json::object();
+    if (response.session_tx_id != 0) {
+        msg_json["session_tx_id"] = response.session_tx_id;
+    }
+    msg_json["error_code"] = response.error_code;
+    msg_json["content"] = response.content;
+    if (!response.read_values.empty()) {
+        nlohmann::json read_values_json = nlohmann::json::array();
+        for (const auto &pair : response.read_values) {
+            read_values_json.push_back({{pair.first, pair.second}});
+        }
+        msg_json["read_values"] = read_values_json;
+    }
+    return msg_json;
+}
@@ -0,0 +1,305 @@
+#pragma once
+
+/**
+ * Compact binary encoding of CASSA requests/responses.
+ *
+ * The encoding is an alternative to the JSON envelope and is negotiated
+ * during "/get_session_id" (see README). Messages are already framed by
+ * tls_write_to_session_peer(), so the encoding only describes the payload.
+ * All integers are little-endian, strings are length-prefixed (u32).
+ *
+ * Request:
+ *   u8  magic (BINARY_PROTOCOL_REQUEST_MAGIC)
+ *   u8  version
+ *   i64 timestamp_sec
+ *   i64 timestamp_nsec
+ *   u64 session_tx_id (per-session sequence number, 0 = not pipelined)
+ *   str client session ID
+ *   u32 number of operations
+ *   operations:
+ *     u8 op code (BinaryOpCode)
+ *     READ/DELETE         : str key
+ *     INSERT/WRITE/RMW    : str key, str value
+ *     SCAN                : str left_key, u8 l_exclusive, str right_key, u8 r_exclusive,
+ *                           u32 limit (0 = no limit), u8 reverse
+ *
+ * Response:
+ *   u8  magic (BINARY_PROTOCOL_RESPONSE_MAGIC)
+ *   u8  version
+ *   u64 session_tx_id (echo of the request, 0 if unknown)
+ *   i32 error code (same values as the JSON "error_code", see RESPONSE_ERROR_SERVER_BUSY)
+ *   str content
+ *   u32 number of read values, followed by (str key, str value) pairs
+ *
+ * NOTE: This header is shared by the enclave and the client (C++11).
+ */
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <utility>
+
+// The first byte never collides with JSON ('{') or commands ('/')
+#define BINARY_PROTOCOL_REQUEST_MAGIC  0xCA
+#define BINARY_PROTOCOL_RESPONSE_MAGIC 0xCB
+#define BINARY_PROTOCOL_VERSION        3
+
+// token appended to "/get_session_id <sec> <nsec>" to negotiate the binary encoding
+#define BINARY_PROTOCOL_NEGOTIATION_TOKEN "binary"
+
+// error code of a request refused by the admission control of the server (both encodings),
+// the request has not been executed and can be resent as is
+#define RESPONSE_ERROR_SERVER_BUSY -3
+
+enum class WireFormat : uint8_t {
+    JSON,
+    BINARY,
+};
+
+// NOTE: values are part of the wire format, do not reorder
+enum BinaryOpCode : uint8_t {
+    BIN_OP_READ   = 1,
+    BIN_OP_WRITE  = 2,
+    BIN_OP_INSERT = 3,
+    BIN_OP_DELETE = 4,
+    BIN_OP_SCAN   = 5,
+    BIN_OP_RMW    = 6,
+};
+
+struct BinaryOperation {
+    uint8_t op_code = 0;
+    std::string key;        // key (READ/WRITE/INSERT/DELETE/RMW) or left key (SCAN)
+    std::string value;      // value (WRITE/INSERT/RMW) or right key (SCAN)
+    bool l_exclusive = false;
+    bool r_exclusive = false;
+    uint32_t limit = 0;     // SCAN: maximum number of rows, 0 for no limit
+    bool reverse = false;   // SCAN: descending order
+};
+
+struct BinaryRequest {
+    int64_t timestamp_sec = 0;
+    int64_t timestamp_nsec = 0;
+    uint64_t session_tx_id = 0;
+    std::string session_id;
+    std::vector<BinaryOperation> operations;
+};
+
+struct BinaryResponse {
+    uint64_t session_tx_id = 0;
+    int32_t error_code = 0;
+    std::string content;
+    std::vector<std::pair<std::string, std::string>> read_values;
+};
+
+class BinaryWriter {
+public:
+    explicit BinaryWriter(std::string &out) : out_(out) {}
+
+    void put_u8(uint8_t v) { out_.push_back(static_cast<char>(v)); }
+
+    void put_u32(uint32_t v) {
+        for (int i = 0; i < 4; i++) out_.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+    }
+
+    void put_u64(uint64_t v) {
+        for (int i = 0; i < 8; i++) out_.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+    }
+
+    void put_str(const std::string &s) {
+        put_u32(static_cast<uint32_t>(s.size()));
+        out_.append(s);
+    }
+
+private:
+    std::string &out_;
+};
+
+class BinaryReader {
+public:
+    BinaryReader(const char *data, size_t size) : cur_(data), end_(data + size) {}
+
+    bool get_u8(uint8_t &v) {
+        if (end_ - cur_ < 1) return false;
+        v = static_cast<uint8_t>(*cur_++);
+        return true;
+    }
+
+    bool get_u32(uint32_t &v) {
+        if (end_ - cur_ < 4) return false;
+        v = 0;
+        for (int i = 0; i < 4; i++) v |= static_cast<uint32_t>(static_cast<uint8_t>(cur_[i])) << (8 * i);
+        cur_ += 4;
+        return true;
+    }
+
+    bool get_u64(uint64_t &v) {
+        if (end_ - cur_ < 8) return false;
+        v = 0;
+        for (int i = 0; i < 8; i++) v |= static_cast<uint64_t>(static_cast<uint8_t>(cur_[i])) << (8 * i);
+        cur_ += 8;
+        return true;
+    }
+
+    bool get_str(std::string &s) {
+        uint32_t len;
+        if (!get_u32(len)) return false;
+        if (static_cast<size_t>(end_ - cur_) < len) return false;
+        s.assign(cur_, len);
+        cur_ += len;
+        return true;
+    }
+
+    // same as get_str() but without copying, data points into the decoded buffer
+    bool get_bytes(const char *&data, uint32_t &len) {
+        if (!get_u32(len)) return false;
+        if (static_cast<size_t>(end_ - cur_) < len) return false;
+        data = cur_;
+        cur_ += len;
+        return true;
+    }
+
+    bool at_end() const { return cur_ == end_; }
+
+private:
+    const char *cur_;
+    const char *end_;
+};
+
+/**
+ * @brief Check whether the payload is a binary request
+*/
+inline bool is_binary_request(const std::string &payload) {
+    return !payload.empty() && static_cast<uint8_t>(payload[0]) == BINARY_PROTOCOL_REQUEST_MAGIC;
+}
+
+/**
+ * @brief Check whether the payload is a binary response
+*/
+inline bool is_binary_response(const std::string &payload) {
+    return !payload.empty() && static_cast<uint8_t>(payload[0]) == BINARY_PROTOCOL_RESPONSE_MAGIC;
+}
+
+inline std::string encode_binary_request(const BinaryRequest &request) {
+    std::string out;
+    BinaryWriter w(out);
+    w.put_u8(BINARY_PROTOCOL_REQUEST_MAGIC);
+    w.put_u8(BINARY_PROTOCOL_VERSION);
+    w.put_u64(static_cast<uint64_t>(request.timestamp_sec));
+    w.put_u64(static_cast<uint64_t>(request.timestamp_nsec));
+    w.put_u64(request.session_tx_id);
+    w.put_str(request.session_id);
+    w.put_u32(static_cast<uint32_t>(request.operations.size()));
+    for (size_t i = 0; i < request.operations.size(); i++) {
+        const BinaryOperation &op = request.operations[i];
+        w.put_u8(op.op_code);
+        w.put_str(op.key);
+        if (op.op_code == BIN_OP_SCAN) {
+            w.put_u8(op.l_exclusive ? 1 : 0);
+            w.put_str(op.value);
+            w.put_u8(op.r_exclusive ? 1 : 0);
+            w.put_u32(op.limit);
+            w.put_u8(op.reverse ? 1 : 0);
+        } else if (op.op_code == BIN_OP_INSERT || op.op_code == BIN_OP_WRITE || op.op_code == BIN_OP_RMW) {
+            w.put_str(op.value);
+        }
+    }
+    return out;
+}
+
+/**
+ * @brief Decode a binary request
+ * @return false if the payload is malformed (truncated, unknown version or op code)
+*/
+inline bool decode_binary_request(const std::string &payload, BinaryRequest &request) {
+    BinaryReader r(payload.data(), payload.size());
+    uint8_t magic, version, flag;
+    uint64_t sec, nsec;
+    uint32_t num_operations;
+
+    if (!r.get_u8(magic) || magic != BINARY_PROTOCOL_REQUEST_MAGIC) return false;
+    if (!r.get_u8(version) || version != BINARY_PROTOCOL_VERSION) return false;
+    if (!r.get_u64(sec) || !r.get_u64(nsec)) return false;
+    if (!r.get_u64(request.session_tx_id)) return false;
+    if (!r.get_str(request.session_id)) return false;
+    if (!r.get_u32(num_operations)) return false;
+    request.timestamp_sec = static_cast<int64_t>(sec);
+    request.timestamp_nsec = static_cast<int64_t>(nsec);
+
+    request.operations.clear();
+    for (uint32_t i = 0; i < num_operations; i++) {
+        BinaryOperation op;
+        if (!r.get_u8(op.op_code) || !r.get_str(op.key)) return false;
+        switch (op.op_code) {
+            case BIN_OP_READ:
+            case BIN_OP_DELETE:
+                break;
+            case BIN_OP_INSERT:
+            case BIN_OP_WRITE:
+            case BIN_OP_RMW:
+                if (!r.get_str(op.value)) return false;
+                break;
+            case BIN_OP_SCAN:
+                if (!r.get_u8(flag)) return false;
+                op.l_exclusive = (flag != 0);
+                if (!r.get_str(op.value) || !r.get_u8(flag)) return false;
+                op.r_exclusive = (flag != 0);
+                if (!r.get_u32(op.limit) || !r.get_u8(flag)) return false;
+                op.reverse = (flag != 0);
+                break;
+            default:
+                return false;
+        }
+        request.operations.push_back(std::move(op));
+    }
+    return r.at_end();
+}
+
+inline std::string encode_binary_response(int error_code,
+                                          const std::string &content,
+                                          const std::vector<std::pair<std::string, std::string>> &read_values,
+                                          uint64_t session_tx_id = 0) {
+    std::string out;
+    size_t estimated_size = 22 + content.size();
+    for (size_t i = 0; i < read_values.size(); i++) {
+        estimated_size += 8 + read_values[i].first.size() + read_values[i].second.size();
+    }
+    out.reserve(estimated_size);
+
+    BinaryWriter w(out);
+    w.put_u8(BINARY_PROTOCOL_RESPONSE_MAGIC);
+    w.put_u8(BINARY_PROTOCOL_VERSION);
+    w.put_u64(session_tx_id);
+    w.put_u32(static_cast<uint32_t>(error_code));
+    w.put_str(content);
+    w.put_u32(static_cast<uint32_t>(read_values.size()));
+    for (size_t i = 0; i < read_values.size(); i++) {
+        w.put_str(read_values[i].first);
+        w.put_str(read_values[i].second);
+    }
+    return out;
+}
+
+/**
+ * @brief Decode a binary response
+ * @return false if the payload is malformed
+*/
+inline bool decode_binary_response(const std::string &payload, BinaryResponse &response) {
+    BinaryReader r(payload.data(), payload.size());
+    uint8_t magic, version;
+    uint32_t error_code, num_read_values;
+
+    if (!r.get_u8(magic) || magic != BINARY_PROTOCOL_RESPONSE_MAGIC) return false;
+    if (!r.get_u8(version) || version != BINARY_PROTOCOL_VERSION) return false;
+    if (!r.get_u64(response.session_tx_id)) return false;
+    if (!r.get_u32(error_code) || !r.get_str(response.content)) return false;
+    if (!r.get_u32(num_read_values)) return false;
+    response.error_code = static_cast<int32_t>(error_code);
+
+    response.read_values.clear();
+    for (uint32_t i = 0; i < num_read_values; i++) {
+        std::string key, value;
+        if (!r.get_str(key) || !r.get_str(value)) return false;
+        response.read_values.emplace_back(std::move(key), std::move(value));
+    }
+    return r.at_end();
+}
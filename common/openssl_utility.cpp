@@ -29,16 +29,27 @@
 // SSL/TLSでは、1度に読めるデータの最大長は2^14バイト(16KB)となっているらしい
 int tls_read_from_session_peer(SSL *&ssl_session, std::string &payload) {
     // データサイズを受信
+    // NOTE: coalesced messages may split the size across two TLS records, so read until it is complete
     size_t data_size = 0;
-    int bytes_read = SSL_read(ssl_session, &data_size, sizeof(data_size));
-    if (bytes_read <= 0) {
-        int error = SSL_get_error(ssl_session, data_size);
+    char *size_ptr = reinterpret_cast<char*>(&data_size);
+    size_t size_remaining = sizeof(data_size);
+    int bytes_read;
+    while (size_remaining > 0) {
+        bytes_read = SSL_read(ssl_session, size_ptr, size_remaining);
+        if (bytes_read <= 0) {
+            int error = SSL_get_error(ssl_session, bytes_read);
+            if (error == SSL_ERROR_WANT_READ && size_remaining != sizeof(data_size)) {
+                continue;   // the rest of the size is on its way
+            }
 #ifdef USE_SGX
-        PRINT("Failed to read data size, SSL_read returned error=%d\n", error);
+            PRINT("Failed to read data size, SSL_read returned error=%d\n", error);
 #else
-        printf("Failed to read data size, SSL_read returned error=%d\n", error);
+            printf("Failed to read data size, SSL_read returned error=%d\n", error);
 #endif
-        return bytes_read;
+            return bytes_read;
+        }
+        size_ptr += bytes_read;
+        size_remaining -= bytes_read;
     }
 
     // データを受信
@@ -68,23 +79,36 @@ int tls_read_from_session_peer(SSL *&ssl_session, std::string &payload) {
 }
 
 
-int tls_write_to_session_peer(SSL *&ssl_session, const std::string &payload) {
-    // データサイズを送信
+/**
+ * @brief Append a message to a buffer in the framing of tls_write_to_session_peer() (size_t length + payload)
+ * @param framed buffer to append to
+ * @param payload message to append
+ */
+void append_framed_message(std::string &framed, const std::string &payload) {
     size_t data_size = payload.size();
-    int bytes_written = SSL_write(ssl_session, &data_size, sizeof(data_size));
-    if (bytes_written <= 0) {
-        int error = SSL_get_error(ssl_session, data_size);
-#ifdef USE_SGX
-        PRINT("Failed to write data size, SSL_write returned error=%d\n", error);
-#else
-        printf("Failed to write data size, SSL_write returned error=%d\n", error);
-#endif
-        return bytes_written;
-    }
+    framed.append(reinterpret_cast<const char*>(&data_size), sizeof(data_size));
+    framed.append(payload);
+}
 
+/**
+ * @brief Send one message (size + payload) in a single SSL_write, i.e. a single TLS record up to 16KB
+ */
+int tls_write_to_session_peer(SSL *&ssl_session, const std::string &payload) {
+    std::string framed;
+    framed.reserve(sizeof(size_t) + payload.size());
+    append_framed_message(framed, payload);
+    return tls_write_framed_to_session_peer(ssl_session, framed);
+}
+
+/**
+ * @brief Send already framed messages (see append_framed_message())
+ * @note One SSL_write (= one encryption and one send per 16KB record) for all messages in the buffer
+ */
+int tls_write_framed_to_session_peer(SSL *&ssl_session, const std::string &framed) {
     // データを送信
-    const char *payload_ptr = payload.data();
-    size_t remaining = payload.size();
+    const char *payload_ptr = framed.data();
+    size_t remaining = framed.size();
+    int bytes_written;
 
     while (remaining > 0) {
         bytes_written = SSL_write(ssl_session, payload_ptr, remaining);
@@ -105,4 +129,4 @@ int tls_write_to_session_peer(SSL *&ssl_session, const std::string &payload) {
     }
 
     return 0;
-}
\ No newline at end of file
+}
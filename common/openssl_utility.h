@@ -36,4 +36,9 @@
 #endif
 
 int tls_read_from_session_peer(SSL *&ssl_session, std::string &payload);
-int tls_write_to_session_peer(SSL *&ssl_session, const std::string &payload);
\ No newline at end of file
+int tls_write_to_session_peer(SSL *&ssl_session, const std::string &payload);
+
+// Several messages can be coalesced into one buffer and written at once,
+// the peer reads them one by one with tls_read_from_session_peer().
+void append_framed_message(std::string &framed, const std::string &payload);
+int tls_write_framed_to_session_peer(SSL *&ssl_session, const std::string &framed);
\ No newline at end of file
@@ -0,0 +1,73 @@
+#pragma once
+
+/**
+ * How the TransactionBalancer chooses the worker of an incoming transaction.
+ * Selected on the host with "-routing:<balanced|key|session>" and passed to
+ * ecall_initialize_global_variables() as an int.
+ */
+enum TransactionRoutingMode {
+    // Shallower of two random worker queues, idle workers steal (default)
+    ROUTING_BALANCED = 0,
+    // Stable worker per first key (or per "partition_hint" of a JSON request),
+    // transactions on the same hot key are serialized on one worker instead of aborting each other
+    ROUTING_KEY_AFFINITY = 1,
+    // Stable worker per session, the transactions of a session are executed in arrival order
+    ROUTING_SESSION_AFFINITY = 2,
+};
+
+inline const char* routing_mode_name(int mode) {
+    switch (mode) {
+        case ROUTING_BALANCED:         return "balanced";
+        case ROUTING_KEY_AFFINITY:     return "key";
+        case ROUTING_SESSION_AFFINITY: return "session";
+        default:                       return "unknown";
+    }
+}
+
+/**
+ * What the session monitors do with a session when the server is saturated, i.e. the
+ * worker queues are full or the session already has SESSION_MAX_IN_FLIGHT transactions
+ * whose responses have not been sent yet. Selected on the host with
+ * "-overload:<reject|backpressure>" and passed to ecall_initialize_global_variables().
+ */
+enum OverloadPolicy {
+    // Answer RESPONSE_ERROR_SERVER_BUSY, the client decides when to resend (default)
+    OVERLOAD_REJECT = 0,
+    // Stop reading the session until it can be admitted again,
+    // the client is slowed down by TCP flow control instead of receiving errors
+    OVERLOAD_BACKPRESSURE = 1,
+};
+
+inline const char* overload_policy_name(int policy) {
+    switch (policy) {
+        case OVERLOAD_REJECT:       return "reject";
+        case OVERLOAD_BACKPRESSURE: return "backpressure";
+        default:                    return "unknown";
+    }
+}
+
+/**
+ * How a worker reacts to a conflicting transaction (ContentionPolicy). Selected on the host
+ * with "-contention:<wait-backoff|wait|backoff|nowait>" and passed to
+ * ecall_initialize_global_variables().
+ */
+enum ContentionMode {
+    // Wait up to LOCK_WAIT_SPIN_COUNT for a locked record, back off randomly before retrying an abort (default)
+    CONTENTION_WAIT_BACKOFF = 0,
+    // Wait for a locked record, retry an aborted transaction immediately
+    CONTENTION_WAIT = 1,
+    // Abort at once on a locked record, back off randomly before the retry
+    CONTENTION_BACKOFF = 2,
+    // Abort at once on a locked record and retry immediately (plain Silo)
+    CONTENTION_NO_WAIT = 3,
+};
+
+inline const char* contention_mode_name(int mode) {
+    switch (mode) {
+        case CONTENTION_WAIT_BACKOFF: return "wait-backoff";
+        case CONTENTION_WAIT:         return "wait";
+        case CONTENTION_BACKOFF:      return "backoff";
+        case CONTENTION_NO_WAIT:      return "nowait";
+        default:                      return "unknown";
+    }
+}
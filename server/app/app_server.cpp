@@ -37,15 +37,29 @@
 
 #include <vector>
 #include <thread>
+#include <atomic>
 
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/epoll.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <errno.h>
+#include <unistd.h>
 
 #include "util/logger_affinity.hpp"
 
 #include "../../common/log_macros.h"
+#include "../../common/transaction_routing.h"
 
 #define LOOP_OPTION "-server-in-loop"
+#define ROUTING_OPTION "-routing:"
+#define OVERLOAD_OPTION "-overload:"
+#define CONTENTION_OPTION "-contention:"
+#define USAGE_FORMAT LOG_INFO "Usage: %s TLS_SERVER_ENCLAVE_PATH -port:<port> [%s] [%s<balanced|key|session>] [%s<reject|backpressure>] [%s<wait-backoff|wait|backoff|nowait>]\n"
+
+// host-side futex words for the idle threads of the enclave (workers, loggers, log buffer pools)
+#define MAX_PARKING_SPOTS 1024
 /* Global EID shared by multiple threads */
 sgx_enclave_id_t server_global_eid = 0;
 
@@ -214,6 +228,94 @@ int u_fcntl_set_nonblocking(int fd) {
         return 0;
 }
 
+// epollもSGX側から直接呼び出せないので、fdの登録と待機をOCALLとして提供する
+int u_epoll_create() {
+    int epfd = epoll_create1(0);
+    if (epfd == -1) {
+        printf("epoll_create1 failed\n");
+    }
+    return epfd;
+}
+
+int u_epoll_ctl_add(int epfd, int fd) {
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN | EPOLLRDHUP;   // level-triggered, hang-ups are reported as readable
+    ev.data.fd = fd;
+    if (epoll_ctl(epfd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        printf("epoll_ctl(ADD) failed\n");
+        return -1;
+    }
+    return 0;
+}
+
+int u_epoll_ctl_del(int epfd, int fd) {
+    if (epoll_ctl(epfd, EPOLL_CTL_DEL, fd, nullptr) == -1) {
+        printf("epoll_ctl(DEL) failed\n");
+        return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Wait until some of the registered fds become readable.
+ * @return The number of fds written to ready_fds, 0 on timeout, -1 on error.
+*/
+int u_epoll_wait_ready(int epfd, int *ready_fds, int max_events, int timeout_ms) {
+    std::vector<struct epoll_event> events(max_events);
+    int num_ready;
+    do {
+        num_ready = epoll_wait(epfd, events.data(), max_events, timeout_ms);
+    } while (num_ready == -1 && errno == EINTR);
+
+    if (num_ready == -1) {
+        printf("epoll_wait failed\n");
+        return -1;
+    }
+    for (int i = 0; i < num_ready; i++) {
+        ready_fds[i] = events[i].data.fd;
+    }
+    return num_ready;
+}
+
+// enclave内ではfutexもタイムアウト付きのcondition_variableも使えないので、
+// アイドル状態のスレッドはhost側のfutex wordで待機する (IdleStrategy/ParkingSpot)
+static std::atomic<int> parking_spots[MAX_PARKING_SPOTS];
+static std::atomic<int> num_parking_spots{0};
+
+/**
+ * @brief Allocate a parking spot (futex word).
+ * @return The ID of the spot, -1 if every spot is in use.
+*/
+int u_park_create() {
+    int spot_id = num_parking_spots.fetch_add(1);
+    if (spot_id >= MAX_PARKING_SPOTS) {
+        printf("Too many parking spots\n");
+        return -1;
+    }
+    parking_spots[spot_id].store(0);
+    return spot_id;
+}
+
+/**
+ * @brief Sleep until u_park_wake() is called on the spot or the timeout expires.
+ * @note A wake-up posted before this call returns immediately.
+*/
+void u_park_wait(int spot_id, long timeout_us) {
+    if (spot_id < 0 || spot_id >= MAX_PARKING_SPOTS) return;
+    std::atomic<int> &word = parking_spots[spot_id];
+    if (word.exchange(0) == 0) {
+        struct timespec timeout = {timeout_us / 1000000, (timeout_us % 1000000) * 1000};
+        syscall(SYS_futex, reinterpret_cast<int*>(&word), FUTEX_WAIT_PRIVATE, 0, &timeout, nullptr, 0);
+        word.store(0);
+    }
+}
+
+void u_park_wake(int spot_id) {
+    if (spot_id < 0 || spot_id >= MAX_PARKING_SPOTS) return;
+    std::atomic<int> &word = parking_spots[spot_id];
+    word.store(1);
+    syscall(SYS_futex, reinterpret_cast<int*>(&word), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+}
 
 void start_worker_task(size_t w_thid, size_t l_thid) {
     ecall_execute_worker_task(server_global_eid, w_thid, l_thid);
@@ -227,6 +329,14 @@ void start_ssl_connection_acceptor_task(char* server_port, int keep_server_up) {
     ecall_ssl_connection_acceptor(server_global_eid, server_port, keep_server_up);
 }
 
+void start_ssl_session_monitor_task(size_t m_thid) {
+    sgx_status_t result = ecall_ssl_session_monitor(server_global_eid, m_thid);
+    if (result != SGX_SUCCESS) {
+        print_error_message(result);
+        printf(LOG_ERROR "ssl_session_monitor failed\n");
+    }
+}
+
 void terminate_enclave() {
     sgx_destroy_enclave(server_global_eid);
     printf(LOG_INFO "Enclave successfully terminated.\n");
@@ -279,10 +389,15 @@ int main(int argc, const char* argv[]) {
     // TODO: worker/logger threadの数はハードコーディングしておくけど、後で変更する
     std::vector<std::thread> worker_threads;
     std::vector<std::thread> logger_threads;
+    std::vector<std::thread> ssl_session_monitor_threads;
     std::thread ssl_connection_acceptor_thread;
 
     size_t worker_num = 2;
     size_t logger_num = 2;
+    size_t monitor_num = 2; // ingress shards, each session is served by one session monitor thread
+    int routing_mode = ROUTING_BALANCED;    // worker selection of the TransactionBalancer
+    int overload_policy = OVERLOAD_REJECT;  // admission control when workers or a session are saturated
+    int contention_mode = CONTENTION_WAIT_BACKOFF;  // lock wait and abort backoff of the workers
 
     LoggerAffinity affin;
     affin.init(worker_num, logger_num);
@@ -292,16 +407,54 @@ int main(int argc, const char* argv[]) {
     int ocall_ret;
 
     /* Check argument count */
-    if (argc == 4) {
-        if (strcmp(argv[3], LOOP_OPTION) != 0) {
-            printf(LOG_INFO "Usage: %s TLS_SERVER_ENCLAVE_PATH -port:<port> [%s]\n", argv[0], LOOP_OPTION);
-            return 1;
-        } else {
+    if (argc < 3 || argc > 7) {
+        printf(USAGE_FORMAT, argv[0], LOOP_OPTION, ROUTING_OPTION, OVERLOAD_OPTION, CONTENTION_OPTION);
+        return 1;
+    }
+    /* Optional arguments (any order) */
+    for (int i = 3; i < argc; i++) {
+        if (strcmp(argv[i], LOOP_OPTION) == 0) {
             keep_server_up = 1;
+        } else if (strncmp(argv[i], ROUTING_OPTION, strlen(ROUTING_OPTION)) == 0) {
+            const char* mode = argv[i] + strlen(ROUTING_OPTION);
+            if (strcmp(mode, routing_mode_name(ROUTING_BALANCED)) == 0) {
+                routing_mode = ROUTING_BALANCED;
+            } else if (strcmp(mode, routing_mode_name(ROUTING_KEY_AFFINITY)) == 0) {
+                routing_mode = ROUTING_KEY_AFFINITY;
+            } else if (strcmp(mode, routing_mode_name(ROUTING_SESSION_AFFINITY)) == 0) {
+                routing_mode = ROUTING_SESSION_AFFINITY;
+            } else {
+                printf(USAGE_FORMAT, argv[0], LOOP_OPTION, ROUTING_OPTION, OVERLOAD_OPTION, CONTENTION_OPTION);
+                return 1;
+            }
+        } else if (strncmp(argv[i], OVERLOAD_OPTION, strlen(OVERLOAD_OPTION)) == 0) {
+            const char* policy = argv[i] + strlen(OVERLOAD_OPTION);
+            if (strcmp(policy, overload_policy_name(OVERLOAD_REJECT)) == 0) {
+                overload_policy = OVERLOAD_REJECT;
+            } else if (strcmp(policy, overload_policy_name(OVERLOAD_BACKPRESSURE)) == 0) {
+                overload_policy = OVERLOAD_BACKPRESSURE;
+            } else {
+                printf(USAGE_FORMAT, argv[0], LOOP_OPTION, ROUTING_OPTION, OVERLOAD_OPTION, CONTENTION_OPTION);
+                return 1;
+            }
+        } else if (strncmp(argv[i], CONTENTION_OPTION, strlen(CONTENTION_OPTION)) == 0) {
+            const char* mode = argv[i] + strlen(CONTENTION_OPTION);
+            if (strcmp(mode, contention_mode_name(CONTENTION_WAIT_BACKOFF)) == 0) {
+                contention_mode = CONTENTION_WAIT_BACKOFF;
+            } else if (strcmp(mode, contention_mode_name(CONTENTION_WAIT)) == 0) {
+                contention_mode = CONTENTION_WAIT;
+            } else if (strcmp(mode, contention_mode_name(CONTENTION_BACKOFF)) == 0) {
+                contention_mode = CONTENTION_BACKOFF;
+            } else if (strcmp(mode, contention_mode_name(CONTENTION_NO_WAIT)) == 0) {
+                contention_mode = CONTENTION_NO_WAIT;
+            } else {
+                printf(USAGE_FORMAT, argv[0], LOOP_OPTION, ROUTING_OPTION, OVERLOAD_OPTION, CONTENTION_OPTION);
+                return 1;
+            }
+        } else {
+            printf(USAGE_FORMAT, argv[0], LOOP_OPTION, ROUTING_OPTION, OVERLOAD_OPTION, CONTENTION_OPTION);
+            return 1;
         }
-    } else if (argc != 3) {
-        printf(LOG_INFO "Usage: %s TLS_SERVER_ENCLAVE_PATH -port:<port> [%s]\n", argv[0], LOOP_OPTION);
-        return 1;
     }
 
     printf(LOG_INFO "Starting CASSA server ...\n");
@@ -313,10 +466,13 @@ int main(int argc, const char* argv[]) {
         server_port = (char*)(argv[2] + param_len);
     } else {
         fprintf(stderr, "Unknown option %s\n", argv[2]);
-        printf(LOG_INFO "Usage: %s TLS_SERVER_ENCLAVE_PATH -port:<port> [%s]\n", argv[0], LOOP_OPTION);
+        printf(USAGE_FORMAT, argv[0], LOOP_OPTION, ROUTING_OPTION, OVERLOAD_OPTION, CONTENTION_OPTION);
         return 1;
     }
     printf(LOG_SPACE "Server Port: " BGRN "%s" CRESET "\n", server_port);
+    printf(LOG_SPACE "Routing: " BGRN "%s" CRESET "\n", routing_mode_name(routing_mode));
+    printf(LOG_SPACE "Overload: " BGRN "%s" CRESET "\n", overload_policy_name(overload_policy));
+    printf(LOG_SPACE "Contention: " BGRN "%s" CRESET "\n", contention_mode_name(contention_mode));
 
     printf(LOG_INFO "Creating enclave\n");
     result = initialize_enclave(argv[1]);
@@ -340,7 +496,7 @@ int main(int argc, const char* argv[]) {
     }
 
     printf(LOG_INFO "Initialize CASSA settings\n");
-    ecall_initialize_global_variables(server_global_eid, worker_num, logger_num);
+    ecall_initialize_global_variables(server_global_eid, worker_num, logger_num, monitor_num, routing_mode, overload_policy, contention_mode);
 
     printf(LOG_INFO "Launching worker/logger thread\n");
     for (auto itr = affin.nodes_.begin(); itr != affin.nodes_.end(); itr++, l_thid++) {
@@ -353,18 +509,17 @@ int main(int argc, const char* argv[]) {
     printf(LOG_INFO "Launching SSL connection acceptor thread\n");
     ssl_connection_acceptor_thread = std::thread(start_ssl_connection_acceptor_task, server_port, keep_server_up);
 
-    result = ecall_ssl_session_monitor(server_global_eid);
-    if (result != SGX_SUCCESS) {
-        print_error_message(result);
-        printf(LOG_ERROR "ssl_session_monitor failed\n");
-        goto exit;
+    printf(LOG_INFO "Launching SSL session monitor threads\n");
+    for (size_t m_thid = 0; m_thid < monitor_num; m_thid++) {
+        ssl_session_monitor_threads.emplace_back(start_ssl_session_monitor_task, m_thid);
     }
 
 exit:
 
     for (auto &thread : worker_threads) thread.join();
     for (auto &thread : logger_threads) thread.join();
-    ssl_connection_acceptor_thread.join();
+    for (auto &thread : ssl_session_monitor_threads) thread.join();
+    if (ssl_connection_acceptor_thread.joinable()) ssl_connection_acceptor_thread.join();
 
     // printf("Host: Terminating enclaves\n");
     printf(LOG_INFO "Terminating enclaves\n");
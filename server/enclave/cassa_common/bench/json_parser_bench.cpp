@@ -0,0 +1,96 @@
+/**
+ * Host-side microbenchmark of the JSON request parser.
+ *
+ * Compares JsonRequestParser::parse() with the previous implementation of
+ * json_to_procedures(), which built a nlohmann::json tree and copied every
+ * key/value into std::string, on a transaction of N WRITE operations.
+ *
+ * Usage: ./json_parser_bench [operations per request (10)] [iterations (200000)]
+ */
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "../json_request_parser.hpp"
+#include "../../../../common/third_party/json.hpp"
+
+// Procedure of the previous implementation (owned strings)
+struct OwnedProcedure {
+    OpType ope_;
+    std::string key_;
+    std::string value_;
+    OwnedProcedure(OpType ope, std::string key, std::string value)
+        : ope_(ope), key_(std::move(key)), value_(std::move(value)) {}
+};
+
+// json_to_procedures() before the single-pass parser (without the session checks)
+static int nlohmann_to_procedures(std::vector<OwnedProcedure> &procedures, const std::string &json_str) {
+    auto json = nlohmann::json::parse(json_str);
+    std::string client_session_id = json["client_sessionID"];
+    long int timestamp_sec = json["timestamp_sec"].get<long int>();
+    long int timestamp_nsec = json["timestamp_nsec"].get<long int>();
+    if (client_session_id.empty() || timestamp_sec < 0 || timestamp_nsec < 0) return -1;
+
+    procedures.clear();
+    for (const auto &operation : json["transaction"]) {
+        std::string operation_str = operation["operation"];
+        if (operation_str != "WRITE") return -2;
+        std::string key_str = operation["key"];
+        std::string value_str = operation.value("value", "");
+        procedures.emplace_back(OpType::WRITE, key_str, value_str);
+    }
+    return 0;
+}
+
+static std::string make_request(int operations) {
+    std::string request = R"({"client_sessionID":"0123456789abcdef0123456789abcdef","timestamp_sec":1700000000,)"
+                          R"("timestamp_nsec":123456789,"transaction":[)";
+    for (int i = 0; i < operations; i++) {
+        if (i != 0) request += ",";
+        request += R"({"operation":"WRITE","key":"user)" + std::to_string(100000 + i) +
+                   R"(","value":"value-of-a-typical-record-)" + std::to_string(i) + R"("})";
+    }
+    request += "]}";
+    return request;
+}
+
+template <class F>
+static double measure_us(int iterations, F f) {
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++) f();
+    auto stop = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(stop - start).count() / iterations;
+}
+
+int main(int argc, char **argv) {
+    const int operations = argc > 1 ? std::atoi(argv[1]) : 10;
+    const int iterations = argc > 2 ? std::atoi(argv[2]) : 200000;
+    const std::string request = make_request(operations);
+
+    // the parser works in place, so every iteration parses a fresh copy (as the worker does)
+    JsonRequestParser parser;
+    RequestHeader header;
+    std::vector<Procedure> procedures;
+    std::string buffer;
+    size_t checksum = 0;
+    double single_pass = measure_us(iterations, [&] {
+        buffer = request;
+        if (parser.parse(buffer, header, procedures) != RequestParseResult::OK) std::abort();
+        checksum += procedures.size();
+    });
+
+    std::vector<OwnedProcedure> owned;
+    double tree = measure_us(iterations, [&] {
+        buffer = request;
+        if (nlohmann_to_procedures(owned, buffer) != 0) std::abort();
+        checksum += owned.size();
+    });
+
+    std::printf("request: %d operations, %zu bytes, %d iterations\n", operations, request.size(), iterations);
+    std::printf("JsonRequestParser : %8.3f us/request\n", single_pass);
+    std::printf("nlohmann::json    : %8.3f us/request\n", tree);
+    std::printf("(checksum %zu)\n", checksum);
+    return 0;
+}
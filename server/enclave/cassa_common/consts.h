@@ -42,7 +42,87 @@
 // The epoch difference.
 #define EPOCH_DIFF 1
 
+// -------------------
+// Transaction configurations
+// -------------------
+// Read/write sets with at least this many elements are searched through a hash index (OpSetIndex).
+#define OP_SET_INDEX_THRESHOLD 16
+// Size of a chunk of the per-transaction arena (TransactionArena) holding staged values.
+#define TX_ARENA_CHUNK_SIZE (64 * 1024)
+// Chunks beyond the first are returned to the enclave heap when the arena retains more than this.
+#define TX_ARENA_MAX_RETAINED_SIZE (4 * 1024 * 1024)
+// Upper bound of deleted records a worker removes from Masstree per epoch (purgeTombstones()).
+#define TOMBSTONE_PURGE_BATCH_SIZE 1024
+
+// -------------------
+// Contention management configurations (ContentionPolicy)
+// -------------------
+// Pause iterations lockWriteSet() waits for a record locked by another transaction before aborting (0 = no-wait).
+#define LOCK_WAIT_SPIN_COUNT 1024
+// Upper bound (us) of the random wait before the first retry of an aborted transaction (0 = retry immediately).
+// The bound doubles with every consecutive abort of the same transaction, up to ABORT_BACKOFF_MAX_US.
+#define ABORT_BACKOFF_BASE_US 1
+#define ABORT_BACKOFF_MAX_US 512
+
+// -------------------
+// Idle configurations (IdleStrategy)
+// -------------------
+// Misses an idle thread only retries before backing off.
+#define IDLE_SPIN_COUNT 64
+// Misses with exponential pause backoff (1, 2, 4, ... pause instructions) before parking.
+#define IDLE_BACKOFF_COUNT 10
+// The maximum time (us) an idle worker sleeps in the host, it still has to follow the global epoch.
+#define WORKER_PARK_TIMEOUT_US 1000
+
+// -------------------
+// Memory configurations (SlabAllocator)
+// -------------------
+// Size of a chunk the slabs carve their blocks from.
+#define SLAB_CHUNK_SIZE (256 * 1024)
+// Largest block served by a slab, larger allocations use the enclave heap.
+#define SLAB_MAX_BLOCK_SIZE 4096
+// Free blocks a thread caches per size class before giving half of them back.
+#define SLAB_CACHE_SIZE 64
+// A record whose header and body fit in this many bytes is stored in a single block (inline body).
+#define VALUE_MAX_INLINE_SIZE 256
+// Masstree nodes carved (and pre-touched) at startup, on top of the nodes built by recovery.
+#define MASSTREE_BORDER_NODE_RESERVE 4096
+#define MASSTREE_INTERIOR_NODE_RESERVE 512
+
 // -------------------
 // Cache line size configurations
 // -------------------
-#define CACHE_LINE_SIZE 64
\ No newline at end of file
+#define CACHE_LINE_SIZE 64
+
+// -------------------
+// Masstree configurations
+// -------------------
+// Share of the entries (in %) the left node keeps when an insert at the right edge of a layer splits it.
+// Appended keys then fill nodes almost completely, the rest is left for slightly out-of-order keys.
+#define MASSTREE_APPEND_SPLIT_PERCENT 90
+
+// -------------------
+// Network configurations
+// -------------------
+// The maximum number of ready sessions returned by a single readiness wait.
+#define SESSION_MONITOR_MAX_EVENTS 64
+// How long (ms) the session monitor sleeps in the host while no session is readable.
+#define SESSION_MONITOR_TIMEOUT_MS 10
+// How long (ms) the acceptor sleeps in the host while no connection is pending.
+#define ACCEPTOR_WAIT_TIMEOUT_MS 100
+// The maximum number of concurrent client sessions (size of the session slot table).
+#define MAX_SESSION_NUM 4096
+// The maximum nesting depth of arrays/objects in a JSON request, deeper requests are rejected as malformed.
+// Bounds the recursion of the parser on the enclave stack.
+#define JSON_MAX_NESTING_DEPTH 64
+// Size of the anti-replay window of pipelined requests (in session_tx_id, multiple of 64).
+// A request whose session_tx_id is this far behind the highest one seen in the session is rejected.
+#define SESSION_TX_ID_WINDOW 1024
+// Capacity of each worker's transaction queue (must be a power of two).
+#define TRANSACTION_QUEUE_CAPACITY 4096
+// The maximum number of transactions of a session that are queued or executing and whose
+// response has not been sent yet (durable writes count until their commit notification).
+// Beyond this the session is handled by the overload policy (-overload:<reject|backpressure>).
+#define SESSION_MAX_IN_FLIGHT 256
+// How long (ms) the session monitor sleeps in the host while some of its sessions are paused by backpressure.
+#define SESSION_RESUME_INTERVAL_MS 1
@@ -2,26 +2,191 @@
 
 #pragma once
 
+#include <new>
 #include <string>
+#include <string_view>
+#include <cstddef>
+#include <cstring>
+#include <algorithm>
 
 #include "db_tid.h"
+#include "slab_allocator.hpp"
 
 #define CACHE_LINE_SIZE 64
 
-// TODO: templateにしてstd::string以外にも対応させる
+/**
+ * @class ValueBody
+ * @brief Immutable bytes of a record, the size is followed by the bytes in the same block
+ * @note  Allocated from the SlabAllocator (or the heap if larger than SLAB_MAX_BLOCK_SIZE).
+ *        A separate body is never modified after it has been published, see Value::update_body().
+ *        Only the inline body of a Value is rewritten in place, by the holder of the TID lock.
+ */
+class ValueBody {
+public:
+    static constexpr uint8_t INLINE_CLASS = 0xfe;   // stored inside its Value, freed with it
+    static constexpr uint8_t SHARED_CLASS = 0xfd;   // empty(), never freed
+
+    static ValueBody *create(std::string_view bytes) {
+        const size_t block_size = sizeof(ValueBody) + bytes.size();
+        uint8_t size_class = SlabAllocator::size_class(block_size);
+        void *block = (size_class == SlabAllocator::HEAP_CLASS)
+                    ? ::operator new(block_size)
+                    : SlabAllocator::instance().allocate(size_class);
+        ValueBody *body = new (block) ValueBody(bytes.size(), size_class);
+        std::memcpy(body->data(), bytes.data(), bytes.size());
+        return body;
+    }
+
+    static void destroy(ValueBody *body) {
+        if (body == nullptr) return;
+        switch (body->slab_class_) {
+            case INLINE_CLASS:
+            case SHARED_CLASS:
+                return;
+            case SlabAllocator::HEAP_CLASS:
+                ::operator delete(body);
+                return;
+            default:
+                SlabAllocator::instance().deallocate(body, body->slab_class_);
+                return;
+        }
+    }
+
+    // shared empty body (e.g. of a purged record)
+    static ValueBody *empty() {
+        static ValueBody body(0, SHARED_CLASS);
+        return &body;
+    }
+
+    // the size is loaded once, an inline body rewritten concurrently never grows beyond its block
+    std::string_view view() const { return std::string_view(data(), __atomic_load_n(&size_, __ATOMIC_RELAXED)); }
+
+    // bytes occupied by the body (0 if it is stored inside its Value)
+    size_t footprint() const {
+        if (slab_class_ == INLINE_CLASS || slab_class_ == SHARED_CLASS) return 0;
+        if (slab_class_ == SlabAllocator::HEAP_CLASS) return sizeof(ValueBody) + size_;
+        return SlabAllocator::class_size(slab_class_);
+    }
+
+private:
+    friend class Value;
+
+    uint32_t size_;
+    uint8_t slab_class_;
+
+    ValueBody(size_t size, uint8_t slab_class) : size_(static_cast<uint32_t>(size)), slab_class_(slab_class) {}
+
+    // the bytes follow the header
+    char *data() { return reinterpret_cast<char*>(this + 1); }
+    const char *data() const { return reinterpret_cast<const char*>(this + 1); }
+};
+static_assert(sizeof(ValueBody) == 8, "the bytes of a ValueBody start right after its header");
+
+/**
+ * @class Value
+ * @brief Record shared by masstree and silo: TID word and body
+ *
+ * @note  Records are allocated from the SlabAllocator with create() and freed with destroy()
+ *        (through the GarbageCollector). If the header and the body fit in VALUE_MAX_INLINE_SIZE,
+ *        the body is stored inline right after the header, so reading a small record touches a
+ *        single block. writePhase() keeps a new body inline whenever it fits into the block of the
+ *        record (update_body()), only larger bodies are allocated separately.
+ *        The members other than tidword_ are only public to keep the class standard-layout,
+ *        use body() and exchange_body().
+ */
 class Value {
 public:
     alignas(CACHE_LINE_SIZE) 
     TIDword tidword_;
-    std::string body_;
+    ValueBody *body_;           // current body, &inline_body_ or a separate block
+    uint8_t slab_class_;        // size class of this block
+    ValueBody inline_body_;     // header of the inline body, its bytes continue past sizeof(Value)
 
-    Value(std::string body) : body_(body){};
+    static Value *create(std::string_view body) {
+        const size_t inline_size = inline_body_offset() + body.size();
+        const bool inline_body = (inline_size <= VALUE_MAX_INLINE_SIZE);
+        uint8_t size_class = SlabAllocator::size_class(inline_body ? std::max(inline_size, sizeof(Value)) : sizeof(Value));
+        Value *value = new (SlabAllocator::instance().allocate(size_class)) Value(size_class);
+        if (inline_body) {
+            value->inline_body_.size_ = static_cast<uint32_t>(body.size());
+            std::memcpy(value->inline_body_.data(), body.data(), body.size());
+            value->body_ = &value->inline_body_;
+        } else {
+            value->body_ = ValueBody::create(body);
+        }
+        return value;
+    }
+
+    static void destroy(Value *value) {
+        if (value == nullptr) return;
+        uint8_t size_class = value->slab_class_;
+        ValueBody::destroy(value->body_);
+        value->~Value();
+        SlabAllocator::instance().deallocate(value, size_class);
+    }
+
+    Value(const Value&) = delete;
+    Value& operator=(const Value&) = delete;
+
+    /**
+     * @brief Current body of the record
+     * @note A separate body is never modified in place, update_body() replaces it and
+     *       the old one is retired, so the view stays valid until the reclamation epoch
+     *       of the GarbageCollector has passed it. An inline body is rewritten in place
+     *       while the TID word is locked, so the bytes are only consistent if the TID
+     *       word is unchanged afterwards (Silo read protocol, validationPhase()).
+     *       The view never reaches beyond the block of the record.
+     */
+    std::string_view body() const {
+        return __atomic_load_n(&body_, __ATOMIC_ACQUIRE)->view();
+    }
+
+    /**
+     * @brief Replace the body with bytes, the caller holds the TID lock of the record
+     * @return The old separate body, pass it to GarbageCollector::add() (readers may still use it).
+     *         nullptr if there is none (the record was and stays inline)
+     * @note Bytes that fit into the block of the record are written inline, also when the
+     *       old body was separate, so a record does not keep an unused inline area plus a
+     *       second block after its first update. Readers that copy the inline bytes while
+     *       they are rewritten see the TID word change and abort in validationPhase().
+     */
+    ValueBody *update_body(std::string_view bytes) {
+        if (bytes.size() > inline_capacity()) return exchange_body(ValueBody::create(bytes));
+        std::memcpy(inline_body_.data(), bytes.data(), bytes.size());
+        __atomic_store_n(&inline_body_.size_, static_cast<uint32_t>(bytes.size()), __ATOMIC_RELAXED);
+        return exchange_body(&inline_body_);
+    }
+
+    /**
+     * @brief Publish a new body
+     * @return The old body, pass it to GarbageCollector::add() (readers may still use it).
+     *         nullptr if the old body was inline, it is freed together with the record.
+     */
+    ValueBody *exchange_body(ValueBody *new_body) {
+        ValueBody *old_body = __atomic_exchange_n(&body_, new_body, __ATOMIC_ACQ_REL);
+        return (old_body == &inline_body_) ? nullptr : old_body;
+    }
+
+    // bytes occupied by the record and its body
+    size_t footprint() const {
+        return SlabAllocator::class_size(slab_class_) + body_->footprint();
+    }
 
     bool operator==(const Value &right) const {
-        return body_ == right.body_;
+        return body() == right.body();
     }
 
     bool operator!=(const Value &right) const {
         return !operator==(right);
     }
-};
\ No newline at end of file
+
+private:
+    // offset of the bytes of the inline body from the beginning of the record
+    static constexpr size_t inline_body_offset() { return offsetof(Value, inline_body_) + sizeof(ValueBody); }
+
+    // bytes of an inline body that fit into the block of this record
+    size_t inline_capacity() const { return SlabAllocator::class_size(slab_class_) - inline_body_offset(); }
+
+    explicit Value(uint8_t slab_class) : body_(nullptr), slab_class_(slab_class), inline_body_(0, ValueBody::INLINE_CLASS) {}
+    ~Value() = default;
+};
@@ -0,0 +1,112 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include "consts.h"
+#include "../cassa_server_t.h"  // for u_park_create(), u_park_wait(), u_park_wake()
+
+// for t_print()
+#include "../../../common/common.h"
+#include "../../../common/log_macros.h"
+
+/**
+ * @class ParkingSpot
+ * @brief Place where one consumer thread sleeps until a producer has work for it
+ *
+ * @note  The enclave has neither a futex nor a timed condition variable, so the
+ *        consumer sleeps in the host (OCALL) on a futex word identified by spot_id_.
+ *        parked_ tells producers whether the OCALL for wake() is needed at all,
+ *        so a producer only pays for it while the consumer is actually asleep.
+ *        A wake() that arrives before the consumer enters the host is kept by the
+ *        host, and every park is bounded by a timeout, so a wake-up is never lost.
+ *        The host futex is allocated on the first park() (by the consumer itself).
+*/
+class ParkingSpot {
+public:
+    ParkingSpot() = default;
+    ParkingSpot(const ParkingSpot&) = delete;
+    ParkingSpot& operator=(const ParkingSpot&) = delete;
+
+    /**
+     * @brief Sleep in the host unless ready() holds, at most timeout_us
+     * @param ready Condition the consumer waits for, checked after announcing the park
+     * @param timeout_us Upper bound of the sleep (microseconds)
+     * @note Only the owner (single consumer) of the spot may call this
+    */
+    template <class Ready>
+    void park(Ready ready, uint64_t timeout_us) {
+        if (spot_id_ < 0 && !create()) return;  // no spot in the host, keep spinning
+
+        // announce the park before the last check, pairs with the fence in wake()
+        parked_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!ready()) {
+            u_park_wait(spot_id_, static_cast<long>(timeout_us));
+        }
+        parked_.store(false, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Wake the consumer if it is parked
+     * @note Call after the work has been published
+    */
+    void wake() {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!parked_.load(std::memory_order_relaxed)) return;
+        if (parked_.exchange(false, std::memory_order_acq_rel)) {
+            u_park_wake(spot_id_);
+        }
+    }
+
+private:
+    std::atomic<bool> parked_{false};
+    int spot_id_ = -1;  // futex word in the host, written before parked_ is first set
+
+    bool create() {
+        int spot_id = -1;
+        if (u_park_create(&spot_id) != SGX_SUCCESS || spot_id < 0) {
+            t_print(LOG_ERROR "Failed to create a parking spot in the host\n");
+            return false;
+        }
+        spot_id_ = spot_id;
+        return true;
+    }
+};
+
+/**
+ * @class IdleStrategy
+ * @brief What a consumer does each time it finds no work: spin, back off, then park
+ *
+ * @note  The first IDLE_SPIN_COUNT misses only retry, so a thread under load never
+ *        leaves the enclave. The next IDLE_BACKOFF_COUNT misses execute an
+ *        exponentially growing number of pause instructions. After that the thread
+ *        parks on the ParkingSpot of the data it is waiting for, until a producer
+ *        wakes it or the timeout expires. Call reset() whenever work has been found.
+*/
+class IdleStrategy {
+public:
+    /**
+     * @brief Back off or park after a miss
+     * @param spot Parking spot the producers of the awaited work wake
+     * @param ready Condition the consumer waits for (re-checked before parking)
+     * @param park_timeout_us Upper bound of a park (microseconds)
+    */
+    template <class Ready>
+    void idle(ParkingSpot &spot, Ready ready, uint64_t park_timeout_us) {
+        if (idle_count_ < IDLE_SPIN_COUNT) {
+            idle_count_++;
+        } else if (idle_count_ < IDLE_SPIN_COUNT + IDLE_BACKOFF_COUNT) {
+            uint32_t pauses = 1U << (idle_count_ - IDLE_SPIN_COUNT);
+            for (uint32_t i = 0; i < pauses; i++) __builtin_ia32_pause();
+            idle_count_++;
+        } else {
+            spot.park(ready, park_timeout_us);
+        }
+    }
+
+    void reset() { idle_count_ = 0; }
+
+private:
+    uint32_t idle_count_ = 0;   // consecutive misses
+};
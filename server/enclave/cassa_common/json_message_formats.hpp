@@ -2,8 +2,10 @@
 
 #include <string>
 #include <vector>
+#include <cstdint>
 
 #include "../../../common/third_party/json.hpp"
+#include "../../../common/binary_protocol.hpp"
 
 /**
  * @brief Creates an message in JSON format.
@@ -12,13 +14,21 @@
  * @param content The content of the message.
  * @param read_values The read values as a vector of key-value pairs.
  *                    Defaults to an empty vector if not specified.
+ * @param session_tx_id The per-session sequence number of the request to echo.
+ *                      Omitted from the message if 0 (request was not pipelined).
  * @return nlohmann::json The JSON object representing the message.
  */
 inline nlohmann::json create_message(int error_code, 
                               const std::string &content, 
-                              const std::vector<std::pair<std::string, std::string>> &read_values = {}) {
+                              const std::vector<std::pair<std::string, std::string>> &read_values = {},
+                              uint64_t session_tx_id = 0) {
     nlohmann::json msg_json = nlohmann::json::object();
 
+    // add sequence number so that the client can match pipelined responses
+    if (session_tx_id != 0) {
+        msg_json["session_tx_id"] = session_tx_id;
+    }
+
     // add error code and content
     msg_json["error_code"] = error_code;
     msg_json["content"] = content;
@@ -33,4 +43,25 @@ inline nlohmann::json create_message(int error_code,
     }
 
     return msg_json;
+}
+
+/**
+ * @brief Serializes a message in the wire format negotiated by the session.
+ * 
+ * @param format The wire format of the destination session.
+ * @param error_code The error code.
+ * @param content The content of the message.
+ * @param read_values The read values as a vector of key-value pairs.
+ * @param session_tx_id The per-session sequence number of the request to echo.
+ * @return std::string The payload to send.
+ */
+inline std::string serialize_message(WireFormat format,
+                                     int error_code,
+                                     const std::string &content,
+                                     const std::vector<std::pair<std::string, std::string>> &read_values = {},
+                                     uint64_t session_tx_id = 0) {
+    if (format == WireFormat::BINARY) {
+        return encode_binary_response(error_code, content, read_values, session_tx_id);
+    }
+    return create_message(error_code, content, read_values, session_tx_id).dump();
 }
\ No newline at end of file
@@ -0,0 +1,414 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <climits>
+
+#include "consts.h"
+#include "structures.h"
+#include "../silo_cc/include/silo_procedure.h"
+
+/**
+ * @brief Result of JsonRequestParser::parse()
+*/
+enum class RequestParseResult : uint8_t {
+    OK,
+    MALFORMED,          // not a valid JSON document, or a required field is missing / has a wrong type
+    UNKNOWN_OPERATION,  // "operation" is not one of INSERT/DELETE/READ/WRITE/SCAN
+};
+
+/**
+ * @brief Envelope of a transaction request
+ * @note client_session_id points into the parsed buffer
+*/
+struct RequestHeader {
+    std::string_view client_session_id;
+    long int timestamp_sec = 0;
+    long int timestamp_nsec = 0;
+    uint64_t session_tx_id = 0;     // optional per-session sequence number (0 = not pipelined)
+};
+
+/**
+ * @class JsonRequestParser
+ * @brief Single-pass, allocation-free parser for the JSON transaction envelope
+ *
+ * @note  The parser works in-situ: escaped strings are decoded in place (the
+ *        decoded form is never longer than the escaped one), and every key/value
+ *        of the emitted `Procedure` objects is a view into the given buffer.
+ *        Therefore the buffer must outlive the procedures and must not be reused
+ *        until the transaction has finished.
+ *        Keys of the envelope may appear in any order, unknown keys are skipped.
+ *
+ * Expected document:
+ *   {"client_sessionID": "...", "timestamp_sec": N, "timestamp_nsec": N, "session_tx_id": N (optional),
+ *    "transaction": [{"operation": "INSERT", "key": "...", "value": "..."},
+ *                    {"operation": "SCAN", "left_key": "...", "l_exclusive": true,
+ *                     "right_key": "...", "r_exclusive": false,
+ *                     "limit": N (optional, 0 = no limit), "reverse": true (optional)}, ...]}
+*/
+class JsonRequestParser {
+public:
+    /**
+     * @brief Parse a transaction request
+     * @param buffer received JSON document (modified in place)
+     * @param header parsed envelope
+     * @param procedures parsed operations (cleared first, capacity is reused)
+     * @return RequestParseResult
+    */
+    RequestParseResult parse(std::string &buffer, RequestHeader &header, std::vector<Procedure> &procedures) {
+        cur_ = &buffer[0];
+        end_ = cur_ + buffer.size();
+        result_ = RequestParseResult::OK;
+        header.session_tx_id = 0;
+        procedures.clear();
+
+        bool has_session_id = false, has_sec = false, has_nsec = false, has_transaction = false;
+
+        if (!consume('{')) return fail();
+        if (!consume('}')) {
+            do {
+                std::string_view name;
+                if (!parse_string(name) || !consume(':')) return fail();
+
+                if (name == "client_sessionID") {
+                    if (!parse_string(header.client_session_id)) return fail();
+                    has_session_id = true;
+                } else if (name == "timestamp_sec") {
+                    if (!parse_integer(header.timestamp_sec)) return fail();
+                    has_sec = true;
+                } else if (name == "timestamp_nsec") {
+                    if (!parse_integer(header.timestamp_nsec)) return fail();
+                    has_nsec = true;
+                } else if (name == "session_tx_id") {
+                    if (!parse_unsigned(header.session_tx_id)) return fail();
+                } else if (name == "transaction") {
+                    if (!parse_transaction(procedures)) return (result_ == RequestParseResult::OK) ? fail() : result_;
+                    has_transaction = true;
+                } else {
+                    if (!skip_value()) return fail();
+                }
+            } while (consume(','));
+            if (!consume('}')) return fail();
+        }
+
+        skip_ws();
+        if (cur_ != end_) return fail();    // trailing garbage
+        if (!has_session_id || !has_sec || !has_nsec || !has_transaction) return fail();
+        return RequestParseResult::OK;
+    }
+
+private:
+    char *cur_ = nullptr;
+    char *end_ = nullptr;
+    RequestParseResult result_ = RequestParseResult::OK;
+
+    RequestParseResult fail() {
+        if (result_ == RequestParseResult::OK) result_ = RequestParseResult::MALFORMED;
+        return result_;
+    }
+
+    void skip_ws() {
+        while (cur_ != end_ && (*cur_ == ' ' || *cur_ == '\t' || *cur_ == '\n' || *cur_ == '\r')) cur_++;
+    }
+
+    bool consume(char c) {
+        skip_ws();
+        if (cur_ != end_ && *cur_ == c) {
+            cur_++;
+            return true;
+        }
+        return false;
+    }
+
+    bool peek(char c) {
+        skip_ws();
+        return cur_ != end_ && *cur_ == c;
+    }
+
+    bool consume_literal(const char *literal, size_t len) {
+        if (static_cast<size_t>(end_ - cur_) < len) return false;
+        for (size_t i = 0; i < len; i++) {
+            if (cur_[i] != literal[i]) return false;
+        }
+        cur_ += len;
+        return true;
+    }
+
+    static int hex_value(char c) {
+        if ('0' <= c && c <= '9') return c - '0';
+        if ('a' <= c && c <= 'f') return c - 'a' + 10;
+        if ('A' <= c && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    bool parse_hex4(uint32_t &code) {
+        if (end_ - cur_ < 4) return false;
+        code = 0;
+        for (int i = 0; i < 4; i++) {
+            int v = hex_value(cur_[i]);
+            if (v < 0) return false;
+            code = (code << 4) | static_cast<uint32_t>(v);
+        }
+        cur_ += 4;
+        return true;
+    }
+
+    // write a code point as UTF-8 at out (at most 4 bytes, never beyond the consumed escape)
+    static char *write_utf8(char *out, uint32_t code) {
+        if (code < 0x80) {
+            *out++ = static_cast<char>(code);
+        } else if (code < 0x800) {
+            *out++ = static_cast<char>(0xC0 | (code >> 6));
+            *out++ = static_cast<char>(0x80 | (code & 0x3F));
+        } else if (code < 0x10000) {
+            *out++ = static_cast<char>(0xE0 | (code >> 12));
+            *out++ = static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            *out++ = static_cast<char>(0x80 | (code & 0x3F));
+        } else {
+            *out++ = static_cast<char>(0xF0 | (code >> 18));
+            *out++ = static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+            *out++ = static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+            *out++ = static_cast<char>(0x80 | (code & 0x3F));
+        }
+        return out;
+    }
+
+    /**
+     * @brief Parse a string and return a view of its (in-place decoded) contents
+    */
+    bool parse_string(std::string_view &out) {
+        if (!consume('"')) return false;
+        char *begin = cur_;
+        char *write = cur_;
+
+        // fast path: no escape sequence, the view is the raw bytes
+        while (cur_ != end_ && *cur_ != '"' && *cur_ != '\\') {
+            if (static_cast<unsigned char>(*cur_) < 0x20) return false;  // control characters must be escaped
+            cur_++;
+        }
+        write = cur_;
+
+        // slow path: decode escape sequences in place
+        while (cur_ != end_ && *cur_ != '"') {
+            char c = *cur_++;
+            if (static_cast<unsigned char>(c) < 0x20) return false;
+            if (c != '\\') {
+                *write++ = c;
+                continue;
+            }
+            if (cur_ == end_) return false;
+            char e = *cur_++;
+            switch (e) {
+                case '"':  *write++ = '"';  break;
+                case '\\': *write++ = '\\'; break;
+                case '/':  *write++ = '/';  break;
+                case 'b':  *write++ = '\b'; break;
+                case 'f':  *write++ = '\f'; break;
+                case 'n':  *write++ = '\n'; break;
+                case 'r':  *write++ = '\r'; break;
+                case 't':  *write++ = '\t'; break;
+                case 'u': {
+                    uint32_t code;
+                    if (!parse_hex4(code)) return false;
+                    if (0xD800 <= code && code <= 0xDBFF) {
+                        // surrogate pair (code points beyond the BMP)
+                        uint32_t low;
+                        if (!consume_literal("\\u", 2) || !parse_hex4(low)) return false;
+                        if (low < 0xDC00 || 0xDFFF < low) return false;
+                        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+                    } else if (0xDC00 <= code && code <= 0xDFFF) {
+                        return false;
+                    }
+                    write = write_utf8(write, code);
+                    break;
+                }
+                default:
+                    return false;
+            }
+        }
+        if (cur_ == end_) return false; // unterminated string
+        cur_++;                         // closing quote
+        out = std::string_view(begin, static_cast<size_t>(write - begin));
+        return true;
+    }
+
+    bool parse_integer(long int &out) {
+        skip_ws();
+        bool negative = false;
+        if (cur_ != end_ && *cur_ == '-') {
+            negative = true;
+            cur_++;
+        }
+        if (cur_ == end_ || *cur_ < '0' || '9' < *cur_) return false;
+        long int value = 0;
+        while (cur_ != end_ && '0' <= *cur_ && *cur_ <= '9') {
+            long int digit = *cur_ - '0';
+            if (value > (LONG_MAX - digit) / 10) return false;     // overflow
+            value = value * 10 + digit;
+            cur_++;
+        }
+        // timestamps are integers, reject fractions and exponents
+        if (cur_ != end_ && (*cur_ == '.' || *cur_ == 'e' || *cur_ == 'E')) return false;
+        out = negative ? -value : value;
+        return true;
+    }
+
+    bool parse_unsigned(uint64_t &out) {
+        skip_ws();
+        if (cur_ == end_ || *cur_ < '0' || '9' < *cur_) return false;
+        uint64_t value = 0;
+        while (cur_ != end_ && '0' <= *cur_ && *cur_ <= '9') {
+            uint64_t digit = static_cast<uint64_t>(*cur_ - '0');
+            if (value > (UINT64_MAX - digit) / 10) return false;   // overflow
+            value = value * 10 + digit;
+            cur_++;
+        }
+        if (cur_ != end_ && (*cur_ == '.' || *cur_ == 'e' || *cur_ == 'E')) return false;
+        out = value;
+        return true;
+    }
+
+    bool parse_bool(bool &out) {
+        skip_ws();
+        if (consume_literal("true", 4)) {
+            out = true;
+            return true;
+        }
+        if (consume_literal("false", 5)) {
+            out = false;
+            return true;
+        }
+        return false;
+    }
+
+    /**
+     * @brief Skip any JSON value (used for unknown keys)
+     * @param depth number of arrays/objects the value is nested in, values nested deeper
+     *              than JSON_MAX_NESTING_DEPTH are rejected to bound the recursion
+    */
+    bool skip_value(size_t depth = 0) {
+        skip_ws();
+        if (cur_ == end_) return false;
+        std::string_view unused;
+        switch (*cur_) {
+            case '"':
+                return parse_string(unused);
+            case '{':
+                if (depth >= JSON_MAX_NESTING_DEPTH) return false;
+                cur_++;
+                if (consume('}')) return true;
+                do {
+                    if (!parse_string(unused) || !consume(':') || !skip_value(depth + 1)) return false;
+                } while (consume(','));
+                return consume('}');
+            case '[':
+                if (depth >= JSON_MAX_NESTING_DEPTH) return false;
+                cur_++;
+                if (consume(']')) return true;
+                do {
+                    if (!skip_value(depth + 1)) return false;
+                } while (consume(','));
+                return consume(']');
+            case 't':
+                return consume_literal("true", 4);
+            case 'f':
+                return consume_literal("false", 5);
+            case 'n':
+                return consume_literal("null", 4);
+            default: {
+                char *begin = cur_;
+                while (cur_ != end_ && (('0' <= *cur_ && *cur_ <= '9') || *cur_ == '-' || *cur_ == '+' ||
+                                        *cur_ == '.' || *cur_ == 'e' || *cur_ == 'E')) {
+                    cur_++;
+                }
+                return cur_ != begin;
+            }
+        }
+    }
+
+    /**
+     * @brief Parse the "transaction" array and append a Procedure per element
+    */
+    bool parse_transaction(std::vector<Procedure> &procedures) {
+        if (!consume('[')) return false;
+        if (consume(']')) return true;
+        do {
+            if (!parse_operation(procedures)) return false;
+        } while (consume(','));
+        return consume(']');
+    }
+
+    bool parse_operation(std::vector<Procedure> &procedures) {
+        std::string_view operation, key, value, left_key, right_key;
+        bool l_exclusive = false, r_exclusive = false, reverse = false;
+        uint64_t limit = 0;
+        bool has_operation = false, has_key = false, has_left_key = false, has_right_key = false;
+
+        if (!consume('{')) return false;
+        if (!peek('}')) {
+            do {
+                std::string_view name;
+                if (!parse_string(name) || !consume(':')) return false;
+
+                bool ok;
+                if (name == "operation") {
+                    ok = parse_string(operation);
+                    has_operation = true;
+                } else if (name == "key") {
+                    ok = parse_string(key);
+                    has_key = true;
+                } else if (name == "value") {
+                    ok = parse_string(value);
+                } else if (name == "left_key") {
+                    ok = parse_string(left_key);
+                    has_left_key = true;
+                } else if (name == "right_key") {
+                    ok = parse_string(right_key);
+                    has_right_key = true;
+                } else if (name == "l_exclusive") {
+                    ok = parse_bool(l_exclusive);
+                } else if (name == "r_exclusive") {
+                    ok = parse_bool(r_exclusive);
+                } else if (name == "limit") {
+                    ok = parse_unsigned(limit) && limit <= UINT32_MAX;
+                } else if (name == "reverse") {
+                    ok = parse_bool(reverse);
+                } else {
+                    ok = skip_value();
+                }
+                if (!ok) return false;
+            } while (consume(','));
+        }
+        if (!consume('}')) return false;
+        if (!has_operation) return false;
+
+        OpType op_type;
+        if (operation == "INSERT") {
+            op_type = OpType::INSERT;
+        } else if (operation == "DELETE") {
+            op_type = OpType::DELETE;
+        } else if (operation == "READ") {
+            op_type = OpType::READ;
+        } else if (operation == "WRITE") {
+            op_type = OpType::WRITE;
+        } else if (operation == "SCAN") {
+            op_type = OpType::SCAN;
+        } else {
+            result_ = RequestParseResult::UNKNOWN_OPERATION;
+            return false;
+        }
+
+        if (op_type == OpType::SCAN) {
+            if (!has_left_key || !has_right_key) return false;
+            procedures.emplace_back(op_type, left_key, l_exclusive, right_key, r_exclusive,
+                                    static_cast<uint32_t>(limit), reverse);
+        } else {
+            if (!has_key) return false;
+            // If value does not exist (e.g., READ, DELETE), it stays empty
+            procedures.emplace_back(op_type, key, value);
+        }
+        return true;
+    }
+};
@@ -0,0 +1,221 @@
+#pragma once
+
+#include <array>
+#include <mutex>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cassert>
+#include <cstring>
+
+#include "consts.h"
+
+/**
+ * @class SlabAllocator
+ * @brief Size-classed allocator for small, frequently allocated objects (records, value bodies)
+ *
+ * @note  Blocks are carved from SLAB_CHUNK_SIZE chunks and aligned to 64 bytes, size classes are
+ *        multiples of 64 bytes up to SLAB_MAX_BLOCK_SIZE. Larger requests fall back to the heap.
+ *        Every thread keeps a small free list per class (thread_local, plain data so the enclave
+ *        TLS needs no constructor), which serves the hot path without any lock. A thread whose
+ *        cache overflows (e.g. the worker freeing retired objects allocated by other workers)
+ *        gives half of it back to the shared depot, a thread whose cache is empty takes a
+ *        batch from the depot (or from a new chunk) under a mutex.
+ *        Chunks are never returned to the enclave heap, freed blocks are reused for the same class.
+ *        A new chunk is touched as a whole before it is used (and reserve() carves ahead of time),
+ *        so its EPC pages are committed up front rather than faulted in one by one on the hot path.
+ *        The pre-touch runs outside the mutex, so other threads keep refilling while a chunk is faulted in.
+ */
+class SlabAllocator {
+public:
+    static constexpr size_t BLOCK_ALIGN = 64;
+    static constexpr size_t NUM_CLASSES = 12;
+    static constexpr uint8_t HEAP_CLASS = 0xff;  // not served by a slab
+
+    struct Stats {
+        size_t block_size = 0;
+        size_t carved = 0;      // blocks carved from chunks so far (capacity of the pool)
+        size_t free = 0;        // free blocks in the shared depot
+        // blocks in use, or free in a thread cache
+        size_t occupied() const { return carved - free; }
+    };
+
+    static SlabAllocator &instance() {
+        static SlabAllocator allocator;
+        return allocator;
+    }
+
+    /**
+     * @brief Size class serving size bytes, HEAP_CLASS if it is too large for a slab
+     */
+    static uint8_t size_class(size_t size) {
+        for (uint8_t c = 0; c < NUM_CLASSES; c++) {
+            if (size <= CLASS_SIZES[c]) return c;
+        }
+        return HEAP_CLASS;
+    }
+
+    static size_t class_size(uint8_t size_class) {
+        assert(size_class < NUM_CLASSES);
+        return CLASS_SIZES[size_class];
+    }
+
+    /**
+     * @brief Allocate a block of the size class (64-byte aligned)
+     */
+    void *allocate(uint8_t size_class) {
+        if (size_class == HEAP_CLASS) return nullptr;
+        assert(size_class < NUM_CLASSES);
+        ThreadCache &cache = thread_cache();
+        if (cache.heads[size_class] == nullptr) refill(cache, size_class);
+        FreeBlock *block = cache.heads[size_class];
+        cache.heads[size_class] = block->next;
+        cache.counts[size_class]--;
+        return block;
+    }
+
+    /**
+     * @brief Carve blocks ahead of time until the depot holds at least blocks free blocks
+     * @note Call at startup, e.g. for the expected number of Masstree nodes
+     */
+    void reserve(uint8_t size_class, size_t blocks) {
+        assert(size_class < NUM_CLASSES);
+        std::unique_lock<std::mutex> lock(mutex_);
+        Depot &depot = depots_[size_class];
+        while (depot.count < blocks) {
+            FreeBlock *block = carve(depot, size_class);
+            if (block == nullptr) {
+                add_chunk(lock, depot, size_class);
+                continue;
+            }
+            block->next = depot.head;
+            depot.head = block;
+            depot.count++;
+        }
+    }
+
+    Stats stats(uint8_t size_class) {
+        assert(size_class < NUM_CLASSES);
+        std::lock_guard<std::mutex> lock(mutex_);
+        Stats stats;
+        stats.block_size = CLASS_SIZES[size_class];
+        stats.carved = depots_[size_class].carved;
+        stats.free = depots_[size_class].count;
+        return stats;
+    }
+
+    /**
+     * @brief Return a block obtained from allocate(size_class)
+     */
+    void deallocate(void *ptr, uint8_t size_class) {
+        assert(ptr != nullptr && size_class < NUM_CLASSES);
+        ThreadCache &cache = thread_cache();
+        FreeBlock *block = static_cast<FreeBlock*>(ptr);
+        block->next = cache.heads[size_class];
+        cache.heads[size_class] = block;
+        if (++cache.counts[size_class] > SLAB_CACHE_SIZE) spill(cache, size_class);
+    }
+
+private:
+    static constexpr std::array<size_t, NUM_CLASSES> CLASS_SIZES = {
+        64, 128, 192, 256, 384, 512, 768, 1024, 1536, 2048, 3072, 4096
+    };
+    static_assert(CLASS_SIZES[NUM_CLASSES - 1] == SLAB_MAX_BLOCK_SIZE, "the largest class must be SLAB_MAX_BLOCK_SIZE");
+    static_assert(SLAB_CHUNK_SIZE >= SLAB_MAX_BLOCK_SIZE * SLAB_CACHE_SIZE, "a chunk must hold a whole refill");
+
+    struct FreeBlock {
+        FreeBlock *next;
+    };
+
+    struct ThreadCache {
+        FreeBlock *heads[NUM_CLASSES];
+        uint32_t counts[NUM_CLASSES];
+    };
+
+    struct Depot {
+        FreeBlock *head = nullptr;
+        size_t count = 0;
+        char *chunk_cursor = nullptr;   // unused part of the current chunk
+        char *chunk_end = nullptr;
+        size_t carved = 0;
+    };
+
+    std::mutex mutex_;
+    std::array<Depot, NUM_CLASSES> depots_{};
+    std::vector<char*> chunks_;     // kept for the lifetime of the enclave
+
+    SlabAllocator() = default;
+    SlabAllocator(const SlabAllocator&) = delete;
+    SlabAllocator& operator=(const SlabAllocator&) = delete;
+
+    static ThreadCache &thread_cache() {
+        static thread_local ThreadCache cache = {};
+        return cache;
+    }
+
+    // cut a new block from the current chunk of the class, nullptr if the chunk is used up, mutex_ must be held
+    FreeBlock *carve(Depot &depot, uint8_t size_class) {
+        const size_t block_size = CLASS_SIZES[size_class];
+        if (depot.chunk_cursor == nullptr || depot.chunk_cursor + block_size > depot.chunk_end) return nullptr;
+        FreeBlock *block = reinterpret_cast<FreeBlock*>(depot.chunk_cursor);
+        depot.chunk_cursor += block_size;
+        depot.carved++;
+        return block;
+    }
+
+    // allocate and pre-touch a new chunk without holding mutex_, then make it the current chunk of the class
+    void add_chunk(std::unique_lock<std::mutex> &lock, Depot &depot, uint8_t size_class) {
+        lock.unlock();
+        char *chunk = new char[SLAB_CHUNK_SIZE + BLOCK_ALIGN];
+        std::memset(chunk, 0, SLAB_CHUNK_SIZE + BLOCK_ALIGN);  // pre-touch
+        lock.lock();
+
+        chunks_.push_back(chunk);
+        // another thread may have added a chunk in the meantime, its unused blocks go to the depot
+        while (FreeBlock *block = carve(depot, size_class)) {
+            block->next = depot.head;
+            depot.head = block;
+            depot.count++;
+        }
+        uintptr_t base = (reinterpret_cast<uintptr_t>(chunk) + BLOCK_ALIGN - 1) & ~(uintptr_t)(BLOCK_ALIGN - 1);
+        depot.chunk_cursor = reinterpret_cast<char*>(base);
+        depot.chunk_end = depot.chunk_cursor + SLAB_CHUNK_SIZE;
+    }
+
+    // take SLAB_CACHE_SIZE / 2 blocks from the depot, carving a new chunk if needed
+    void refill(ThreadCache &cache, uint8_t size_class) {
+        const size_t batch = SLAB_CACHE_SIZE / 2;
+        std::unique_lock<std::mutex> lock(mutex_);
+        Depot &depot = depots_[size_class];
+        size_t taken = 0;
+        while (taken < batch) {
+            FreeBlock *block = depot.head;
+            if (block != nullptr) {
+                depot.head = block->next;
+                depot.count--;
+            } else if ((block = carve(depot, size_class)) == nullptr) {
+                add_chunk(lock, depot, size_class);     // the depot may also have been refilled meanwhile
+                continue;
+            }
+            block->next = cache.heads[size_class];
+            cache.heads[size_class] = block;
+            cache.counts[size_class]++;
+            taken++;
+        }
+    }
+
+    // give half of the cache back to the depot
+    void spill(ThreadCache &cache, uint8_t size_class) {
+        const size_t batch = cache.counts[size_class] / 2;
+        std::lock_guard<std::mutex> lock(mutex_);
+        Depot &depot = depots_[size_class];
+        for (size_t i = 0; i < batch; i++) {
+            FreeBlock *block = cache.heads[size_class];
+            cache.heads[size_class] = block->next;
+            block->next = depot.head;
+            depot.head = block;
+        }
+        cache.counts[size_class] -= batch;
+        depot.count += batch;
+    }
+};
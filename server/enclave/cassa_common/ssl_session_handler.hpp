@@ -1,36 +1,102 @@
 #pragma once
 
 #include <openssl/ssl.h>
-#include <map>
 #include <vector>
 #include <string>
+#include <string_view>
+#include <cstring>
 #include <cassert>
+#include <algorithm>
 #include <mutex>
+#include <atomic>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
 
 #include "random.h"
+#include "structures.h"
+#include "consts.h"
 
 // for t_print()
 #include "../../../common/common.h"
 #include "../../../common/log_macros.h"
+// for tls_write_to_session_peer()
+#include "../../../common/openssl_utility.h"
+// for WireFormat
+#include "../../../common/binary_protocol.hpp"
 
+#define SESSION_ID_LENGTH 6
+
+/**
+ * @brief Slot of the session table
+ * @note Slots are allocated once and never moved, so a pointer to a slot stays
+ *       valid for the lifetime of the handler. Whether the slot still holds the
+ *       session a handle refers to must be checked under ssl_session_mutex.
+*/
 struct SSLSession {
-    SSL* ssl_session;  // SSL session
-    long latest_timestamp_sec;  // latest timestamp (second)
-    long latest_timestamp_nsec; // latest timestamp (nanosecond)
-    std::unique_ptr<std::mutex> ssl_session_mutex;  // mutex for SSL session
-
-    SSLSession(SSL* ssl) 
-        : ssl_session(ssl), latest_timestamp_sec(0), 
-          latest_timestamp_nsec(0), ssl_session_mutex(std::make_unique<std::mutex>()) {}
+    SSL* ssl_session = nullptr;  // SSL session
+    int socket_fd = -1;          // underlying socket, registered to the readiness wait of its shard
+    size_t shard_id = 0;         // ingress shard (session monitor) serving this session
+    uint32_t generation = 0;     // incremented every time the slot is released
+    bool active = false;         // true while the slot holds a session
+    char session_id[SESSION_ID_LENGTH + 1] = {0};  // printable session ID handed to the client
+    long latest_timestamp_sec = 0;   // latest timestamp (second)
+    long latest_timestamp_nsec = 0;  // latest timestamp (nanosecond)
+    long established_timestamp_sec = 0;   // timestamp of /get_session_id (second)
+    long established_timestamp_nsec = 0;  // timestamp of /get_session_id (nanosecond)
+    uint64_t highest_session_tx_id = 0;   // highest session_tx_id accepted so far
+    uint64_t session_tx_id_window[SESSION_TX_ID_WINDOW / 64] = {0};  // accepted session_tx_ids, bit (id % SESSION_TX_ID_WINDOW)
+    WireFormat wire_format = WireFormat::JSON;  // encoding of responses, negotiated in /get_session_id
+    uint32_t in_flight = 0;          // admitted transactions whose response has not been written yet
+    bool paused = false;             // unregistered from the readiness wait by the backpressure policy (monitor only)
+    std::string deferred_request;    // request read while the worker queues were full (backpressure policy)
+    std::mutex ssl_session_mutex;    // mutex for SSL session and the fields above
+};
+
+/**
+ * @brief Ingress shard, served by one session monitor thread
+*/
+struct SessionShard {
+    int epoll_fd_ = -1;  // readiness wait instance of the shard
+    std::mutex mutex_;   // protects fd_to_handle_ (acceptor inserts, monitor looks up)
+    std::unordered_map<int, SessionHandle> fd_to_handle_; // socket fd -> session handle
 };
 
 class SSLSessionHandler {
 public:
-    std::map<std::string, SSLSession> ssl_sessions_; // session ID -> SSL session
-    Xoroshiro128Plus rnd_;  // random number generator
+    std::unique_ptr<SSLSession[]> sessions_;    // session slots, indexed by the lower 32 bits of the handle
+    std::unique_ptr<SessionShard[]> shards_;    // ingress shards
+    size_t max_sessions_ = 0;
+    size_t num_shards_ = 0;
 
     SSLSessionHandler() {}
 
+    /**
+     * @brief Allocate the session table and the ingress shards
+     * @param max_sessions maximum number of concurrent sessions
+     * @param num_shards number of ingress shards (session monitor threads)
+     * @note epoll instances of the shards are created by the caller (OCALL)
+    */
+    void init(size_t max_sessions, size_t num_shards) {
+        assert(max_sessions > 0 && num_shards > 0);
+        max_sessions_ = max_sessions;
+        num_shards_ = num_shards;
+        sessions_.reset(new SSLSession[max_sessions]);
+        shards_.reset(new SessionShard[num_shards]);
+
+        // hand out low slot indexes first
+        free_slots_.clear();
+        for (size_t i = max_sessions; i > 0; i--) {
+            free_slots_.push_back(static_cast<uint32_t>(i - 1));
+        }
+    }
+
+    static uint32_t slotIndex(SessionHandle handle) { return static_cast<uint32_t>(handle); }
+    static uint32_t slotGeneration(SessionHandle handle) { return static_cast<uint32_t>(handle >> 32); }
+    static SessionHandle makeHandle(uint32_t slot, uint32_t generation) {
+        return (static_cast<SessionHandle>(generation) << 32) | slot;
+    }
+
     /**
      * @brief Convert a number to a character
      * @param[in] num number to convert
@@ -47,117 +113,345 @@ public:
     /**
      * @brief Generate a session ID
      * @return Session ID
-     * @note Session ID is a 6-character string (hard-coded)
+     * @note Session ID is a SESSION_ID_LENGTH-character string
     */
     std::string generateSessionID() {
         std::string id;
-        for (int i = 0; i < 6; i++) {
+        for (int i = 0; i < SESSION_ID_LENGTH; i++) {
             id += number_to_char(rnd_.next() % 36);
         }
         return id;
     }
 
     /**
-     * @brief Add a new SSL session to the map
+     * @brief Add a new SSL session to a free slot
      * @param ssl(SSL*) SSL session
-     * @return Session ID
+     * @param shard_id(size_t) ingress shard which will monitor the session
+     * @return Session handle, or INVALID_SESSION_HANDLE if the table is full
     */
-    std::string addSession(SSL *ssl) {
+    SessionHandle addSession(SSL *ssl, size_t shard_id) {
+        assert(shard_id < num_shards_);
+        uint32_t slot;
         std::string session_id;
-        // repeat until a unique session ID is generated
-        while (true) {
-            // generate session ID
-            session_id = generateSessionID();
-            if (ssl_sessions_.count(session_id) == 0) break; // check duplication
+        {
+            std::lock_guard<std::mutex> lock(free_slots_mutex_);
+            if (free_slots_.empty()) return INVALID_SESSION_HANDLE;
+            slot = free_slots_.back();
+            free_slots_.pop_back();
+
+            // repeat until a unique session ID is generated
+            while (true) {
+                session_id = generateSessionID();
+                if (active_session_ids_.count(session_id) == 0) break; // check duplication
+            }
+            active_session_ids_.insert(session_id);
+        }
+
+        SSLSession &session = sessions_[slot];
+        SessionHandle handle;
+        {
+            std::lock_guard<std::mutex> lock(session.ssl_session_mutex);
+            session.ssl_session = ssl;
+            session.socket_fd = SSL_get_fd(ssl);
+            session.shard_id = shard_id;
+            session.active = true;
+            std::memcpy(session.session_id, session_id.c_str(), SESSION_ID_LENGTH + 1);
+            session.latest_timestamp_sec = 0;
+            session.latest_timestamp_nsec = 0;
+            session.established_timestamp_sec = 0;
+            session.established_timestamp_nsec = 0;
+            session.highest_session_tx_id = 0;
+            std::memset(session.session_tx_id_window, 0, sizeof(session.session_tx_id_window));
+            session.wire_format = WireFormat::JSON;
+            session.in_flight = 0;
+            session.paused = false;
+            session.deferred_request.clear();
+            handle = makeHandle(slot, session.generation);
+        }
+
+        {
+            SessionShard &shard = shards_[shard_id];
+            std::lock_guard<std::mutex> lock(shard.mutex_);
+            shard.fd_to_handle_[session.socket_fd] = handle;
         }
-        // add session to the map
-        SSLSession new_session(ssl);
-        ssl_sessions_.emplace(std::make_pair(session_id, std::move(new_session)));
-        return session_id;
+        num_active_sessions_.fetch_add(1);
+        return handle;
     }
 
     /**
-     * @brief Retrieves the SSLSession structure associated with a given session ID.
-     * @param session_id Session ID
-     * @return Pointer to the SSLSession structure, or nullptr if not found.
+     * @brief Retrieves the slot associated with a given session handle in O(1).
+     * @param handle Session handle
+     * @return Pointer to the SSLSession slot, or nullptr if the handle is out of range.
+     * @note The slot may have been released (or reused) concurrently,
+     *       use isCurrent() under ssl_session_mutex before touching the SSL object.
     */
-    SSLSession* getSession(std::string session_id) {
-        auto it = ssl_sessions_.find(session_id);
-        if (it == ssl_sessions_.end()) return nullptr;  // if not found, return nullptr
+    SSLSession* getSession(SessionHandle handle) {
+        uint32_t slot = slotIndex(handle);
+        if (handle == INVALID_SESSION_HANDLE || slot >= max_sessions_) return nullptr;
+        return &sessions_[slot];
+    }
 
-        return &(it->second);  // return SSLSession pointer
+    /**
+     * @brief Check whether the slot still holds the session of the handle
+     * @note The caller must hold session->ssl_session_mutex
+    */
+    static bool isCurrent(const SSLSession *session, SessionHandle handle) {
+        return session->active && session->generation == slotGeneration(handle);
     }
 
-    void setTimestamp(std::string session_id, long timestamp_sec, long timestamp_nsec) {
-        // get SSL session corresponding to the session ID
-        auto it = ssl_sessions_.find(session_id);
-        if (it == ssl_sessions_.end()) return;  // if not found, do nothing
-    
+    /**
+     * @brief Look up the session handle bound to a socket fd in a shard
+     * @param shard_id ingress shard
+     * @param fd socket fd reported by the readiness wait
+     * @return Session handle, or INVALID_SESSION_HANDLE if the fd is not (or no longer) bound to a session
+    */
+    SessionHandle getSessionHandleByFd(size_t shard_id, int fd) {
+        SessionShard &shard = shards_[shard_id];
+        std::lock_guard<std::mutex> lock(shard.mutex_);
+        auto it = shard.fd_to_handle_.find(fd);
+        if (it == shard.fd_to_handle_.end()) return INVALID_SESSION_HANDLE;
+        return it->second;
+    }
+
+    /**
+     * @brief Printable session ID of the handle (for logging)
+     * @note The returned pointer refers to the slot, it may be overwritten if the slot is reused.
+    */
+    const char* getSessionIDString(SessionHandle handle) {
+        SSLSession *session = getSession(handle);
+        if (session == nullptr) return "------";
+        return session->session_id;
+    }
+
+    /**
+     * @brief Check whether the session ID sent by the client matches the session of the handle
+    */
+    bool matchSessionID(SessionHandle handle, std::string_view session_id) {
+        SSLSession *session = getSession(handle);
+        if (session == nullptr) return false;
+        std::lock_guard<std::mutex> lock(session->ssl_session_mutex);
+        return isCurrent(session, handle) && session_id == session->session_id;
+    }
+
+    void setTimestamp(SessionHandle handle, long timestamp_sec, long timestamp_nsec) {
+        SSLSession *session = getSession(handle);
+        if (session == nullptr) return;  // if not found, do nothing
+        std::lock_guard<std::mutex> lock(session->ssl_session_mutex);
+        if (!isCurrent(session, handle)) return;
+
         // set timestamp
-        it->second.latest_timestamp_sec = timestamp_sec;
-        it->second.latest_timestamp_nsec = timestamp_nsec;
+        session->latest_timestamp_sec = timestamp_sec;
+        session->latest_timestamp_nsec = timestamp_nsec;
     }
 
-    long int getTimestampSec(std::string session_id) {
-        // get SSL session corresponding to the session ID
-        auto it = ssl_sessions_.find(session_id);
-        if (it == ssl_sessions_.end()) return 0;  // if not found, do nothing
+    /**
+     * @brief Replay check of a pipelined request
+     * @param handle Session handle
+     * @param session_tx_id per-session sequence number of the request (must be > 0)
+     * @param timestamp_sec, timestamp_nsec timestamp of the request
+     * @return true if the request is accepted (and recorded), false if it is a replay,
+     *         too old, or the session no longer exists
+     * @details Requests of a session may be executed by different workers, so they
+     *          can arrive here out of order. Instead of requiring monotonically
+     *          increasing timestamps, every session_tx_id is accepted once within a
+     *          sliding window of SESSION_TX_ID_WINDOW behind the highest one seen.
+     *          The timestamp only has to be newer than the /get_session_id command.
+    */
+    bool acceptSessionTxId(SessionHandle handle, uint64_t session_tx_id, long timestamp_sec, long timestamp_nsec) {
+        assert(session_tx_id != 0);
+        SSLSession *session = getSession(handle);
+        if (session == nullptr) return false;
+        std::lock_guard<std::mutex> lock(session->ssl_session_mutex);
+        if (!isCurrent(session, handle)) return false;
+
+        if (timestamp_sec < session->established_timestamp_sec ||
+            (timestamp_sec == session->established_timestamp_sec && timestamp_nsec <= session->established_timestamp_nsec)) {
+            return false;
+        }
+
+        uint64_t *window = session->session_tx_id_window;
+        const uint64_t highest = session->highest_session_tx_id;
+        if (session_tx_id > highest) {
+            // slide the window, forgetting the ids that fall out of it
+            if (session_tx_id - highest >= SESSION_TX_ID_WINDOW) {
+                std::memset(window, 0, sizeof(session->session_tx_id_window));
+            } else {
+                for (uint64_t id = highest + 1; id < session_tx_id; id++) {
+                    window[(id % SESSION_TX_ID_WINDOW) / 64] &= ~(1ULL << (id % 64));
+                }
+            }
+            session->highest_session_tx_id = session_tx_id;
+        } else if (highest - session_tx_id >= SESSION_TX_ID_WINDOW) {
+            return false;   // too old to tell whether it has been seen
+        } else if (window[(session_tx_id % SESSION_TX_ID_WINDOW) / 64] & (1ULL << (session_tx_id % 64))) {
+            return false;   // replay
+        }
+        window[(session_tx_id % SESSION_TX_ID_WINDOW) / 64] |= 1ULL << (session_tx_id % 64);
 
-        return it->second.latest_timestamp_sec;
+        // keep the latest timestamp for non-pipelined requests
+        if (timestamp_sec > session->latest_timestamp_sec ||
+            (timestamp_sec == session->latest_timestamp_sec && timestamp_nsec > session->latest_timestamp_nsec)) {
+            session->latest_timestamp_sec = timestamp_sec;
+            session->latest_timestamp_nsec = timestamp_nsec;
+        }
+        return true;
     }
 
-    long int getTimestampNsec(std::string session_id) {
-        // get SSL session corresponding to the session ID
-        auto it = ssl_sessions_.find(session_id);
-        if (it == ssl_sessions_.end()) return 0;  // if not found, do nothing
+    /**
+     * @brief Wire format negotiated by the session (JSON if the session no longer exists)
+    */
+    WireFormat getWireFormat(SessionHandle handle) {
+        SSLSession *session = getSession(handle);
+        if (session == nullptr) return WireFormat::JSON;
+        std::lock_guard<std::mutex> lock(session->ssl_session_mutex);
+        if (!isCurrent(session, handle)) return WireFormat::JSON;
+        return session->wire_format;
+    }
+
+    /**
+     * @brief Get the latest timestamp of the session
+     * @return false if the session no longer exists
+    */
+    bool getTimestamp(SessionHandle handle, long &timestamp_sec, long &timestamp_nsec) {
+        SSLSession *session = getSession(handle);
+        if (session == nullptr) return false;
+        std::lock_guard<std::mutex> lock(session->ssl_session_mutex);
+        if (!isCurrent(session, handle)) return false;
+
+        timestamp_sec = session->latest_timestamp_sec;
+        timestamp_nsec = session->latest_timestamp_nsec;
+        return true;
+    }
+
+    /**
+     * @brief Send a message to the client of the session
+     * @param handle Session handle
+     * @param payload message to send
+     * @param completed_transactions number of admitted transactions answered by this message
+     * @return false if the session no longer exists
+     * @note Write errors are reported by tls_write_to_session_peer()
+    */
+    bool writeToSession(SessionHandle handle, const std::string &payload, uint32_t completed_transactions) {
+        SSLSession *session = getSession(handle);
+        if (session == nullptr) return false;
+        std::lock_guard<std::mutex> lock(session->ssl_session_mutex);
+        if (!isCurrent(session, handle)) return false;
+        tls_write_to_session_peer(session->ssl_session, payload);
+        completeTransactions(session, completed_transactions);
+        return true;
+    }
 
-        return it->second.latest_timestamp_nsec;
+    /**
+     * @brief Send several messages coalesced by append_framed_message() to the client of the session
+     * @param handle Session handle
+     * @param framed framed messages, written with a single SSL_write
+     * @param completed_transactions number of admitted transactions answered by these messages
+     * @return false if the session no longer exists
+    */
+    bool writeFramedToSession(SessionHandle handle, const std::string &framed, uint32_t completed_transactions) {
+        SSLSession *session = getSession(handle);
+        if (session == nullptr) return false;
+        std::lock_guard<std::mutex> lock(session->ssl_session_mutex);
+        if (!isCurrent(session, handle)) return false;
+        tls_write_framed_to_session_peer(session->ssl_session, framed);
+        completeTransactions(session, completed_transactions);
+        return true;
     }
 
     /**
-     * @brief Remove SSL session from the map
-     * @param session_id(std::string) Session ID
+     * @brief Number of active sessions
+    */
+    size_t size() { return num_active_sessions_.load(); }
+
+    /**
+     * @brief Remove SSL session from the table
+     * @param handle(SessionHandle) Session handle
      * @param ssl_error_code(int) SSL error code
+     * @return true if the session has been removed, false otherwise
+     * @note The socket itself is not closed here, it is owned by the session monitor.
     */
-    void removeSession(std::string session_id, int ssl_error_code) {
-        // get SSL session corresponding to the session ID
-        auto it = ssl_sessions_.find(session_id);
-        if (it == ssl_sessions_.end()) return;  // if not found, do nothing
+    bool removeSession(SessionHandle handle, int ssl_error_code) {
+        SSLSession *session = getSession(handle);
+        if (session == nullptr) return false;  // if not found, do nothing
+        const char *session_id = session->session_id;
 
         // error handling
         switch (ssl_error_code) {
             case SSL_ERROR_NONE:
                 // This error code is returned when SSL_read/SSL_write succeeds
-                // t_print(LOG_SESSION_START_BMAG "%s" LOG_SESSION_END BGRN "SSL operation completed successfully.\n" CRESET, session_id.c_str());  // remove SessionでのSSL_ERROR_NONEは正常にセッションが閉じられたことを示すはず
-                t_print(LOG_SESSION_START_BMAG "%s" LOG_SESSION_END BGRN "Session closed successfully.\n" CRESET, session_id.c_str());
+                // t_print(LOG_SESSION_START_BMAG "%s" LOG_SESSION_END BGRN "SSL operation completed successfully.\n" CRESET, session_id);  // remove SessionでのSSL_ERROR_NONEは正常にセッションが閉じられたことを示すはず
+                t_print(LOG_SESSION_START_BMAG "%s" LOG_SESSION_END BGRN "Session closed successfully.\n" CRESET, session_id);
                 break;
             case SSL_ERROR_SSL:
                 // This error code is returned when an error occurred (e.g, protocol error, handshake failure)
-                t_print(LOG_SESSION_START_BMAG "%s" LOG_SESSION_END BRED "A protocol error or handshake failure occurred.\n" CRESET, session_id.c_str());
+                t_print(LOG_SESSION_START_BMAG "%s" LOG_SESSION_END BRED "A protocol error or handshake failure occurred.\n" CRESET, session_id);
                 break;
             case SSL_ERROR_WANT_READ:
                 // This error code is returned when SSL_read finds no data in non-blocking mode, do nothing as it's normal behavior.
-                return;
+                return false;
             case SSL_ERROR_SYSCALL:
                 // This error code is returned when the client closes the connection without sending a close_notify alert
-                t_print(LOG_SESSION_START_BMAG "%s" LOG_SESSION_END BRED "Session may have closed unexpectedly.\n" CRESET, session_id.c_str());
+                t_print(LOG_SESSION_START_BMAG "%s" LOG_SESSION_END BRED "Session may have closed unexpectedly.\n" CRESET, session_id);
                 break;
             case SSL_ERROR_ZERO_RETURN:
                 // This error code is returned when the client closes the connection with sending a close_notify alert
-                t_print(LOG_SESSION_START_BMAG "%s" LOG_SESSION_END BGRN "Session closed successfully.\n" CRESET, session_id.c_str());
+                t_print(LOG_SESSION_START_BMAG "%s" LOG_SESSION_END BGRN "Session closed successfully.\n" CRESET, session_id);
                 break;
             default:
-                t_print(LOG_SESSION_START_BMAG "%s" LOG_SESSION_END BRED "Unknown error code: %d\n" CRESET, session_id.c_str(), ssl_error_code);
+                t_print(LOG_SESSION_START_BMAG "%s" LOG_SESSION_END BRED "Unknown error code: %d\n" CRESET, session_id, ssl_error_code);
                 break;
         }
 
-        // clean up SSL session
-        SSL *ssl_session = it->second.ssl_session;
-        if (ssl_session) {
-            SSL_free(ssl_session);
+        int socket_fd;
+        size_t shard_id;
+        std::string released_id;
+        {
+            std::lock_guard<std::mutex> lock(session->ssl_session_mutex);
+            if (!isCurrent(session, handle)) return false;
+
+            // clean up SSL session
+            if (session->ssl_session) {
+                SSL_free(session->ssl_session);
+            }
+            socket_fd = session->socket_fd;
+            shard_id = session->shard_id;
+            released_id = session->session_id;
+
+            // invalidate every handle to this slot
+            session->ssl_session = nullptr;
+            session->active = false;
+            session->generation++;
         }
 
-        // remove session from the map
-        ssl_sessions_.erase(it);
+        {
+            SessionShard &shard = shards_[shard_id];
+            std::lock_guard<std::mutex> lock(shard.mutex_);
+            shard.fd_to_handle_.erase(socket_fd);
+        }
+        {
+            std::lock_guard<std::mutex> lock(free_slots_mutex_);
+            active_session_ids_.erase(released_id);
+            free_slots_.push_back(slotIndex(handle));
+        }
+        num_active_sessions_.fetch_sub(1);
+        return true;
+    }
+
+private:
+    /**
+     * @brief Release the in-flight count of answered transactions
+     * @note The caller must hold session->ssl_session_mutex. The count is bound to the
+     *       slot generation by the caller's isCurrent() check, so responses to a closed
+     *       session never leak into the session that reuses the slot.
+    */
+    static void completeTransactions(SSLSession *session, uint32_t completed_transactions) {
+        assert(completed_transactions <= session->in_flight);
+        session->in_flight -= std::min(completed_transactions, session->in_flight);
     }
-};
\ No newline at end of file
+
+    std::mutex free_slots_mutex_;   // protects free_slots_, active_session_ids_ and rnd_
+    std::vector<uint32_t> free_slots_;
+    std::unordered_set<std::string> active_session_ids_;
+    std::atomic<size_t> num_active_sessions_{0};
+    Xoroshiro128Plus rnd_;  // random number generator
+};
@@ -6,10 +6,18 @@ class WorkerResult {
 public:
     uint64_t local_commit_count_ = 0;
     uint64_t local_abort_count_ = 0;
-    uint64_t local_abort_vp1_count_ = 0;
-    uint64_t local_abort_vp2_count_ = 0;
-    uint64_t local_abort_vp3_count_ = 0;
+    uint64_t local_abort_vp1_count_ = 0;        // a record of the write set stayed locked or was purged (lockWriteSet)
+    uint64_t local_abort_vp2_count_ = 0;        // a record of the read set was written or purged since it was read
+    uint64_t local_abort_vp3_count_ = 0;        // a record of the read set is locked by another transaction
     uint64_t local_abort_nullBuffer_count_ = 0;
+    uint64_t local_lock_wait_count_ = 0;        // records locked by lockWriteSet() after waiting for another transaction
+    uint64_t local_purged_record_count_ = 0;    // deleted records removed from Masstree
+    uint64_t local_purged_byte_count_ = 0;      // memory released by the purge (Value + body)
+
+    // カウンタを書くのは担当のワーカーだけだが、統計の表示で他のスレッドが読むのでrelaxedなatomic storeで更新する
+    static void add(uint64_t &counter, uint64_t n = 1) {
+        __atomic_store_n(&counter, counter + n, __ATOMIC_RELAXED);
+    }
 };
 
 class LoggerResult {
@@ -40,4 +48,11 @@ enum class OpType : uint8_t {
     DELETE,
     SCAN,
     RMW,
-};
\ No newline at end of file
+};
+
+// Dense integer handle of a client session.
+// The lower 32 bits are the slot index in SSLSessionHandler, and the upper
+// 32 bits are the generation of the slot, so that a handle kept by an
+// in-flight transaction never resolves to a newer session reusing the slot.
+typedef uint64_t SessionHandle;
+#define INVALID_SESSION_HANDLE (~(SessionHandle)0)
@@ -1,101 +1,361 @@
 #pragma once
 
-#include <queue>
-#include <mutex>
+#include <atomic>
+#include <memory>
 #include <vector>
 #include <string>
 #include <cassert>
+#include <cstdint>
+#include <string_view>
+#include <functional>
 
 #include "random.h"
+#include "consts.h"
+#include "structures.h"
+#include "idle_strategy.hpp"
 #include "../../../common/common.h"
+#include "../../../common/log_macros.h"
+#include "../../../common/binary_protocol.hpp"
+#include "../../../common/transaction_routing.h"
+
+/**
+ * @brief Transaction received from a client, tagged with the session it came from
+*/
+struct TransactionRequest {
+    SessionHandle session_handle_ = INVALID_SESSION_HANDLE;
+    std::string payload_;   // JSON or binary encoded transaction
+
+    TransactionRequest() = default;
+    TransactionRequest(SessionHandle session_handle, std::string payload)
+        : session_handle_(session_handle), payload_(std::move(payload)) {}
+};
 
 /**
  * @class TransactionQueue
- * @brief Thread-safe transaction queue for each worker
- * 
- * @note  This class offers functionalities to add and retrieve 
- *        transactions (as JSON strings) to/from a queue. 
- *        If the queue is empty, getTransaction returns an empty string.
+ * @brief Bounded lock-free transaction queue for each worker
+ *
+ * @note  Ring buffer with a sequence number per cell (D. Vyukov's bounded MPMC queue).
+ *        Session monitors enqueue, the owner worker dequeues, and idle workers may
+ *        steal (dequeue) from it as well, so both ends are multi-threaded.
+ *        Requests are moved in and out, the payload buffer is never copied.
+ *        The capacity is a power of two (TRANSACTION_QUEUE_CAPACITY).
+ *        An idle owner parks on spot_, which every enqueue wakes.
 */
 class TransactionQueue {
 public:
-    TransactionQueue() = default;
+    TransactionQueue() : buffer_(new Cell[TRANSACTION_QUEUE_CAPACITY]), mask_(TRANSACTION_QUEUE_CAPACITY - 1) {
+        static_assert((TRANSACTION_QUEUE_CAPACITY & (TRANSACTION_QUEUE_CAPACITY - 1)) == 0,
+                      "TRANSACTION_QUEUE_CAPACITY must be a power of two");
+        for (size_t i = 0; i < TRANSACTION_QUEUE_CAPACITY; i++) {
+            buffer_[i].sequence_.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    TransactionQueue(const TransactionQueue&) = delete;
+    TransactionQueue& operator=(const TransactionQueue&) = delete;
 
     /**
      * @brief Enqueue transaction to the queue
-     * @param json_transaction(std::string) Transaction in JSON format
+     * @param request(TransactionRequest) Transaction and its session handle, moved only on success
+     * @return false if the queue is full
     */
-    void putTransaction(const std::string &json_transaction) {
-        transaction_queue_.push(json_transaction);
+    bool putTransaction(TransactionRequest &&request) {
+        Cell *cell;
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        while (true) {
+            cell = &buffer_[pos & mask_];
+            size_t seq = cell->sequence_.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                // the cell is free, claim it
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false;   // full
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->request_ = std::move(request);
+        cell->sequence_.store(pos + 1, std::memory_order_release);
+        spot_.wake();
+        return true;
     }
 
     /**
      * @brief Dequeue transaction from the queue if exists
-     * @return json_transaction(std::string) Transaction in JSON format
+     * @param request(TransactionRequest) Dequeued transaction
+     * @return true if a transaction has been dequeued, false if the queue is empty
     */
-    std::string getTransaction() {
-        if (transaction_queue_.empty()) {
-            return "";  // if queue is empty, return empty string
+    bool getTransaction(TransactionRequest &request) {
+        Cell *cell;
+        size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        while (true) {
+            cell = &buffer_[pos & mask_];
+            size_t seq = cell->sequence_.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1);
+            if (diff == 0) {
+                // the cell holds a request, claim it
+                if (dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+            } else if (diff < 0) {
+                return false;   // empty
+            } else {
+                pos = dequeue_pos_.load(std::memory_order_relaxed);
+            }
         }
-        std::string json_transaction = transaction_queue_.front();
-        transaction_queue_.pop();
-        return json_transaction;
+        request = std::move(cell->request_);
+        cell->sequence_.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Number of transactions ever enqueued (for statistics)
+    */
+    size_t enqueuedCount() const { return enqueue_pos_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief Approximate number of queued transactions (for placement and stealing)
+    */
+    size_t depth() const {
+        size_t enq = enqueue_pos_.load(std::memory_order_relaxed);
+        size_t deq = dequeue_pos_.load(std::memory_order_relaxed);
+        return (enq > deq) ? enq - deq : 0;
     }
 
+    ParkingSpot &parkingSpot() { return spot_; }
+
 private:
-    std::queue<std::string> transaction_queue_; // transaction queue
+    struct Cell {
+        std::atomic<size_t> sequence_;
+        TransactionRequest request_;
+    };
+
+    std::unique_ptr<Cell[]> buffer_;
+    const size_t mask_;
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> enqueue_pos_{0};   // producers (session monitors)
+    alignas(CACHE_LINE_SIZE) std::atomic<size_t> dequeue_pos_{0};   // consumers (owner and thieves)
+    ParkingSpot spot_;  // the owner worker sleeps here while every queue is empty
 };
 
 /**
  * @class TransactionBalancer
  * @brief Balancer for transactions
- * 
- * @note  This class utilizes the Xoroshiro128Plus random number
- *        generator to randomly select a queue for adding transactions. 
- *        Each worker thread can retrieve a transaction from a specific queue 
- *        based on its ID.
+ *
+ * @note  The worker of a transaction is chosen by the routing mode (TransactionRoutingMode):
+ *        - ROUTING_BALANCED: "power of two choices", two worker queues are picked at
+ *          random and the shallower one receives it. A worker whose own queue is empty
+ *          steals from the deepest queue, so that a burst on one queue does not wait
+ *          behind a busy worker while others idle.
+ *        - ROUTING_KEY_AFFINITY: the worker is derived from the first key of the
+ *          transaction (or the "partition_hint" of a JSON request).
+ *        - ROUTING_SESSION_AFFINITY: the worker is derived from the session.
+ *        Affinity modes neither fall back to other queues nor steal, which would
+ *        break the affinity.
 */
 class TransactionBalancer {
 public:
+    TransactionBalancer() = default;
+
     /**
-     * @brief Constructor for TransactionBalancer.
+     * @brief Allocate the worker queues.
      * @param num_workers(size_t) Number of worker queues to manage.
+     * @param routing_mode(TransactionRoutingMode) How transactions are assigned to workers.
      */
-    TransactionBalancer() = default;
+    void init(size_t num_workers, TransactionRoutingMode routing_mode = ROUTING_BALANCED) {
+        assert(num_workers > 0);
+        num_queues_ = num_workers;
+        routing_mode_ = routing_mode;
+        transaction_queues_.reset(new TransactionQueue[num_workers]);
+        stolen_count_.store(0, std::memory_order_relaxed);
+        rejected_count_.store(0, std::memory_order_relaxed);
+        unrouted_count_.store(0, std::memory_order_relaxed);
 
-    void init(size_t num_workers) {
-        transaction_queues_.resize(num_workers);
-        queue_mutexes_.clear();
-        for (size_t i = 0; i < num_workers; i++) {
-            queue_mutexes_.emplace_back(new std::mutex);
-        }
+        // seed the lock-free generator from the SGX random source
+        Xoroshiro128Plus seed;
+        rnd_state_.store(seed.next(), std::memory_order_relaxed);
     }
 
+    TransactionRoutingMode routingMode() const { return routing_mode_; }
+
     /**
-     * @brief Enqueue a transaction to a randomly selected queue.
-     * @param json_transaction(std::string) Transaction in JSON format
+     * @brief Enqueue a transaction to the queue chosen by the routing mode.
+     * @param session_handle(SessionHandle) Session the transaction was received from
+     * @param payload(std::string) Transaction in JSON format or binary encoding, moved only on success
+     * @return false if the queue (every queue in ROUTING_BALANCED) is full
+     * @note May be called concurrently by several session monitors.
      */
-    void putTransaction(const std::string &json_transaction) {
-        // select worker queue randomly
-        assert(transaction_queues_.size() != 0);
-        uint64_t worker_id = rnd_.next() % transaction_queues_.size();
-        std::lock_guard<std::mutex> lock(*queue_mutexes_[worker_id].get());
-        transaction_queues_[worker_id].putTransaction(json_transaction);
+    bool putTransaction(SessionHandle session_handle, std::string &payload) {
+        assert(num_queues_ != 0);
+        uint64_t routing_hash = 0;
+        bool affinity = false;
+        if (routing_mode_ == ROUTING_SESSION_AFFINITY) {
+            routing_hash = static_cast<uint32_t>(session_handle);  // slot index, stable for the session
+            affinity = true;
+        } else if (routing_mode_ == ROUTING_KEY_AFFINITY) {
+            affinity = peekRoutingHash(payload, routing_hash);
+            if (!affinity) unrouted_count_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        size_t worker_id;
+        if (affinity) {
+            worker_id = routing_hash % num_queues_;
+        } else {
+            uint64_t r = nextRandom();
+            size_t first = r % num_queues_;
+            size_t second = (r >> 32) % num_queues_;
+            worker_id = (transaction_queues_[second].depth() < transaction_queues_[first].depth()) ? second : first;
+        }
+
+        TransactionRequest request(session_handle, std::move(payload));
+        if (transaction_queues_[worker_id].putTransaction(std::move(request))) return true;
+
+        // both choices may be stale, fall back to any queue with space
+        if (!affinity) {
+            for (size_t i = 1; i < num_queues_; i++) {
+                if (transaction_queues_[(worker_id + i) % num_queues_].putTransaction(std::move(request))) return true;
+            }
+        }
+        payload = std::move(request.payload_);  // give the buffer back to the caller
+        rejected_count_.fetch_add(1, std::memory_order_relaxed);
+        return false;
     }
 
     /**
-     * @brief Dequeue a transaction from the queue of a specific worker.
+     * @brief Dequeue a transaction for a specific worker, stealing one if its queue is empty.
      * @param worker_id(size_t) The ID of the worker whose queue will be accessed.
-     * @return A transaction if available, or an empty string if the queue is empty.
+     * @param request(TransactionRequest) Dequeued transaction
+     * @return true if a transaction is available, false if every queue is empty.
      */
-    std::string getTransaction(size_t worker_id) {
-        assert(worker_id < transaction_queues_.size()); // validate worker_id
-        std::lock_guard<std::mutex> lock(*queue_mutexes_[worker_id].get());
-        return transaction_queues_[worker_id].getTransaction();
+    bool getTransaction(size_t worker_id, TransactionRequest &request) {
+        assert(worker_id < num_queues_); // validate worker_id
+        if (transaction_queues_[worker_id].getTransaction(request)) return true;
+        if (routing_mode_ != ROUTING_BALANCED) return false;
+
+        // steal from the deepest queue
+        size_t victim = worker_id;
+        size_t victim_depth = 0;
+        for (size_t i = 0; i < num_queues_; i++) {
+            size_t d = transaction_queues_[i].depth();
+            if (i != worker_id && d > victim_depth) {
+                victim = i;
+                victim_depth = d;
+            }
+        }
+        if (victim == worker_id) return false;
+        if (!transaction_queues_[victim].getTransaction(request)) return false;
+        stolen_count_.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    /**
+     * @brief Called by a worker after getTransaction() found nothing, backs off or parks.
+     * @param worker_id(size_t) The ID of the worker
+     * @param idle_strategy(IdleStrategy) Idle state of the worker, reset it once a transaction is found
+     * @note The park is bounded by WORKER_PARK_TIMEOUT_US since idle workers still have
+     *       to advance their local epoch, and thieves are not woken by other queues.
+     */
+    void waitForTransaction(size_t worker_id, IdleStrategy &idle_strategy) {
+        assert(worker_id < num_queues_);
+        TransactionQueue &queue = transaction_queues_[worker_id];
+        idle_strategy.idle(queue.parkingSpot(), [&queue]{ return queue.depth() != 0; }, WORKER_PARK_TIMEOUT_US);
+    }
+
+    /**
+     * @brief Print the routing statistics (routing mode, transactions per worker queue, steals, rejections)
+    */
+    void printStats() {
+        std::string per_worker;
+        for (size_t i = 0; i < num_queues_; i++) {
+            if (i != 0) per_worker += " ";
+            per_worker += std::to_string(transaction_queues_[i].enqueuedCount());
+        }
+        t_print(LOG_INFO "Balancer: routing=%s, queued per worker=[%s], stolen=%lu, rejected=%lu, unrouted=%lu\n",
+                routing_mode_name(routing_mode_), per_worker.c_str(),
+                stolen_count_.load(std::memory_order_relaxed),
+                rejected_count_.load(std::memory_order_relaxed),
+                unrouted_count_.load(std::memory_order_relaxed));
+    }
+
+    /**
+     * @brief Routing hash of a transaction for ROUTING_KEY_AFFINITY
+     * @param payload JSON or binary encoded transaction (not modified)
+     * @param routing_hash the "partition_hint" of a JSON request if it appears before the
+     *                     first key, otherwise the hash of the first key (left key for SCAN)
+     * @return false if neither was found
+     * @note Only scans up to the first key, the full parse is left to the worker.
+     *       Escaped keys are hashed in their escaped form, which is stable for a client.
+    */
+    static bool peekRoutingHash(const std::string &payload, uint64_t &routing_hash) {
+        if (is_binary_request(payload)) {
+            BinaryReader reader(payload.data(), payload.size());
+            uint8_t u8;
+            uint64_t u64;
+            uint32_t len, num_operations;
+            const char *data;
+            if (!reader.get_u8(u8) || !reader.get_u8(u8) ||
+                !reader.get_u64(u64) || !reader.get_u64(u64) || !reader.get_u64(u64) ||
+                !reader.get_bytes(data, len) || !reader.get_u32(num_operations) || num_operations == 0 ||
+                !reader.get_u8(u8) || !reader.get_bytes(data, len)) {
+                return false;
+            }
+            routing_hash = std::hash<std::string_view>{}(std::string_view(data, len));
+            return true;
+        }
+
+        // JSON: walk the string tokens, a string followed by ':' is a member name
+        const char *p = payload.data();
+        const char *end = p + payload.size();
+        while (p < end) {
+            if (*p++ != '"') continue;
+            const char *begin = p;
+            while (p < end && *p != '"') {
+                if (*p == '\\') p++;
+                p++;
+            }
+            if (p >= end) return false;
+            std::string_view name(begin, static_cast<size_t>(p - begin));
+            p++;
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+            if (p >= end || *p != ':') continue;
+            p++;
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+
+            if (name == "partition_hint") {
+                if (p >= end || *p < '0' || '9' < *p) return false;
+                uint64_t hint = 0;
+                while (p < end && '0' <= *p && *p <= '9') hint = hint * 10 + static_cast<uint64_t>(*p++ - '0');
+                routing_hash = hint;
+                return true;
+            }
+            if ((name == "key" || name == "left_key") && p < end && *p == '"') {
+                begin = ++p;
+                while (p < end && *p != '"') {
+                    if (*p == '\\') p++;
+                    p++;
+                }
+                if (p >= end) return false;
+                routing_hash = std::hash<std::string_view>{}(std::string_view(begin, static_cast<size_t>(p - begin)));
+                return true;
+            }
+        }
+        return false;
     }
 
 private:
-    std::vector<TransactionQueue> transaction_queues_;  // transaction queues for workers
-    std::vector<std::unique_ptr<std::mutex>> queue_mutexes_;  // mutexes for transaction queues
-    Xoroshiro128Plus rnd_;  // random number generator
-};
\ No newline at end of file
+    std::unique_ptr<TransactionQueue[]> transaction_queues_;  // transaction queues for workers
+    size_t num_queues_ = 0;
+    TransactionRoutingMode routing_mode_ = ROUTING_BALANCED;
+    std::atomic<uint64_t> rnd_state_{0};    // shared by the session monitors, advanced without locking
+
+    // statistics
+    std::atomic<uint64_t> stolen_count_{0};     // transactions executed by a worker other than the one they were queued to
+    std::atomic<uint64_t> rejected_count_{0};   // transactions rejected because the queue was full
+    std::atomic<uint64_t> unrouted_count_{0};   // ROUTING_KEY_AFFINITY: no key found, placed as ROUTING_BALANCED
+
+    // SplitMix64 over an atomic counter, good enough to pick queues
+    uint64_t nextRandom() {
+        uint64_t z = rnd_state_.fetch_add(0x9e3779b97f4a7c15, std::memory_order_relaxed) + 0x9e3779b97f4a7c15;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+        return z ^ (z >> 31);
+    }
+};
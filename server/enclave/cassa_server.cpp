@@ -24,9 +24,11 @@
 *
 */
 #include <string>
+#include <string_view>
 #include <vector>
 #include <sstream>
 #include <mutex>
+#include <algorithm>
 
 // SGX Libraries for sgx_rand_read()
 #include "sgx_trts.h"
@@ -35,6 +37,7 @@
 #include "cassa_server.h"
 #include "global_variables.h"
 #include "cassa_common/structures.h"
+#include "cassa_common/consts.h"
 
 // CASSA/Silo_CC
 #include "silo_cc/include/silo_transaction.h"
@@ -56,6 +59,7 @@
 #include "../../common/openssl_utility_enclave.h"
 #include "openssl_server/include/tls_server.h"
 #include "cassa_common/json_message_formats.hpp"
+#include "cassa_common/json_request_parser.hpp"
 
 // Third Party Libraries
 #include "../../common/third_party/json.hpp"
@@ -81,6 +85,8 @@ size_t num_logger_threads;
 
 SSLSessionHandler ssl_session_handler;
 TransactionBalancer tx_balancer;
+OverloadPolicy overload_policy = OVERLOAD_REJECT;  // admission control of the session monitors
+ContentionMode contention_mode = CONTENTION_WAIT_BACKOFF;  // lock wait and abort backoff of the workers
 
 int ecall_perform_recovery() {
     RecoveryManager recovery_manager;
@@ -89,7 +95,43 @@ int ecall_perform_recovery() {
     return recovery_status;
 }
 
-void ecall_initialize_global_variables(size_t worker_num, size_t logger_num) {
+/**
+ * @brief Print the usage of the slab size classes that hold the Masstree nodes.
+ * @note The node pools are the size classes of the shared SlabAllocator (one per node size),
+ *       so records and value bodies of the same size class are counted as well.
+*/
+void print_node_pool_stats() {
+    SlabAllocator::Stats border_pool = Masstree::border_node_pool_stats();
+    SlabAllocator::Stats interior_pool = Masstree::interior_node_pool_stats();
+    t_print(LOG_INFO "Masstree node pools: border %lu/%lu in use (%lu bytes each), interior %lu/%lu in use (%lu bytes each)\n",
+            border_pool.occupied(), border_pool.carved, border_pool.block_size,
+            interior_pool.occupied(), interior_pool.carved, interior_pool.block_size);
+}
+
+/**
+ * @brief Print the transaction counters of all workers (WorkerResult) and the contention mode.
+ * @note The counters are only written by their worker, this reads a consistent value of each
+ *       counter but not a snapshot across counters.
+*/
+void print_worker_stats() {
+    WorkerResult total;
+    for (WorkerResult &result : workerResults) {
+        total.local_commit_count_ += loadRelaxed(result.local_commit_count_);
+        total.local_abort_count_ += loadRelaxed(result.local_abort_count_);
+        total.local_abort_vp1_count_ += loadRelaxed(result.local_abort_vp1_count_);
+        total.local_abort_vp2_count_ += loadRelaxed(result.local_abort_vp2_count_);
+        total.local_abort_vp3_count_ += loadRelaxed(result.local_abort_vp3_count_);
+        total.local_lock_wait_count_ += loadRelaxed(result.local_lock_wait_count_);
+        total.local_purged_record_count_ += loadRelaxed(result.local_purged_record_count_);
+        total.local_purged_byte_count_ += loadRelaxed(result.local_purged_byte_count_);
+    }
+    t_print(LOG_INFO "Workers: contention=%s, committed=%lu, aborted=%lu (locked write set %lu, changed read set %lu, locked read set %lu), lock waits=%lu, purged=%lu records (%lu bytes)\n",
+            contention_mode_name(contention_mode), total.local_commit_count_, total.local_abort_count_,
+            total.local_abort_vp1_count_, total.local_abort_vp2_count_, total.local_abort_vp3_count_,
+            total.local_lock_wait_count_, total.local_purged_record_count_, total.local_purged_byte_count_);
+}
+
+void ecall_initialize_global_variables(size_t worker_num, size_t logger_num, size_t monitor_num, int routing_mode, int overload_mode, int contention) {
     // Global epochを初期化する
     // TODO: pepochから読み込むようにする
 
@@ -102,7 +144,42 @@ void ecall_initialize_global_variables(size_t worker_num, size_t logger_num) {
     num_worker_threads = worker_num;
     num_logger_threads = logger_num;
 
-    tx_balancer.init(worker_num);
+    if (routing_mode < ROUTING_BALANCED || ROUTING_SESSION_AFFINITY < routing_mode) {
+        t_print(LOG_WARN "Unknown routing mode %d, falling back to balanced\n", routing_mode);
+        routing_mode = ROUTING_BALANCED;
+    }
+    tx_balancer.init(worker_num, static_cast<TransactionRoutingMode>(routing_mode));
+    t_print(LOG_INFO "Transaction routing: " BGRN "%s" CRESET "\n", routing_mode_name(routing_mode));
+
+    if (overload_mode < OVERLOAD_REJECT || OVERLOAD_BACKPRESSURE < overload_mode) {
+        t_print(LOG_WARN "Unknown overload policy %d, falling back to reject\n", overload_mode);
+        overload_mode = OVERLOAD_REJECT;
+    }
+    overload_policy = static_cast<OverloadPolicy>(overload_mode);
+    t_print(LOG_INFO "Overload policy: " BGRN "%s" CRESET " (max in-flight transactions per session: %d)\n",
+            overload_policy_name(overload_policy), SESSION_MAX_IN_FLIGHT);
+
+    if (contention < CONTENTION_WAIT_BACKOFF || CONTENTION_NO_WAIT < contention) {
+        t_print(LOG_WARN "Unknown contention mode %d, falling back to wait-backoff\n", contention);
+        contention = CONTENTION_WAIT_BACKOFF;
+    }
+    contention_mode = static_cast<ContentionMode>(contention);
+    ContentionPolicy policy = ContentionPolicy::fromMode(contention_mode);
+    t_print(LOG_INFO "Contention: " BGRN "%s" CRESET " (lock wait spins: %u, abort backoff: %u-%u us)\n",
+            contention_mode_name(contention_mode), policy.lock_wait_spins, policy.backoff_base_us, policy.backoff_max_us);
+
+    // carve the Masstree node pools before the workers start splitting nodes
+    Masstree::reserve_nodes(MASSTREE_BORDER_NODE_RESERVE, MASSTREE_INTERIOR_NODE_RESERVE);
+    print_node_pool_stats();
+
+    // session table and ingress shards, one readiness wait instance per session monitor
+    ssl_session_handler.init(MAX_SESSION_NUM, monitor_num);
+    for (size_t i = 0; i < monitor_num; i++) {
+        ssl_session_handler.shards_[i].epoll_fd_ = epoll_create_instance();
+        if (ssl_session_handler.shards_[i].epoll_fd_ < 0) {
+            t_print(LOG_ERROR "Failed to create readiness wait instance for the session monitor %lu\n", i);
+        }
+    }
 }
 
 int fcntl_set_nonblocking(int fd) {
@@ -115,6 +192,54 @@ int fcntl_set_nonblocking(int fd) {
     return retval;
 }
 
+int epoll_create_instance() {
+    int retval;
+    sgx_status_t status = u_epoll_create(&retval);
+    if (status != SGX_SUCCESS) {
+        t_print(LOG_ERROR "SGX error while creating epoll instance: %d\n", status);
+        return -1;
+    }
+    return retval;
+}
+
+int epoll_add_fd(int epfd, int fd) {
+    int retval;
+    sgx_status_t status = u_epoll_ctl_add(&retval, epfd, fd);
+    if (status != SGX_SUCCESS) {
+        t_print(LOG_ERROR "SGX error while registering fd to epoll: %d\n", status);
+        return -1;
+    }
+    return retval;
+}
+
+int epoll_del_fd(int epfd, int fd) {
+    int retval;
+    sgx_status_t status = u_epoll_ctl_del(&retval, epfd, fd);
+    if (status != SGX_SUCCESS) {
+        t_print(LOG_ERROR "SGX error while unregistering fd from epoll: %d\n", status);
+        return -1;
+    }
+    return retval;
+}
+
+/**
+ * @brief Wait until some of the fds registered to epfd become readable.
+ * @param epfd epoll instance
+ * @param ready_fds buffer to store the readable fds
+ * @param max_events capacity of ready_fds
+ * @param timeout_ms timeout in milliseconds (0: return immediately)
+ * @return The number of readable fds, 0 on timeout, -1 on error.
+*/
+int epoll_wait_ready_fds(int epfd, int *ready_fds, int max_events, int timeout_ms) {
+    int retval;
+    sgx_status_t status = u_epoll_wait_ready(&retval, epfd, ready_fds, max_events, timeout_ms);
+    if (status != SGX_SUCCESS) {
+        t_print(LOG_ERROR "SGX error while waiting for readable fds: %d\n", status);
+        return -1;
+    }
+    return retval;
+}
+
 
 void ecall_ssl_connection_acceptor(char* server_port, int keep_server_up) {
     SSL_CTX *ssl_server_ctx = nullptr;
@@ -126,112 +251,332 @@ void ecall_ssl_connection_acceptor(char* server_port, int keep_server_up) {
         return;
     }
 
+    // the acceptor sleeps on the listener socket until a connection is pending
+    int listener_epoll_fd = epoll_create_instance();
+    if (listener_epoll_fd < 0 || epoll_add_fd(listener_epoll_fd, server_socket_fd) != 0) {
+        t_print(LOG_ERROR "Failed to set up readiness wait for the listener socket\n");
+        return;
+    }
+
     // wait for client connection
+    size_t next_shard_id = 0;
     while (true) {
         // TODO: 終了条件を設定する？
-        SSL *ssl_session = accept_client_connection(server_socket_fd, ssl_server_ctx);
+        SSL *ssl_session = accept_client_connection(server_socket_fd, listener_epoll_fd, ssl_server_ctx);
         if (ssl_session == nullptr) {
             t_print(LOG_ERROR "accept_client_connection() failed\n");
-        } else {
-            std::string session_id = ssl_session_handler.addSession(ssl_session);
-            t_print(LOG_INFO "Accepted client connection (session_id: %s)\n", session_id.c_str());
+            continue;
+        }
+
+        // distribute sessions over the ingress shards in round-robin
+        size_t shard_id = next_shard_id;
+        next_shard_id = (next_shard_id + 1) % ssl_session_handler.num_shards_;
 
-            // print active session
-            t_print(LOG_INFO "Active session: " BGRN "%lu" CRESET "\n", ssl_session_handler.ssl_sessions_.size());
+        int client_socket_fd = SSL_get_fd(ssl_session);
+        SessionHandle session_handle = ssl_session_handler.addSession(ssl_session, shard_id);
+        if (session_handle == INVALID_SESSION_HANDLE) {
+            t_print(LOG_ERROR "Session table is full, connection refused\n");
+            SSL_free(ssl_session);
+            ocall_close(nullptr, client_socket_fd);
+            continue;
+        }
+        t_print(LOG_INFO "Accepted client connection (session_id: %s, monitor: %lu)\n", ssl_session_handler.getSessionIDString(session_handle), shard_id);
+
+        // register the session to its session monitor (after addSession so that the fd can be resolved)
+        if (epoll_add_fd(ssl_session_handler.shards_[shard_id].epoll_fd_, client_socket_fd) != 0) {
+            // the session would never be polled nor closed, drop it (removeSession frees the TLS session)
+            t_print(LOG_ERROR "Failed to register session %s to the session monitor, connection closed\n", ssl_session_handler.getSessionIDString(session_handle));
+            ssl_session_handler.removeSession(session_handle, SSL_ERROR_NONE);
+            ocall_close(nullptr, client_socket_fd);
+            continue;
         }
+
+        // print active session (the routing statistics are printed when a session closes)
+        t_print(LOG_INFO "Active session: " BGRN "%lu" CRESET "\n", ssl_session_handler.size());
     }
 
     // clean up
     if (ssl_server_ctx) SSL_CTX_free(ssl_server_ctx);
+    ocall_close(nullptr, listener_epoll_fd);
     ocall_close(nullptr, server_socket_fd);
 }
 
-void ecall_ssl_session_monitor() {
-    while (true) {
-        // TODO: 終了条件を設定する？
+/**
+ * @brief Close a session and stop monitoring its socket.
+ * @param session_handle Session handle
+ * @param ssl_error_code SSL error code passed to SSLSessionHandler::removeSession()
+ * @note Only the session monitor owning the session calls this, so socket_fd/shard_id/paused are stable.
+*/
+void close_ssl_session(SessionHandle session_handle, int ssl_error_code) {
+    SSLSession *session = ssl_session_handler.getSession(session_handle);
+    if (session == nullptr) return;
+    int socket_fd = session->socket_fd;
+    size_t shard_id = session->shard_id;
+    bool paused = session->paused;
+
+    if (ssl_session_handler.removeSession(session_handle, ssl_error_code)) {
+        // unregister before close so that the fd number can be safely reused by accept()
+        // NOTE: a paused session has already been unregistered
+        if (!paused) epoll_del_fd(ssl_session_handler.shards_[shard_id].epoll_fd_, socket_fd);
+        ocall_close(nullptr, socket_fd);
+
+        // print active session, routing and worker statistics and node pool usage
+        t_print(LOG_INFO "Active session: " BGRN "%lu" CRESET "\n", ssl_session_handler.size());
+        tx_balancer.printStats();
+        print_worker_stats();
+        print_node_pool_stats();
+    }
+}
+
+/**
+ * @brief Best-effort extraction of the session_tx_id of a request that will not be parsed.
+ * @param request Received request (JSON or binary)
+ * @return The session_tx_id of the request, 0 if it is not pipelined or cannot be found.
+ * @note Only used to let pipelining clients match the rejection of a request.
+*/
+uint64_t peek_session_tx_id(const std::string &request) {
+    uint64_t session_tx_id = 0;
+    if (is_binary_request(request)) {
+        // magic, version, timestamp_sec and timestamp_nsec precede the session_tx_id
+        BinaryReader r(request.data(), request.size());
+        uint8_t magic, version;
+        uint64_t sec, nsec;
+        if (!r.get_u8(magic) || !r.get_u8(version) || version != BINARY_PROTOCOL_VERSION ||
+            !r.get_u64(sec) || !r.get_u64(nsec) || !r.get_u64(session_tx_id)) {
+            return 0;
+        }
+        return session_tx_id;
+    }
 
-        auto it = ssl_session_handler.ssl_sessions_.begin();
-        while (it != ssl_session_handler.ssl_sessions_.end()) {
-            std::string session_id = it->first;
-            SSL* ssl_session = it->second.ssl_session;
+    // NOTE: quotes inside JSON strings are escaped, so the quoted key only matches a member name
+    static const char key[] = "\"session_tx_id\"";
+    size_t pos = request.find(key);
+    if (pos == std::string::npos) return 0;
+    pos += sizeof(key) - 1;
+    while (pos < request.size() && (request[pos] == ' ' || request[pos] == ':')) pos++;
+    while (pos < request.size() && '0' <= request[pos] && request[pos] <= '9') {
+        session_tx_id = session_tx_id * 10 + (request[pos] - '0');
+        pos++;
+    }
+    return session_tx_id;
+}
 
-            // lock mutex
-            std::lock_guard<std::mutex> lock(*it->second.ssl_session_mutex);
+/**
+ * @brief Refuse a request that cannot be admitted, the client may resend it as is.
+ * @param session Session the request was received from
+ * @param request Received request
+ * @param reason Reason printed in the server log
+ * @note The caller must hold session->ssl_session_mutex.
+*/
+void reject_transaction(SSLSession *session, const std::string &request, const char *reason) {
+    t_print(LOG_SESSION_START_RED "%s" LOG_SESSION_END "%s, transaction rejected\n", session->session_id, reason);
+    tls_write_to_session_peer(session->ssl_session,
+                              serialize_message(session->wire_format, RESPONSE_ERROR_SERVER_BUSY,
+                                                "Error: Server is busy, retry later.", {}, peek_session_tx_id(request)));
+}
 
-            // check if the session is alive
-            if (!ssl_session || SSL_get_shutdown(ssl_session)) {
-                t_print(LOG_INFO "Session ID: %s has closed\n", session_id.c_str());
-                // remove the session from the map and reset iterator
-                // NOTE: SSL_ERROR_NONE is normal termination
-                ssl_session_handler.removeSession(session_id, SSL_ERROR_NONE);
-                it = ssl_session_handler.ssl_sessions_.begin();
-                
-                // print active session
-                t_print(LOG_INFO "Active session: " BGRN "%lu" CRESET "\n", ssl_session_handler.ssl_sessions_.size());
-                continue;
+/**
+ * @brief Stop reading a session until resume_paused_sessions() admits it again (backpressure policy).
+ * @param session_handle Session handle
+ * @param session Slot of the session
+ * @param paused_sessions Paused sessions of the calling monitor, the session is appended here.
+ * @note The caller must hold session->ssl_session_mutex. The unread requests stay in the
+ *       socket, so the client is throttled by TCP flow control.
+*/
+void pause_session(SessionHandle session_handle, SSLSession *session, std::vector<SessionHandle> &paused_sessions) {
+    if (session->paused) return;
+    if (epoll_del_fd(ssl_session_handler.shards_[session->shard_id].epoll_fd_, session->socket_fd) != 0) {
+        t_print(LOG_ERROR "Failed to pause session %s\n", session->session_id);
+        return;
+    }
+    session->paused = true;
+    paused_sessions.push_back(session_handle);
+}
+
+/**
+ * @brief Resume the paused sessions that can be admitted again.
+ * @param paused_sessions Paused sessions of the calling monitor, resumed (or closed) ones are removed.
+ * @param pending_sessions Resumed sessions are appended here, their data may have been
+ *                         buffered inside OpenSSL or arrived before they were registered again.
+*/
+void resume_paused_sessions(std::vector<SessionHandle> &paused_sessions, std::vector<SessionHandle> &pending_sessions) {
+    auto itr = paused_sessions.begin();
+    while (itr != paused_sessions.end()) {
+        SessionHandle session_handle = *itr;
+        SSLSession *session = ssl_session_handler.getSession(session_handle);
+        bool still_paused = false;
+        {
+            std::lock_guard<std::mutex> lock(session->ssl_session_mutex);
+            if (SSLSessionHandler::isCurrent(session, session_handle)) {
+                // the request read before pausing goes first
+                if (!session->deferred_request.empty() && tx_balancer.putTransaction(session_handle, session->deferred_request)) {
+                    session->deferred_request.clear();
+                    session->in_flight++;
+                }
+                if (!session->deferred_request.empty() || session->in_flight >= SESSION_MAX_IN_FLIGHT ||
+                    epoll_add_fd(ssl_session_handler.shards_[session->shard_id].epoll_fd_, session->socket_fd) != 0) {
+                    still_paused = true;
+                } else {
+                    session->paused = false;
+                    pending_sessions.push_back(session_handle);
+                }
             }
+        }
+        itr = still_paused ? itr + 1 : paused_sessions.erase(itr);
+    }
+}
 
-            // check if the session has received data
+/**
+ * @brief Receive and dispatch the data of a session reported as readable.
+ * @param session_handle Session handle
+ * @param pending_sessions Sessions that still have data buffered inside OpenSSL after
+ *                         this call are appended here, since epoll cannot report them.
+ * @param paused_sessions Sessions paused by the backpressure policy are appended here.
+*/
+void handle_readable_session(SessionHandle session_handle, std::vector<SessionHandle> &pending_sessions,
+                             std::vector<SessionHandle> &paused_sessions) {
+    SSLSession *session = ssl_session_handler.getSession(session_handle);
+    if (session == nullptr) return;
+    const char *session_id = session->session_id;
+    int close_error_code = -1;  // >= 0 if the session should be closed
+
+    {
+        // lock mutex
+        std::lock_guard<std::mutex> lock(session->ssl_session_mutex);
+        if (!SSLSessionHandler::isCurrent(session, session_handle)) return;
+        SSL* ssl_session = session->ssl_session;
+
+        // check if the session is alive
+        if (!ssl_session || SSL_get_shutdown(ssl_session)) {
+            t_print(LOG_INFO "Session ID: %s has closed\n", session_id);
+            // NOTE: SSL_ERROR_NONE is normal termination
+            close_error_code = SSL_ERROR_NONE;
+        } else if (session->paused) {
+            // paused while this handle was queued, resume_paused_sessions() will revisit it
+        } else if (overload_policy == OVERLOAD_BACKPRESSURE && session->in_flight >= SESSION_MAX_IN_FLIGHT) {
+            // leave the next request in the socket until some responses have been sent
+            pause_session(session_handle, session, paused_sessions);
+        } else {
+            // check if the session has received application data
+            // NOTE: the fd may be readable only because of a partial TLS record (SSL_ERROR_WANT_READ)
             char buffer[1];
             int result = SSL_peek(ssl_session, buffer, sizeof(buffer));
             if (result > 0) {
                 // receive data from the session
                 std::string received_data;
                 tls_read_from_session_peer(ssl_session, received_data);
-                t_print(LOG_SESSION_START_BMAG "%s" LOG_SESSION_END "Received data from client (%lu bytes)\n", session_id.c_str(), received_data.size());
+                t_print(LOG_SESSION_START_BMAG "%s" LOG_SESSION_END "Received data from client (%lu bytes)\n", session_id, received_data.size());
 
                 // handle if reveiced data is command
-                std::string command, token_sec, token_nsec;
+                // NOTE: binary requests never start with '/', so they skip the tokenization
+                std::string command, token_sec, token_nsec, token_format;
                 std::istringstream iss(received_data);
-                std::getline(iss, command, ' ');    // get first token
+                if (!received_data.empty() && received_data[0] == '/') {
+                    std::getline(iss, command, ' ');    // get first token
+                }
                 if (command == "/get_session_id") {
                     // get timestamp from the session
-                    if (!std::getline(iss, token_sec, ' ') || !std::getline(iss, token_nsec)) {
+                    if (!std::getline(iss, token_sec, ' ') || !std::getline(iss, token_nsec, ' ')) {
                         t_print(TLS_SERVER "Invalid command format\n");
-                        return;
+                    } else {
+                        // set timestamp to SSLSession object (mutex is already held)
+                        session->latest_timestamp_sec = std::stol(token_sec);
+                        session->latest_timestamp_nsec = std::stol(token_nsec);
+                        session->established_timestamp_sec = session->latest_timestamp_sec;
+                        session->established_timestamp_nsec = session->latest_timestamp_nsec;
+
+                        // optional 3rd token negotiates the encoding of the responses
+                        std::getline(iss, token_format);
+                        session->wire_format = (token_format == BINARY_PROTOCOL_NEGOTIATION_TOKEN) ? WireFormat::BINARY : WireFormat::JSON;
+
+                        // notify session ID to client
+                        t_print(LOG_SESSION_START_BMAG "%s" LOG_SESSION_END "Session ID: " BGRN "%s" CRESET " (%s)\n", session_id, session_id,
+                                (session->wire_format == WireFormat::BINARY) ? "binary" : "json");
+                        tls_write_to_session_peer(ssl_session, std::string(session_id));
                     }
-
-                    // convert string to long int
-                    long int timestamp_sec = std::stol(token_sec);
-                    long int timestamp_nsec = std::stol(token_nsec);
-
-                    // set timestamp to SSLSession object
-                    ssl_session_handler.setTimestamp(session_id, timestamp_sec, timestamp_nsec);
-
-                    // notify session ID to client
-                    t_print(LOG_SESSION_START_BMAG "%s" LOG_SESSION_END "Session ID: " BGRN "%s" CRESET "\n", session_id.c_str(), session_id.c_str());
-                    tls_write_to_session_peer(ssl_session, session_id);
-                    it++;
-                    continue;
+                } else if (session->in_flight >= SESSION_MAX_IN_FLIGHT) {
+                    // only reachable with the reject policy, backpressure pauses the session before reading
+                    reject_transaction(session, received_data, "Too many in-flight transactions");
+                } else if (tx_balancer.putTransaction(session_handle, received_data)) {
+                    // released when the response (or the commit notification) is written to the session
+                    session->in_flight++;
+                } else if (overload_policy == OVERLOAD_BACKPRESSURE) {
+                    // keep the request (handed back by the balancer) and stop reading until a queue has room
+                    // NOTE: never wait for queue space here, workers need this session's mutex to respond
+                    session->deferred_request.swap(received_data);
+                    pause_session(session_handle, session, paused_sessions);
+                } else {
+                    reject_transaction(session, received_data, "Transaction queues are full");
                 }
 
-                // put transaction to the transaction balancer
-                tx_balancer.putTransaction(received_data);
-
+                // records already pulled into OpenSSL are invisible to epoll, revisit them without waiting
+                if (!session->paused && SSL_has_pending(ssl_session)) {
+                    pending_sessions.push_back(session_handle);
+                }
             } else if (result == 0) {
-                // remove the session from the map and reset iterator
                 // NOTE: SSL_ERROR_NONE is normal termination
-                ssl_session_handler.removeSession(session_id, SSL_ERROR_NONE);
-                it = ssl_session_handler.ssl_sessions_.begin();
-
-                // print active session
-                t_print(LOG_INFO "Active session: " BGRN "%lu" CRESET "\n", ssl_session_handler.ssl_sessions_.size());
-                continue;
-            } else { // result <= 0
-                // remove the session from the map and reset iterator
+                close_error_code = SSL_ERROR_NONE;
+            } else {
                 int ssl_error_code = SSL_get_error(ssl_session, result);
-                ssl_session_handler.removeSession(session_id, ssl_error_code);
-
-                // print active session (except for SSL_ERROR_WANT_READ)
-                if (ssl_error_code != SSL_ERROR_WANT_READ) {
-                    it = ssl_session_handler.ssl_sessions_.begin();
-                    t_print(LOG_INFO "Active session: " BGRN "%lu" CRESET "\n", ssl_session_handler.ssl_sessions_.size());
-                    continue;
-                }
+                if (ssl_error_code != SSL_ERROR_WANT_READ) close_error_code = ssl_error_code;
             }
-            it++;
         }
     }
+
+    // remove the session after releasing its mutex
+    if (close_error_code >= 0) {
+        close_ssl_session(session_handle, close_error_code);
+    }
+}
+
+/**
+ * @brief Session monitor of an ingress shard.
+ * @param monitor_thid ID of the shard served by this thread
+ * @note Each monitor only waits on the sessions assigned to its shard,
+ *       so ingress processing scales with the number of monitor threads.
+*/
+void ecall_ssl_session_monitor(size_t monitor_thid) {
+    assert(monitor_thid < ssl_session_handler.num_shards_);
+    const int epoll_fd = ssl_session_handler.shards_[monitor_thid].epoll_fd_;
+    int ready_fds[SESSION_MONITOR_MAX_EVENTS];
+    std::vector<SessionHandle> ready_sessions;
+    std::vector<SessionHandle> pending_sessions;  // sessions with data buffered inside OpenSSL
+    std::vector<SessionHandle> paused_sessions;   // sessions not read because of backpressure
+
+    t_print(LOG_DEBUG "mID: %d | Session monitor thread has started\n", monitor_thid);
+
+    while (true) {
+        // TODO: 終了条件を設定する？
+
+        // sleep in the host until some session becomes readable, but do not block if
+        // there are sessions whose data has already been read into OpenSSL
+        // and wake up often enough to resume paused sessions
+        int timeout_ms = !pending_sessions.empty() ? 0 :
+                         !paused_sessions.empty() ? SESSION_RESUME_INTERVAL_MS : SESSION_MONITOR_TIMEOUT_MS;
+        int num_ready = epoll_wait_ready_fds(epoll_fd, ready_fds, SESSION_MONITOR_MAX_EVENTS, timeout_ms);
+        if (num_ready < 0) {
+            t_print(LOG_ERROR "Failed to wait for readable sessions\n");
+            continue;
+        }
+        if (!paused_sessions.empty()) {
+            resume_paused_sessions(paused_sessions, pending_sessions);
+        }
+
+        ready_sessions.swap(pending_sessions);
+        pending_sessions.clear();
+        for (int i = 0; i < num_ready; i++) {
+            SessionHandle session_handle = ssl_session_handler.getSessionHandleByFd(monitor_thid, ready_fds[i]);
+            if (session_handle == INVALID_SESSION_HANDLE) continue;   // closed in the meantime
+            if (std::find(ready_sessions.begin(), ready_sessions.end(), session_handle) != ready_sessions.end()) continue;
+            ready_sessions.push_back(session_handle);
+        }
+
+        // service only the sessions with pending data
+        for (SessionHandle session_handle : ready_sessions) {
+            handle_readable_session(session_handle, pending_sessions, paused_sessions);
+        }
+        ready_sessions.clear();
+    }
 }
 
 /**
@@ -269,91 +614,215 @@ int compare_timestamps(long int timestamp_sec,
 }
 
 /**
- * @brief Converts a JSON string to a vector of `Procedure` objects.
+ * @brief Checks the session ID and the timestamp of a request.
  * 
- * @param session_id A string to store the client session ID.
- * @param procedures A vector of `Procedure` objects to store the result.
- * @param json_str A JSON string to be converted.
+ * @param session_handle Handle of the session the request was received from.
+ * @param client_session_id Session ID written in the request.
+ * @param timestamp_sec The seconds part of the timestamp of the request.
+ * @param timestamp_nsec The nanoseconds part of the timestamp of the request.
+ * @param session_tx_id The per-session sequence number of the request, 0 if the request is not pipelined.
  * 
- * @return Returns 0 if the conversion is successful.
- *         Returns -1 if the timestamp is older than the latest timestamp.
- *         Returns -2 if the operation is unknown.
+ * @return Returns 0 if the request is acceptable (the timestamp of the session is updated).
+ *         Returns -1 if the timestamp is older than the latest timestamp,
+ *           or if the session_tx_id has already been seen (or is out of the replay window).
+ *         Returns -3 if the client session ID does not belong to the session.
+ * 
+ * @note Pipelined requests (session_tx_id > 0) may be executed out of order,
+ *       so the replay check is done on the session_tx_id instead of the timestamp.
 */
-int json_to_procedures(std::string &session_id, std::vector<Procedure> &procedures, const std::string &json_str) {
-    // parse json
-    auto json = nlohmann::json::parse(json_str);
-    std::string client_session_id = json["client_sessionID"];
-    long int timestamp_sec = json["timestamp_sec"].get<long int>();
-    long int timestamp_nsec = json["timestamp_nsec"].get<long int>();
-    session_id = client_session_id;
+int check_request_header(SessionHandle session_handle, std::string_view client_session_id,
+                         long int timestamp_sec, long int timestamp_nsec, uint64_t session_tx_id) {
+    const char *session_id = ssl_session_handler.getSessionIDString(session_handle);
+
+    // The session is identified by the connection, the ID in the message must match it
+    if (!ssl_session_handler.matchSessionID(session_handle, client_session_id)) {
+        t_print(LOG_SESSION_START_RED "%s" LOG_SESSION_END "Session ID mismatch: %.*s\n", session_id, (int)client_session_id.size(), client_session_id.data());
+        return -3;
+    }
+
+    // Check sequence number to prevent replay attack (pipelined requests)
+    if (session_tx_id != 0) {
+        if (!ssl_session_handler.acceptSessionTxId(session_handle, session_tx_id, timestamp_sec, timestamp_nsec)) {
+            t_print(LOG_SESSION_START_RED "%s" LOG_SESSION_END "Replay attack detected or old session_tx_id received: %lu\n", session_id, session_tx_id);
+            return -1;
+        }
+        return 0;
+    }
 
     // Check timestamp to prevent replay attack
+    long int latest_timestamp_sec = 0, latest_timestamp_nsec = 0;
+    ssl_session_handler.getTimestamp(session_handle, latest_timestamp_sec, latest_timestamp_nsec);
     if (compare_timestamps(timestamp_sec, timestamp_nsec,
-                           ssl_session_handler.getTimestampSec(client_session_id),
-                           ssl_session_handler.getTimestampNsec(client_session_id)) <= 0) {
-        t_print(LOG_SESSION_START_RED "%s" LOG_SESSION_END "Replay attack detected or old timestamp received.\n", session_id.c_str());
+                           latest_timestamp_sec, latest_timestamp_nsec) <= 0) {
+        t_print(LOG_SESSION_START_RED "%s" LOG_SESSION_END "Replay attack detected or old timestamp received.\n", session_id);
         return -1;
     }
 
     // Update timestamp in SSL session
-    ssl_session_handler.setTimestamp(client_session_id, timestamp_sec, timestamp_nsec);
-    // t_print(LOG_DEBUG "client_session_id: %s, timestamp_sec: %ld, timestamp_nsec: %ld\n", client_session_id.c_str(), timestamp_sec, timestamp_nsec); // for debug
+    ssl_session_handler.setTimestamp(session_handle, timestamp_sec, timestamp_nsec);
+    // t_print(LOG_DEBUG "client_session_id: %s, timestamp_sec: %ld, timestamp_nsec: %ld\n", client_session_id.data(), timestamp_sec, timestamp_nsec); // for debug
+    return 0;
+}
 
-    // retrieve operations
-    const auto &transactions_json = json["transaction"];
-    procedures.clear();
+/**
+ * @brief Converts a JSON string to a vector of `Procedure` objects.
+ * 
+ * @param session_handle Handle of the session the JSON string was received from.
+ * @param procedures A vector of `Procedure` objects to store the result.
+ * @param json_str A JSON string to be converted. It is decoded in place and the
+ *                 procedures refer to it, so it must outlive the transaction.
+ * @param session_tx_id Set to the per-session sequence number of the request (0 if absent).
+ * 
+ * @return Returns 0 if the conversion is successful.
+ *         Returns -1 if the timestamp is older than the latest timestamp.
+ *         Returns -2 if the operation is unknown.
+ *         Returns -3 if the client session ID does not belong to the session.
+ *         Returns -5 if the JSON string is malformed.
+*/
+int json_to_procedures(SessionHandle session_handle, std::vector<Procedure> &procedures, std::string &json_str, uint64_t &session_tx_id) {
+    // parse json (single pass, no DOM, keys and values are views into json_str)
+    JsonRequestParser parser;
+    RequestHeader header;
+    RequestParseResult parse_result = parser.parse(json_str, header, procedures);
+    session_tx_id = header.session_tx_id;
+    if (parse_result == RequestParseResult::UNKNOWN_OPERATION) {
+        t_print(LOG_SESSION_START_RED "%s" LOG_SESSION_END "Unknown operation in transaction\n", ssl_session_handler.getSessionIDString(session_handle));
+        return -2;
+    } else if (parse_result != RequestParseResult::OK) {
+        t_print(LOG_SESSION_START_RED "%s" LOG_SESSION_END "Malformed JSON request\n", ssl_session_handler.getSessionIDString(session_handle));
+        return -5;
+    }
 
-    for (const auto &operation : transactions_json) {
-        std::string operation_str = operation["operation"];
-        OpType op_type;
-
-        if (operation_str == "INSERT") {
-            op_type = OpType::INSERT;
-        } else if (operation_str == "DELETE") {
-            op_type = OpType::DELETE;
-        } else if (operation_str == "READ") {
-            op_type = OpType::READ;
-        } else if (operation_str == "WRITE") {
-            op_type = OpType::WRITE;
-        } else if (operation_str == "SCAN") {
-            op_type = OpType::SCAN;
-        } else {
-            t_print(LOG_SESSION_START_RED "%s" LOG_SESSION_END "Unknown operation: %s\n", session_id.c_str(), operation_str.c_str());
-            return -2;
+    return check_request_header(session_handle, header.client_session_id, header.timestamp_sec, header.timestamp_nsec,
+                                header.session_tx_id);
+}
+
+/**
+ * @brief Converts a binary request (see common/binary_protocol.hpp) to a vector of `Procedure` objects.
+ * 
+ * @param session_handle Handle of the session the request was received from.
+ * @param procedures A vector of `Procedure` objects to store the result.
+ * @param payload A binary encoded request. The procedures refer to it,
+ *                so it must outlive the transaction.
+ * @param session_tx_id Set to the per-session sequence number of the request (0 if absent).
+ * 
+ * @return Same as json_to_procedures().
+ *         Returns -4 if the request is malformed.
+*/
+int binary_to_procedures(SessionHandle session_handle, std::vector<Procedure> &procedures, const std::string &payload, uint64_t &session_tx_id) {
+    const char *session_id = ssl_session_handler.getSessionIDString(session_handle);
+    BinaryReader reader(payload.data(), payload.size());
+    uint8_t magic, version;
+    uint64_t timestamp_sec, timestamp_nsec;
+    const char *client_session_id;
+    uint32_t client_session_id_len, num_operations;
+
+    if (!reader.get_u8(magic) || magic != BINARY_PROTOCOL_REQUEST_MAGIC ||
+        !reader.get_u8(version) || version != BINARY_PROTOCOL_VERSION ||
+        !reader.get_u64(timestamp_sec) || !reader.get_u64(timestamp_nsec) ||
+        !reader.get_u64(session_tx_id) ||
+        !reader.get_bytes(client_session_id, client_session_id_len) ||
+        !reader.get_u32(num_operations)) {
+        t_print(LOG_SESSION_START_RED "%s" LOG_SESSION_END "Malformed binary request\n", session_id);
+        return -4;
+    }
+
+    // decode operations as views into payload (same layout as decode_binary_request())
+    procedures.clear();
+    for (uint32_t i = 0; i < num_operations; i++) {
+        uint8_t op_code, flag;
+        const char *key, *value = nullptr;
+        uint32_t key_len, value_len = 0, limit = 0;
+        bool l_exclusive = false, r_exclusive = false, reverse = false;
+        bool ok = reader.get_u8(op_code) && reader.get_bytes(key, key_len);
+
+        if (ok) {
+            switch (op_code) {
+                case BIN_OP_READ:
+                case BIN_OP_DELETE:
+                    break;
+                case BIN_OP_INSERT:
+                case BIN_OP_WRITE:
+                case BIN_OP_RMW:
+                    ok = reader.get_bytes(value, value_len);
+                    break;
+                case BIN_OP_SCAN:
+                    ok = reader.get_u8(flag);
+                    l_exclusive = ok && (flag != 0);
+                    ok = ok && reader.get_bytes(value, value_len) && reader.get_u8(flag);
+                    r_exclusive = ok && (flag != 0);
+                    ok = ok && reader.get_u32(limit) && reader.get_u8(flag);
+                    reverse = ok && (flag != 0);
+                    break;
+                default:
+                    ok = false;
+                    break;
+            }
+        }
+        if (!ok) {
+            t_print(LOG_SESSION_START_RED "%s" LOG_SESSION_END "Malformed binary request\n", session_id);
+            return -4;
         }
 
-        if (op_type == OpType::SCAN) {
-            std::string left_key = operation["left_key"];
-            bool l_exclusive = operation["l_exclusive"].get<bool>();
-            std::string right_key = operation["right_key"];
-            bool r_exclusive = operation["r_exclusive"].get<bool>();
-            procedures.emplace_back(op_type, left_key, l_exclusive, right_key, r_exclusive);
-        } else {
-            std::string key_str = operation["key"];
-            std::string value_str = operation.value("value", "");   // If value does not exist (e.g., READ, DELETE), set empty string
-            procedures.emplace_back(op_type, key_str, value_str);
+        std::string_view key_view(key, key_len), value_view(value, value_len);
+        switch (op_code) {
+            case BIN_OP_INSERT:
+                procedures.emplace_back(OpType::INSERT, key_view, value_view);
+                break;
+            case BIN_OP_WRITE:
+                procedures.emplace_back(OpType::WRITE, key_view, value_view);
+                break;
+            case BIN_OP_READ:
+                procedures.emplace_back(OpType::READ, key_view, std::string_view());
+                break;
+            case BIN_OP_DELETE:
+                procedures.emplace_back(OpType::DELETE, key_view, std::string_view());
+                break;
+            case BIN_OP_SCAN:
+                procedures.emplace_back(OpType::SCAN, key_view, l_exclusive, value_view, r_exclusive, limit, reverse);
+                break;
+            default:
+                // RMW is not supported by the executor yet (same as JSON)
+                t_print(LOG_SESSION_START_RED "%s" LOG_SESSION_END "Unknown operation: %u\n", session_id, op_code);
+                return -2;
         }
     }
+    if (!reader.at_end()) {
+        t_print(LOG_SESSION_START_RED "%s" LOG_SESSION_END "Malformed binary request\n", session_id);
+        return -4;
+    }
 
-    return 0;
+    return check_request_header(session_handle, std::string_view(client_session_id, client_session_id_len),
+                                static_cast<long int>(timestamp_sec), static_cast<long int>(timestamp_nsec), session_tx_id);
 }
 
 /**
- * @brief Executes a transaction based on the given JSON string.
+ * @brief Executes a transaction based on the given request (JSON or binary).
  * 
  * @param trans A reference to the TxExecutor object
- * @param json_str A JSON formatted string representing the transaction operations.
+ * @param result Worker statistics, commits, aborts by reason and lock waits are added to it
+ * @param session_handle Handle of the session the transaction was received from.
+ * @param request_str A JSON formatted string or a binary encoded request representing the transaction operations.
+ *                    It may be modified in place and must not be released until this function returns.
  * @param error_message_content A reference to a string where error messages, if any,
  *                              will be stored.
  * 
  * @return Returns 0 if the transaction is successfully committed.
- *         Returns -1 if there is a problem with the JSON conversion.
+ *         Returns -1 if there is a problem with the request conversion.
  *           (e.g., replay attack detection or unknown operation.)
  *         Returns -2 if the transaction execution fails and is aborted.
+ *
+ * @note A transaction aborted by the validation phase is retried after a random
+ *       backoff that grows with every consecutive abort (AbortBackoff), so that
+ *       workers conflicting on a hot key do not abort each other in a loop.
  */
-int execute_transaction(TxExecutor &trans, const std::string &json_str, std::string &error_message_content) {
-    // convert json(string) to procedures
-    int convert_result = json_to_procedures(trans.session_id_, trans.pro_set_, json_str);
+int execute_transaction(TxExecutor &trans, WorkerResult &result, SessionHandle session_handle, std::string &request_str, std::string &error_message_content) {
+    // convert request(json or binary) to procedures
+    trans.session_handle_ = session_handle;
+    trans.session_tx_id_ = 0;
+    int convert_result = is_binary_request(request_str)
+                       ? binary_to_procedures(session_handle, trans.pro_set_, request_str, trans.session_tx_id_)
+                       : json_to_procedures(session_handle, trans.pro_set_, request_str, trans.session_tx_id_);
 
     // Check the result of conversion using switch
     switch (convert_result) {
@@ -365,16 +834,26 @@ int execute_transaction(TxExecutor &trans, const std::string &json_str, std::str
         case -2:
             error_message_content = "Error: Unknown operation in transaction.";
             return -1;  // json conversion failed
+        case -3:
+            error_message_content = "Error: Session ID does not match the connection.";
+            return -1;  // json conversion failed
+        case -4:
+            error_message_content = "Error: Malformed binary request.";
+            return -1;  // binary conversion failed
+        case -5:
+            error_message_content = "Error: Malformed JSON request.";
+            return -1;  // json conversion failed
         default:
             error_message_content = "Error: Unexpected error occurred during transaction processing.";
             return -1;  // json conversion failed
     }
 
     // Proceed with transaction execution if the conversion is successful
+    trans.backoff_.reset();
 RETRY:
     trans.durableEpochWork(trans.epoch_timer_start, trans.epoch_timer_stop, false); // TODO: falseをどうするか考える
     
-    trans.begin(trans.session_id_);
+    trans.begin(trans.session_handle_, trans.session_tx_id_);
     Status status = Status::OK;
     std::string read_value; // Store the value retrieved by the read operation
     std::vector<std::pair<std::string, std::string>> scan_result; // Store the result of the scan operation
@@ -384,24 +863,24 @@ RETRY:
             case OpType::INSERT:
                 status = trans.insert((*itr).key_, (*itr).value_);
                 if (status == Status::WARN_ALREADY_EXISTS) {
-                    t_print(LOG_SESSION_START_RED "%s" LOG_SESSION_END "Key: %s is already exists\n", trans.session_id_.c_str(), (*itr).key_.c_str());
-                    error_message_content += "Key: " + (*itr).key_ + " is already exists\n";
+                    t_print(LOG_SESSION_START_RED "%s" LOG_SESSION_END "Key: %.*s is already exists\n", ssl_session_handler.getSessionIDString(trans.session_handle_), (int)(*itr).key_.size(), (*itr).key_.data());
+                    error_message_content += "Key: " + std::string((*itr).key_) + " is already exists\n";
                 }
                 break;
             case OpType::READ:
                 status = trans.read((*itr).key_, read_value);
                 if (status == Status::WARN_NOT_FOUND) {
-                    t_print(LOG_SESSION_START_RED "%s" LOG_SESSION_END "Key: %s is not found\n", trans.session_id_.c_str(), (*itr).key_.c_str());
-                    error_message_content += "Key: " + (*itr).key_ + " is not found\n";
+                    t_print(LOG_SESSION_START_RED "%s" LOG_SESSION_END "Key: %.*s is not found\n", ssl_session_handler.getSessionIDString(trans.session_handle_), (int)(*itr).key_.size(), (*itr).key_.data());
+                    error_message_content += "Key: " + std::string((*itr).key_) + " is not found\n";
                 } else if (status == Status::OK) {
-                    trans.nid_.read_key_value_pairs.emplace_back((*itr).key_, read_value);
+                    trans.nid_.read_key_value_pairs.emplace_back(std::string((*itr).key_), read_value);
                 }
                 break;
             case OpType::WRITE:
                 status = trans.write((*itr).key_, (*itr).value_);
                 if (status == Status::WARN_NOT_FOUND) {
-                    t_print(LOG_SESSION_START_RED "%s" LOG_SESSION_END "Key: %s is not found\n", trans.session_id_.c_str(), (*itr).key_.c_str());
-                    error_message_content += "Key: " + (*itr).key_ + " is not found\n";
+                    t_print(LOG_SESSION_START_RED "%s" LOG_SESSION_END "Key: %.*s is not found\n", ssl_session_handler.getSessionIDString(trans.session_handle_), (int)(*itr).key_.size(), (*itr).key_.data());
+                    error_message_content += "Key: " + std::string((*itr).key_) + " is not found\n";
                 }
                 break;
             // case OpType::RMW:
@@ -410,9 +889,9 @@ RETRY:
             case OpType::SCAN:
                 status = trans.scan((*itr).left_key_, (*itr).l_exclusive_,
                                     (*itr).right_key_, (*itr).r_exclusive_,
-                                    scan_result);
+                                    scan_result, (*itr).limit_, (*itr).reverse_);
                 if (status == Status::ERROR_CONCURRENT_WRITE_OR_DELETE) {
-                    t_print(LOG_SESSION_START_RED "%s" LOG_SESSION_END "Concurrent write or delete detected\n", trans.session_id_.c_str());
+                    t_print(LOG_SESSION_START_RED "%s" LOG_SESSION_END "Concurrent write or delete detected\n", ssl_session_handler.getSessionIDString(trans.session_handle_));
                 } else if (status == Status::OK) {
                     for (auto &scan_result_pair : scan_result) {
                         trans.nid_.read_key_value_pairs.emplace_back(scan_result_pair);
@@ -422,8 +901,8 @@ RETRY:
             case OpType::DELETE:
                 status = trans.tx_delete((*itr).key_);
                 if (status == Status::WARN_NOT_FOUND) {
-                    t_print(LOG_SESSION_START_RED "%s" LOG_SESSION_END "Key: %s is not found\n", trans.session_id_.c_str(), (*itr).key_.c_str());
-                    error_message_content += "Key: " + (*itr).key_ + " is not found\n";
+                    t_print(LOG_SESSION_START_RED "%s" LOG_SESSION_END "Key: %.*s is not found\n", ssl_session_handler.getSessionIDString(trans.session_handle_), (int)(*itr).key_.size(), (*itr).key_.data());
+                    error_message_content += "Key: " + std::string((*itr).key_) + " is not found\n";
                 }
                 break;
             default:
@@ -438,18 +917,37 @@ RETRY:
         }
     }
 
-    if (trans.validationPhase()) {
+    bool committed = trans.validationPhase();
+    WorkerResult::add(result.local_lock_wait_count_, trans.lock_waits_);
+    trans.lock_waits_ = 0;
+    if (committed) {
         trans.writePhase();
-        t_print(LOG_SESSION_START_BMAG "%s" LOG_SESSION_END "Transaction has been committed\n", trans.session_id_.c_str());
+        WorkerResult::add(result.local_commit_count_);
+        t_print(LOG_SESSION_START_BMAG "%s" LOG_SESSION_END "Transaction has been committed\n", ssl_session_handler.getSessionIDString(trans.session_handle_));
         return 0;
     } else {
         trans.abort();
+        WorkerResult::add(result.local_abort_count_);
+        switch (trans.abort_reason_) {
+            case AbortReason::ValidationPhase1:
+                WorkerResult::add(result.local_abort_vp1_count_);
+                break;
+            case AbortReason::ValidationPhase2:
+                WorkerResult::add(result.local_abort_vp2_count_);
+                break;
+            case AbortReason::ValidationPhase3:
+                WorkerResult::add(result.local_abort_vp3_count_);
+                break;
+            default:
+                break;
+        }
+        trans.backoff_.wait();
         goto RETRY;
     }
 }
 
 void ecall_execute_worker_task(size_t worker_thid, size_t logger_thid) {
-    TxExecutor trans(worker_thid);
+    TxExecutor trans(worker_thid, ContentionPolicy::fromMode(contention_mode));
     WorkerResult &myres = std::ref(workerResults[worker_thid]);
     Logger *logger = nullptr;   // Log bufferを渡すLogger threadを紐づける
     std::atomic<Logger*> *logp = &(logs[logger_thid]);  // loggerのthreadIDを指定したいからgidを使う
@@ -462,45 +960,44 @@ void ecall_execute_worker_task(size_t worker_thid, size_t logger_thid) {
     t_print(LOG_DEBUG "wID: %d | Worker thread has started\n", worker_thid);
 
     // クライアントからのデータ受信と処理
-    std::string json_str;
+    TransactionRequest request;
+    IdleStrategy idle_strategy;
     while (true) {
         // Advance global epoch and syncronize thread local epoch
         trans.durableEpochWork(trans.epoch_timer_start, trans.epoch_timer_stop, false); // TODO: falseをどうするか考える
+        // remove records deleted a few epochs ago from masstree
+        trans.purgeTombstones(myres);
         
-        // receive data from TransactionBalancer
-        json_str = tx_balancer.getTransaction(worker_thid);
-        if (json_str.empty()) {
-            waitTime_ns(100);
+        // receive data from TransactionBalancer, spin/back off/park while there is nothing to do
+        if (!tx_balancer.getTransaction(worker_thid, request)) {
+            tx_balancer.waitForTransaction(worker_thid, idle_strategy);
             continue;
         }
+        idle_strategy.reset();
 
         // execute transaction
         std::string error_message_content = "OK";
-        int result = execute_transaction(trans, json_str, error_message_content);
+        int result = execute_transaction(trans, myres, request.session_handle_, request.payload_, error_message_content);
 
         /**
          * If the result is 0 (i.e., success) and the transaction is read-only,
          * send a success message to the client directly from here
         */
-        std::string json_message_dump;
+        std::string message_payload;
         bool send_responce = false;
+        WireFormat wire_format = ssl_session_handler.getWireFormat(trans.session_handle_);
         if (result == 0 && trans.write_set_.size() == 0) {
-            t_print(LOG_SESSION_START_BMAG "%s" LOG_SESSION_END "Read-only transaction, read items: %d\n", trans.session_id_.c_str(), trans.nid_.read_key_value_pairs.size());
-            json_message_dump = create_message(result, error_message_content, trans.nid_.read_key_value_pairs).dump();
+            t_print(LOG_SESSION_START_BMAG "%s" LOG_SESSION_END "Read-only transaction, read items: %d\n", ssl_session_handler.getSessionIDString(trans.session_handle_), trans.nid_.read_key_value_pairs.size());
+            message_payload = serialize_message(wire_format, result, error_message_content, trans.nid_.read_key_value_pairs, trans.session_tx_id_);
             send_responce = true;
         } else if (result != 0) {
-            json_message_dump = create_message(result, error_message_content).dump();
+            message_payload = serialize_message(wire_format, result, error_message_content, {}, trans.session_tx_id_);
             send_responce = true;
         }
 
         // send message to client if read-only transaction or transaction execution failed
         if (send_responce) {
-            SSLSession *session = ssl_session_handler.getSession(trans.session_id_);
-            if (session != nullptr) {
-                SSL *ssl = session->ssl_session;
-                std::lock_guard<std::mutex> lock(*session->ssl_session_mutex);
-                tls_write_to_session_peer(ssl, json_message_dump);
-            } else {
+            if (!ssl_session_handler.writeToSession(trans.session_handle_, message_payload, 1)) {
                 t_print(LOG_WARN "session == nullptr, skipped\n");
             }
         }
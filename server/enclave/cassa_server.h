@@ -12,4 +12,10 @@ extern SSLSessionHandler ssl_session_handler;
 extern Masstree masstree;
 extern uint64_t GlobalEpoch;
 
-int fcntl_set_nonblocking(int fd);
\ No newline at end of file
+int fcntl_set_nonblocking(int fd);
+
+// readiness wait (epoll in the host)
+int epoll_create_instance();
+int epoll_add_fd(int epfd, int fd);
+int epoll_del_fd(int epfd, int fd);
+int epoll_wait_ready_fds(int epfd, int *ready_fds, int max_events, int timeout_ms);
\ No newline at end of file
@@ -0,0 +1,61 @@
+/**
+ * Append workload: inserts at the right edge of the tree
+ *
+ * Inserts N keys into an empty tree with insert_value() and reports the time, the nodes
+ * built and the fill of the border nodes (keys / (border nodes * 15)).
+ *   seq    : ascending keys (auto-increment, time-ordered keys)
+ *   jitter : ascending keys, each one up to 7 ahead of its position (slightly out of order)
+ *   random : uniformly random keys
+ * Then checks that a full scan returns every key in order.
+ *
+ * Usage: ./append_bench [keys (2000000)] [threads (1)]
+ */
+#include <thread>
+
+#include "bench_common.h"
+
+static const char *MODES[] = {"seq", "jitter", "random"};
+
+static void run(int mode, uint64_t n, uint64_t threads) {
+    Masstree tree;
+    bench::NodeCount before = bench::NodeCount::now();
+    bench::Timer timer;
+    std::vector<std::thread> workers;
+    for (uint64_t t = 0; t < threads; t++) {
+        workers.emplace_back([&, t] {
+            GarbageCollector gc;
+            std::mt19937_64 rng(t + 1);
+            for (uint64_t i = t; i < n; i += threads) {
+                uint64_t k = (mode == 0) ? i : (mode == 1) ? i + rng() % 8 : rng() % (n * 1000);
+                std::string key_str = bench::make_key(k);
+                Key key(key_str);
+                Value *value = Value::create(key_str);
+                if (tree.insert_value(key, value, gc) != Status::OK) Value::destroy(value);  // 重複したキー
+            }
+        });
+    }
+    for (std::thread &worker : workers) worker.join();
+    double insert_ms = timer.elapsed_ms();
+    bench::NodeCount nodes = bench::NodeCount::now() - before;
+
+    std::vector<std::pair<Key, Value*>> result;
+    Key left(std::string("a")), right(std::string("z"));
+    tree.scan(left, false, right, false, result);
+    for (size_t i = 1; i < result.size(); i++) {
+        if (!(result[i - 1].first < result[i].first)) std::abort();
+    }
+
+    std::printf("%-6s: %8.1f ms, keys %zu, border %zu, interior %zu, border fill %.2f\n",
+                MODES[mode], insert_ms, result.size(), nodes.border, nodes.interior,
+                static_cast<double>(result.size()) / (nodes.border * (Node::ORDER - 1)));
+}
+
+int main(int argc, char **argv) {
+    const uint64_t n = bench::arg(argc, argv, 1, 2000000);
+    const uint64_t threads = bench::arg(argc, argv, 2, 1);
+
+    std::printf("keys: %lu, threads: %lu, MASSTREE_APPEND_SPLIT_PERCENT %d\n",
+                static_cast<unsigned long>(n), static_cast<unsigned long>(threads), MASSTREE_APPEND_SPLIT_PERCENT);
+    for (int mode = 0; mode < 3; mode++) run(mode, n, threads);
+    return 0;
+}
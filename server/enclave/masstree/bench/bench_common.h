@@ -0,0 +1,58 @@
+#pragma once
+
+/*
+ * Masstreeのhost側ベンチマークの共通部分 (各ベンチマークの.cppから1回だけincludeする)
+ * masstree/の.cppはSGX SDKなしでビルドできるので、enclaveの外で木だけを計測する
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <random>
+#include <algorithm>
+
+#include "../include/masstree.h"
+
+uint64_t GlobalEpoch = 1;   // defined in cassa_server.cpp in the enclave
+
+namespace bench {
+
+class Timer {
+    public:
+        Timer() : start_(std::chrono::steady_clock::now()) {}
+        double elapsed_ms() const {
+            return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_).count();
+        }
+    private:
+        std::chrono::steady_clock::time_point start_;
+};
+
+// "user%012lu"形式のキー (YCSBと同じ形、2スライス)
+inline std::string make_key(uint64_t i) {
+    char buf[32];
+    std::snprintf(buf, sizeof(buf), "user%012lu", static_cast<unsigned long>(i));
+    return std::string(buf);
+}
+
+// コマンドライン引数n番目 (なければdefault_value)
+inline uint64_t arg(int argc, char **argv, int n, uint64_t default_value) {
+    return (argc > n) ? std::strtoull(argv[n], nullptr, 10) : default_value;
+}
+
+// 使用中のノード数 (poolの使用状況の差分で数える)
+struct NodeCount {
+    size_t border;
+    size_t interior;
+
+    static NodeCount now() {
+        return NodeCount{Masstree::border_node_pool_stats().occupied(), Masstree::interior_node_pool_stats().occupied()};
+    }
+    NodeCount operator-(const NodeCount &right) const {
+        return NodeCount{border - right.border, interior - right.interior};
+    }
+};
+
+} // namespace bench
@@ -0,0 +1,49 @@
+/**
+ * Recovery: Masstree::bulk_load() vs. inserting the records one by one
+ *
+ * Builds a tree of N sorted records (the state RecoveryManager::load_recovered_records()
+ * hands over) with bulk_load(), and another one with insert_value() in key order.
+ *
+ * Usage: ./bulk_load_bench [records (1000000)]
+ */
+#include "bench_common.h"
+
+int main(int argc, char **argv) {
+    const uint64_t n = bench::arg(argc, argv, 1, 1000000);
+
+    std::vector<std::pair<Key, Value*>> records;
+    records.reserve(n);
+    for (uint64_t i = 0; i < n; i++) {
+        std::string key = bench::make_key(i);
+        records.emplace_back(Key(key), Value::create(key));
+    }
+
+    bench::NodeCount before = bench::NodeCount::now();
+    bench::Timer bulk_timer;
+    Masstree bulk;
+    if (bulk.bulk_load(records) != Status::OK) std::abort();
+    double bulk_ms = bulk_timer.elapsed_ms();
+    bench::NodeCount bulk_nodes = bench::NodeCount::now() - before;
+
+    before = bench::NodeCount::now();
+    bench::Timer insert_timer;
+    Masstree inserted;
+    GarbageCollector gc;
+    for (auto &record : records) {
+        Key key = record.first;
+        if (inserted.insert_value(key, Value::create(record.second->body()), gc) != Status::OK) std::abort();
+    }
+    double insert_ms = insert_timer.elapsed_ms();
+    bench::NodeCount insert_nodes = bench::NodeCount::now() - before;
+
+    // 両方の木から全てのキーが引けることを確認する
+    for (auto &record : records) {
+        Key key = record.first;
+        if (bulk.get_value(key) != record.second || inserted.get_value(key) == nullptr) std::abort();
+    }
+
+    std::printf("records: %lu\n", static_cast<unsigned long>(n));
+    std::printf("bulk_load    : %9.1f ms, border %zu, interior %zu\n", bulk_ms, bulk_nodes.border, bulk_nodes.interior);
+    std::printf("insert_value : %9.1f ms, border %zu, interior %zu\n", insert_ms, insert_nodes.border, insert_nodes.interior);
+    return 0;
+}
@@ -0,0 +1,63 @@
+/**
+ * Node layout: random inserts and point lookups on a large tree
+ *
+ * Inserts N keys in random order into an empty tree, then looks up every key in
+ * another random order. With 10M keys the tree is far larger than the caches, so the
+ * time is dominated by the cache lines touched per node on the way down.
+ * node_layout_bench_aligned is the same benchmark built with MASSTREE_ALIGNED_NODE_LAYOUT
+ * (nodes aligned to cache lines, permutation before key_len), make layout runs both.
+ *
+ * Usage: ./node_layout_bench [keys (10000000)] [seed (1)]
+ */
+#include "bench_common.h"
+
+int main(int argc, char **argv) {
+    const uint64_t n = bench::arg(argc, argv, 1, 10000000);
+    const uint64_t seed = bench::arg(argc, argv, 2, 1);
+
+    // キーと挿入/検索の順序は計測の外で作っておく
+    std::vector<Key> keys;
+    std::vector<Value*> values;
+    keys.reserve(n);
+    values.reserve(n);
+    for (uint64_t i = 0; i < n; i++) {
+        std::string key = bench::make_key(i * 7919 % (n * 8));  // 連続しないキー
+        keys.emplace_back(key);
+        values.push_back(Value::create(key));
+    }
+    std::vector<uint64_t> insert_order(n), lookup_order(n);
+    for (uint64_t i = 0; i < n; i++) insert_order[i] = lookup_order[i] = i;
+    std::mt19937_64 rng(seed);
+    std::shuffle(insert_order.begin(), insert_order.end(), rng);
+    std::shuffle(lookup_order.begin(), lookup_order.end(), rng);
+
+    Masstree tree;
+    GarbageCollector gc;
+    bench::NodeCount before = bench::NodeCount::now();
+    bench::Timer insert_timer;
+    for (uint64_t i : insert_order) {
+        if (tree.insert_value(keys[i], values[i], gc) != Status::OK) std::abort();
+    }
+    double insert_ms = insert_timer.elapsed_ms();
+    bench::NodeCount nodes = bench::NodeCount::now() - before;
+
+    bench::Timer lookup_timer;
+    uint64_t found = 0;
+    for (uint64_t i : lookup_order) {
+        found += (tree.get_value(keys[i]) == values[i]);
+    }
+    double lookup_ms = lookup_timer.elapsed_ms();
+    if (found != n) std::abort();
+
+#ifdef MASSTREE_ALIGNED_NODE_LAYOUT
+    const char *layout = "aligned";
+#else
+    const char *layout = "default";
+#endif
+    std::printf("keys: %lu, layout %s, sizeof(BorderNode) %zu, sizeof(InteriorNode) %zu\n",
+                static_cast<unsigned long>(n), layout, sizeof(BorderNode), sizeof(InteriorNode));
+    std::printf("insert : %8.1f ns/key (%.1f ms), border %zu, interior %zu\n",
+                insert_ms * 1e6 / n, insert_ms, nodes.border, nodes.interior);
+    std::printf("lookup : %8.1f ns/key (%.1f ms)\n", lookup_ms * 1e6 / n, lookup_ms);
+    return 0;
+}
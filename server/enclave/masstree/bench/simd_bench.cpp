@@ -0,0 +1,126 @@
+/**
+ * Node search: SIMD vs. scalar key slice comparison
+ *
+ * Measures the search inside a node at three levels, for the instruction set the binary
+ * was compiled with (make simd builds and runs simd_bench_{none,sse4.2,avx2}):
+ *   kernel : masstree_simd::equal_mask() / less_equal_mask() on 15 sorted slices
+ *   node   : InteriorNode::findChild() / BorderNode::searchLinkOrValueWithIndex() on a full node
+ *   tree   : Masstree::get_value() on a tree of N keys, in random order
+ *
+ * Usage: ./simd_bench_<isa> [tree keys (1000000)] [lookups per level (20000000)]
+ */
+#include "bench_common.h"
+
+#if defined(__AVX2__)
+static const char *ISA = "avx2";
+#elif defined(__SSE4_2__)
+static const char *ISA = "sse4.2";
+#else
+static const char *ISA = "none";
+#endif
+
+// 15スライスのノードをL1に収まる数だけ用意し、検索するsliceは事前に乱数で決めておく
+constexpr size_t NODES = 64;
+constexpr size_t NUM_KEYS = Node::ORDER - 1;
+
+static uint64_t slice_of(uint64_t i) {
+    return (i + 1) * 0x0101010101010101ULL;
+}
+
+int main(int argc, char **argv) {
+    const uint64_t n = bench::arg(argc, argv, 1, 1000000);
+    const uint64_t lookups = bench::arg(argc, argv, 2, 20000000);
+
+    std::mt19937_64 rng(1);
+    std::vector<uint64_t> queries(4096);
+    for (uint64_t &q : queries) q = slice_of(rng() % (NUM_KEYS + 1)) + (rng() % 2);   // 一致するsliceと間のslice
+    uint64_t checksum = 0;
+
+    // kernel: SIMD版は16要素を読むので、配列は16要素分確保する
+    std::vector<std::array<std::atomic<uint64_t>, Node::ORDER>> slices(NODES);
+    for (auto &node : slices) {
+        for (size_t i = 0; i < Node::ORDER; i++) node[i].store(slice_of(i));
+    }
+    bench::Timer equal_timer;
+    for (uint64_t i = 0; i < lookups; i++) {
+        checksum += masstree_simd::equal_mask(slices[i % NODES].data(), NUM_KEYS, queries[i % queries.size()]);
+    }
+    double equal_ms = equal_timer.elapsed_ms();
+    bench::Timer less_equal_timer;
+    for (uint64_t i = 0; i < lookups; i++) {
+        checksum += masstree_simd::less_equal_mask(slices[i % NODES].data(), NUM_KEYS, queries[i % queries.size()]);
+    }
+    double less_equal_ms = less_equal_timer.elapsed_ms();
+
+    // node: 満杯のInteriorNodeとBorderNode (sliceだけのキー)
+    std::vector<Node*> children;
+    std::vector<InteriorNode*> interiors;
+    std::vector<BorderNode*> borders;
+    std::vector<Key> border_keys;
+    for (size_t i = 0; i < NUM_KEYS; i++) {
+        std::string key(8, static_cast<char>('a' + i));
+        border_keys.emplace_back(key);
+    }
+    Value *value = Value::create("value");
+    for (size_t n_i = 0; n_i < NODES; n_i++) {
+        InteriorNode *interior = new InteriorNode();
+        interior->setIsBorder(false);
+        interior->setNumKeys(NUM_KEYS);
+        for (size_t i = 0; i < NUM_KEYS; i++) interior->setKeySlice(i, slice_of(i));
+        for (size_t i = 0; i <= NUM_KEYS; i++) {
+            children.push_back(new BorderNode());
+            interior->setChild(i, children.back());
+        }
+        interiors.push_back(interior);
+
+        BorderNode *border = new BorderNode();
+        for (size_t i = 0; i < NUM_KEYS; i++) {
+            border->setKeySlice(i, border_keys[i].getCurrentSlice().slice);
+            border->setKeyLen(i, 8);
+            border->setLV(i, LinkOrValue(value));
+        }
+        border->setPermutation(Permutation::fromSorted(NUM_KEYS));
+        borders.push_back(border);
+    }
+    bench::Timer find_child_timer;
+    for (uint64_t i = 0; i < lookups; i++) {
+        checksum += reinterpret_cast<uintptr_t>(interiors[i % NODES]->findChild(queries[i % queries.size()]));
+    }
+    double find_child_ms = find_child_timer.elapsed_ms();
+    bench::Timer search_timer;
+    for (uint64_t i = 0; i < lookups; i++) {
+        auto result = borders[i % NODES]->searchLinkOrValueWithIndex(border_keys[i % NUM_KEYS]);
+        if (std::get<0>(result) != VALUE) std::abort();
+        checksum += std::get<2>(result);
+    }
+    double search_ms = search_timer.elapsed_ms();
+
+    // tree: n個のキーの木をランダムな順序で検索する
+    std::vector<Key> keys;
+    keys.reserve(n);
+    Masstree tree;
+    GarbageCollector gc;
+    for (uint64_t i = 0; i < n; i++) {
+        std::string key = bench::make_key(i);
+        keys.emplace_back(key);
+        if (tree.insert_value(keys.back(), Value::create(key), gc) != Status::OK) std::abort();
+    }
+    std::vector<uint64_t> order(n);
+    for (uint64_t i = 0; i < n; i++) order[i] = i;
+    std::shuffle(order.begin(), order.end(), rng);
+    const uint64_t tree_lookups = std::max<uint64_t>(n, lookups / 10);
+    bench::Timer tree_timer;
+    for (uint64_t i = 0; i < tree_lookups; i++) {
+        if (tree.get_value(keys[order[i % n]]) == nullptr) std::abort();
+    }
+    double tree_ms = tree_timer.elapsed_ms();
+
+    std::printf("MASSTREE_SIMD=%s\n", ISA);
+    std::printf("kernel equal_mask                 : %7.2f ns\n", equal_ms * 1e6 / lookups);
+    std::printf("kernel less_equal_mask            : %7.2f ns\n", less_equal_ms * 1e6 / lookups);
+    std::printf("node   findChild                  : %7.2f ns\n", find_child_ms * 1e6 / lookups);
+    std::printf("node   searchLinkOrValueWithIndex : %7.2f ns\n", search_ms * 1e6 / lookups);
+    std::printf("tree   get_value (%lu keys)   : %7.2f ns\n", static_cast<unsigned long>(n), tree_ms * 1e6 / tree_lookups);
+    std::printf("(checksum %lu)\n", static_cast<unsigned long>(checksum));
+    return 0;
+}
@@ -4,19 +4,36 @@
 #include "masstree_get.h"
 #include "masstree_remove.h"
 #include "masstree_scan.h"
+#include "masstree_bulk_load.h"
 #include "../../cassa_common/status.h"
 
 class Masstree {
     public:
         Status insert_value(Key &key, Value *value, GarbageCollector &gc);
+        // keyが無ければvalueを挿入してvalueを、あれば既存のValueを返す (1回の降下で行う)
+        Value *insert_or_get(Key &key, Value *value, GarbageCollector &gc);
         Status remove_value(Key &key, GarbageCollector &gc);
         Value *get_value(Key &key);
         Status scan(Key &left_key,
                     bool l_exclusive,
                     Key &right_key,
                     bool r_exclusive,
-                    std::vector<std::pair<Key, Value*>> &result);
+                    std::vector<std::pair<Key, Value*>> &result,
+                    size_t limit = 0,
+                    bool reverse = false);
+        // 範囲を決めずにseek/next/prevで走査するためのiterator
+        MasstreeIterator iterator() const;
+        // 空の木をソート済みのrecordsから一度に組み立てる
+        Status bulk_load(const std::vector<std::pair<Key, Value*>> &records);
+
+        // BorderNode/InteriorNodeのpoolを事前に確保する(pre-touch済み)
+        static void reserve_nodes(size_t border_nodes, size_t interior_nodes);
+        // BorderNode/InteriorNodeのpoolの使用状況
+        static SlabAllocator::Stats border_node_pool_stats();
+        static SlabAllocator::Stats interior_node_pool_stats();
 
     private:
         std::atomic<Node *> root{nullptr};
+
+        Status insert_internal(Key &key, Value *value, GarbageCollector &gc, Value *&found);
 };
\ No newline at end of file
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+
+#include "masstree_node.h"
+
+/*
+ * ソート済みの(key, value)の列からMasstreeを下から組み立てる
+ *   - 1レイヤー分のキーをsliceごとにまとめ、BorderNodeに詰められるだけ詰める(同じsliceのキーは同じBorderNodeに置く)
+ *   - 同じsliceで9byte以上残るキーが1つならsuffixとして、2つ以上なら下のレイヤーを再帰的に組み立ててlinkとして置く
+ *   - BorderNodeの列の上にInteriorNodeを1段ずつ、rootが1つになるまで積む
+ * 降下、lock、splitを一切行わないので、1件ずつinsertするよりずっと速い
+ */
+
+// records[begin, end)(depth番目より前のスライスは全て等しい)から1レイヤー分の木を作ってそのrootを返す
+Node *bulk_load_layer(const std::vector<std::pair<Key, Value*>> &records, size_t begin, size_t end, size_t depth);
+
+// records(キーの昇順、重複なし、空でない)からMasstree全体を作ってLayer0のrootを返す
+Node *masstree_bulk_load(const std::vector<std::pair<Key, Value*>> &records);
@@ -1,7 +1,25 @@
 #pragma once
 
+#include <vector>
+#include <cstdint>
+
 #include "masstree_node.h"
 
+extern uint64_t GlobalEpoch;    // defined in cassa_server.cpp
+
+/**
+ * @class GarbageCollector
+ * @brief Epoch-based reclamation of nodes, values and value bodies unlinked by one worker
+ *
+ * @note  Masstree readers and Silo readers do not take locks, so an object unlinked
+ *        from the tree (or a value body replaced by writePhase) may still be dereferenced
+ *        by other workers. add() tags the object with the global epoch at the time of
+ *        retirement, and run(reclaim_epoch) only frees objects retired before reclaim_epoch.
+ *        The owner computes reclaim_epoch from the ThLocalEpoch of every worker
+ *        (see TxExecutor::reclaimableEpoch()). run() without an argument frees everything
+ *        and may only be used while no other thread touches the tree (recovery, shutdown).
+ *        Not thread-safe, owned by one worker.
+ */
 class GarbageCollector {
     public:
         // コンストラクタ
@@ -13,60 +31,110 @@ class GarbageCollector {
         GarbageCollector &operator=(const GarbageCollector &other) = delete;
         // BorderNodeをGCに追加
         void add(BorderNode *borderNode) {
-            assert(!contain(borderNode));
             assert(borderNode->getDeleted());
-            borders.push_back(borderNode);
+            borders.push(borderNode);
         }
         // InteriorNodeをGCに追加
         void add(InteriorNode *interiorNode) {
-            assert(!contain(interiorNode));
             assert(interiorNode->getDeleted());
-            interiors.push_back(interiorNode);
+            interiors.push(interiorNode);
         }
         // ValueをGCに追加
         void add(Value *value) {
-            assert(!contain(value));
-            values.push_back(value);
+            values.push(value);
         }
         // BigSuffixをGCに追加
         void add(BigSuffix *suffix) {
-            assert(!contain(suffix));
-            suffixes.push_back(suffix);
+            suffixes.push(suffix);
         }
-        // 指定したBorderNodeが格納されているか確認
-        bool contain(BorderNode const *borderNode) {
-            return std::find(borders.begin(), borders.end(), borderNode) != borders.end();
+        // 差し替えられたValueのbodyをGCに追加 (inlineだったbodyはnullptrで渡されるので何もしない)
+        void add(ValueBody *body) {
+            if (body != nullptr) bodies.push(body);
         }
+        // 指定したBorderNodeが格納されているか確認
+        bool contain(BorderNode const *borderNode) const { return borders.contain(borderNode); }
         // 指定したInteriorNodeが格納されているか確認
-        bool contain(InteriorNode const *interiorNode) {
-            return std::find(interiors.begin(), interiors.end(), interiorNode) != interiors.end();
-        }
+        bool contain(InteriorNode const *interiorNode) const { return interiors.contain(interiorNode); }
         // 指定したValueが格納されているか確認
-        bool contain(Value const *value) {
-            return std::find(values.begin(), values.end(), value) != values.end();
-        }
+        bool contain(Value const *value) const { return values.contain(value); }
         // 指定したBigSuffixが格納されているか確認
-        bool contain(BigSuffix const *suffix) const {
-            return std::find(suffixes.begin(), suffixes.end(), suffix) != suffixes.end();
+        bool contain(BigSuffix const *suffix) const { return suffixes.contain(suffix); }
+
+        /**
+         * @brief Free the objects retired before reclaim_epoch
+         * @param reclaim_epoch No worker can still hold a pointer obtained before this epoch
+         * @return Number of freed objects
+         */
+        size_t run(uint64_t reclaim_epoch) {
+            return borders.reclaim(reclaim_epoch) + interiors.reclaim(reclaim_epoch)
+                 + values.reclaim(reclaim_epoch) + suffixes.reclaim(reclaim_epoch)
+                 + bodies.reclaim(reclaim_epoch);
         }
-        // 保持している全てのノードや値を解放する
-        void run() {
-            for (auto &borderNode : borders) delete borderNode;
-            borders.clear();
 
-            for (auto &interiorNode: interiors) delete interiorNode;
-            interiors.clear();
+        // 保持している全てのノードや値を解放する
+        size_t run() {
+            __atomic_add_fetch(&full_reclaims_, 1, __ATOMIC_ACQ_REL);
+            return run(UINT64_MAX);
+        }
 
-            for (auto &value : values) delete value;
-            values.clear();
+        // run()で全て解放した回数 (epochと無関係に解放されたので、保持していたノードへのポインタは使えない)
+        static uint64_t full_reclaims() {
+            return __atomic_load_n(&full_reclaims_, __ATOMIC_ACQUIRE);
+        }
 
-            for (auto &suffix : suffixes) delete suffix;
-            suffixes.clear();
+        // 解放待ちのオブジェクト数
+        size_t size() const {
+            return borders.size() + interiors.size() + values.size() + suffixes.size() + bodies.size();
         }
 
     private:
-        std::vector<BorderNode *> borders{};        // 削除されたBorderNodeを格納するvector
-        std::vector<InteriorNode *> interiors{};    // 削除されたInteriorNodeを格納するvector
-        std::vector<Value *> values{};              // 削除されたValueを格納するvector
-        std::vector<BigSuffix *> suffixes{};        // 削除されたBigSuffixを格納するvector
-};
\ No newline at end of file
+        // 型ごとの解放方法 (Value, ValueBody, BigSuffixはSlabAllocatorに返す)
+        static void dispose(BorderNode *borderNode) { delete borderNode; }
+        static void dispose(InteriorNode *interiorNode) { delete interiorNode; }
+        static void dispose(BigSuffix *suffix) { BigSuffix::destroy(suffix); }
+        static void dispose(Value *value) { Value::destroy(value); }
+        static void dispose(ValueBody *body) { ValueBody::destroy(body); }
+
+        // retireした順(= epochの昇順)に並ぶので、解放は常に先頭から行える
+        template <class T>
+        class RetireList {
+            public:
+                void push(T *object) {
+                    assert(object != nullptr);
+                    entries_.push_back(Entry{object, __atomic_load_n(&GlobalEpoch, __ATOMIC_ACQUIRE)});
+                }
+
+                size_t reclaim(uint64_t reclaim_epoch) {
+                    size_t n = 0;
+                    while (n < entries_.size() && entries_[n].epoch < reclaim_epoch) {
+                        dispose(entries_[n].object);
+                        n++;
+                    }
+                    entries_.erase(entries_.begin(), entries_.begin() + n);
+                    return n;
+                }
+
+                bool contain(T const *object) const {
+                    return std::find_if(entries_.begin(), entries_.end(), [object](const Entry &entry) {
+                        return entry.object == object;
+                    }) != entries_.end();
+                }
+
+                size_t size() const { return entries_.size(); }
+
+            private:
+                struct Entry {
+                    T *object;
+                    uint64_t epoch;     // GlobalEpoch when the object was retired
+                };
+                std::vector<Entry> entries_;
+        };
+
+        RetireList<BorderNode> borders{};        // 削除されたBorderNode
+        RetireList<InteriorNode> interiors{};    // 削除されたInteriorNode
+        RetireList<Value> values{};              // 削除されたValue
+        RetireList<BigSuffix> suffixes{};        // 削除されたBigSuffix
+        RetireList<ValueBody> bodies{};          // writePhaseで差し替えられたValueのbody
+
+        static inline uint64_t full_reclaims_ = 0;
+};
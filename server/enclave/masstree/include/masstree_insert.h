@@ -18,13 +18,15 @@ void insert_to_border(BorderNode *border, const Key &key, Value *value, GarbageC
 
 // size_t cut(size_t len) {}
 
-void split_keys_among(InteriorNode *parent, InteriorNode *parent1, uint64_t slice, Node *node1, size_t node_index, std::optional<uint64_t> &k_prime);
+void split_keys_among(InteriorNode *parent, InteriorNode *parent1, uint64_t slice, Node *node1, size_t node_index, std::optional<uint64_t> &k_prime, bool append);
 
 void create_slice_table(BorderNode *const node, std::vector<std::pair<uint64_t, size_t>> &table, std::vector<uint64_t> &found);
 
-size_t split_point(uint64_t new_slice, const std::vector<std::pair<uint64_t, size_t>> &table, const std::vector<uint64_t> &found);
+size_t split_point(uint64_t new_slice, const std::vector<std::pair<uint64_t, size_t>> &table, const std::vector<uint64_t> &found, bool append);
 
-void split_keys_among(BorderNode *node, BorderNode *node1, const Key &key, Value *value);
+void split_keys_among(BorderNode *node, BorderNode *node1, const Key &key, Value *value, bool append);
+
+bool is_append_to_border(BorderNode *const node, const Key &key);
 
 InteriorNode *create_root_with_children(Node *left, uint64_t slice, Node *right);
 
@@ -32,4 +34,9 @@ void insert_into_parent(InteriorNode *parent, Node *node1, uint64_t slice, size_
 
 Node *split(Node *node, const Key &key, Value *value);
 
-std::pair<Status, Node*> masstree_insert(Node *root, Key &key, Value *value, GarbageCollector &gc);
\ No newline at end of file
+bool rightmost_leaf_covers(BorderNode *const node, const Key &key);
+
+// keyが既に存在した場合は何もせずにWARN_ALREADY_EXISTSを返し、foundに既存のValueを入れる
+// rightmost_hintはLayer0の右端のBorderNodeのhint(nullptrならhintを使わない)、使えれば降下を省略し、右端にinsertしたら更新する
+std::pair<Status, Node*> masstree_insert(Node *root, Key &key, Value *value, GarbageCollector &gc, Value *&found,
+                                         BorderNode **rightmost_hint);
\ No newline at end of file
@@ -1,9 +1,12 @@
 #pragma once
 
 #include <cstdint>
+#include <cstring>
 #include <vector>
 #include <cassert>
 #include <string>
+#include <string_view>
+#include <algorithm>
 
 // CHECK: KeyWithSliceって何に使うんだ？
 
@@ -24,19 +27,110 @@ struct SliceWithSize {
     }
 };
 
+/**
+ * @brief Slices of a Key, stored inline up to INLINE_CAPACITY slices (32 bytes of key)
+ * @note Provides the subset of the std::vector<uint64_t> interface used by Masstree,
+ *       so that building and copying typical keys (Key(str_key), ReadElement/WriteElement)
+ *       never touches the allocator. Longer keys spill to the heap.
+ */
+class KeySlices {
+public:
+    static constexpr size_t INLINE_CAPACITY = 4;
+
+    KeySlices() = default;
+    KeySlices(const std::vector<uint64_t> &v) { assign(v.data(), v.size()); }
+    KeySlices(const KeySlices &other) { assign(other.data(), other.size_); }
+    KeySlices(KeySlices &&other) noexcept { steal(other); }
+    KeySlices &operator=(const KeySlices &other) {
+        if (this != &other) assign(other.data(), other.size_);
+        return *this;
+    }
+    KeySlices &operator=(KeySlices &&other) noexcept {
+        if (this != &other) {
+            delete[] heap_;
+            steal(other);
+        }
+        return *this;
+    }
+    ~KeySlices() { delete[] heap_; }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    uint64_t *data() { return heap_ ? heap_ : inline_; }
+    const uint64_t *data() const { return heap_ ? heap_ : inline_; }
+    uint64_t &operator[](size_t i) { assert(i < size_); return data()[i]; }
+    const uint64_t &operator[](size_t i) const { assert(i < size_); return data()[i]; }
+    uint64_t &back() { assert(size_ != 0); return data()[size_ - 1]; }
+    const uint64_t &back() const { assert(size_ != 0); return data()[size_ - 1]; }
+    uint64_t *begin() { return data(); }
+    uint64_t *end() { return data() + size_; }
+    const uint64_t *begin() const { return data(); }
+    const uint64_t *end() const { return data() + size_; }
+
+    void push_back(uint64_t slice) {
+        if (size_ == capacity_) reserve(capacity_ * 2);
+        data()[size_++] = slice;
+    }
+    // new slices are zero
+    void resize(size_t n) {
+        reserve(n);
+        if (n > size_) std::memset(data() + size_, 0, (n - size_) * sizeof(uint64_t));
+        size_ = static_cast<uint32_t>(n);
+    }
+    void clear() { size_ = 0; }
+    void reserve(size_t n) {
+        if (n <= capacity_) return;
+        uint64_t *grown = new uint64_t[n];
+        std::memcpy(grown, data(), size_ * sizeof(uint64_t));
+        delete[] heap_;
+        heap_ = grown;
+        capacity_ = static_cast<uint32_t>(n);
+    }
+
+    bool operator==(const KeySlices &right) const {
+        return size_ == right.size_ && std::memcmp(data(), right.data(), size_ * sizeof(uint64_t)) == 0;
+    }
+    bool operator!=(const KeySlices &right) const { return !(*this == right); }
+
+private:
+    uint64_t *heap_ = nullptr;      // nullptr while the slices fit in inline_
+    uint32_t size_ = 0;
+    uint32_t capacity_ = INLINE_CAPACITY;
+    uint64_t inline_[INLINE_CAPACITY];
+
+    void assign(const uint64_t *src, size_t n) {
+        size_ = 0;
+        reserve(n);
+        std::memcpy(data(), src, n * sizeof(uint64_t));
+        size_ = static_cast<uint32_t>(n);
+    }
+    void steal(KeySlices &other) {
+        if (other.heap_) {
+            heap_ = other.heap_;
+            capacity_ = other.capacity_;
+            other.heap_ = nullptr;
+            other.capacity_ = INLINE_CAPACITY;
+        } else {
+            heap_ = nullptr;
+            capacity_ = INLINE_CAPACITY;
+            std::memcpy(inline_, other.inline_, other.size_ * sizeof(uint64_t));
+        }
+        size_ = other.size_;
+        other.size_ = 0;
+    }
+};
+
 class Key {
     public:
-        std::vector<uint64_t> slices;   // スライスのリスト
+        KeySlices slices;               // スライスのリスト (32byteまではinline)
         size_t lastSliceSize = 0;       // 最後のスライスのサイズ
         size_t cursor = 0;              // 現在のスライスの位置/インデックス
 
-        Key(const std::string &key) {
-            std::pair<std::vector<uint64_t>, size_t> slices_lastSliceSize = string_to_uint64t(key);
-            slices = std::move(slices_lastSliceSize.first);
-            lastSliceSize = slices_lastSliceSize.second;
+        Key(std::string_view key) {
+            string_to_uint64t(key);
             assert(1 <= lastSliceSize && lastSliceSize <= 8);
         }
-        Key(std::vector<uint64_t> slices_, size_t lastSliceSize_) : slices(std::move(slices_)), lastSliceSize(lastSliceSize_) {
+        Key(const std::vector<uint64_t> &slices_, size_t lastSliceSize_) : slices(slices_), lastSliceSize(lastSliceSize_) {
             assert(1 <= lastSliceSize && lastSliceSize <= 8);
         }
         // 次のスライスが存在するかどうかを確認する
@@ -87,54 +181,60 @@ class Key {
         // 演算子 < のオーバーロード
         bool operator<(const Key& right) const {
             // 最小のサイズを取得して、それに基づいてスライスを比較
-            size_t minSize = std::min(slices.size(), right.slices.size());
+            const size_t minSize = std::min(slices.size(), right.slices.size());
+            const uint64_t *l = slices.data();
+            const uint64_t *r = right.slices.data();
             for (size_t i = 0; i < minSize; i++) {
                 // スライスが異なる場合は、そのスライスに基づいて比較結果を返す
-                if (slices[i] != right.slices[i]) {
-                    return slices[i] < right.slices[i];
+                if (l[i] != r[i]) {
+                    return l[i] < r[i];
                 }
             }
 
-            // すべてのスライスが等しい場合は、最後のスライスのサイズで比較
-            if (lastSliceSize != right.lastSliceSize) {
-                return lastSliceSize < right.lastSliceSize;
+            // スライスの数が異なる場合は、短い方が長い方のprefixになっているので小さいと判断
+            if (slices.size() != right.slices.size()) {
+                return slices.size() < right.slices.size();
             }
 
-            // スライスの数が異なる場合は、スライスの数が少ない方が小さいと判断
-            return slices.size() < right.slices.size();
+            // スライスの数も等しい場合は、最後のスライスのサイズで比較
+            return lastSliceSize < right.lastSliceSize;
         }
 
-        std::pair<std::vector<uint64_t>, size_t> string_to_uint64t(const std::string &key) {
-            std::vector<uint64_t> slices;
-            size_t lastSliceSize = 0;
-            size_t index = 0;
-
-            while (index < key.size()) {
-                uint64_t slice = 0;
-                size_t i = 0;
-                for (; i < 8 && index < key.size(); i++, index++) {
-                    slice = (slice << 8) | static_cast<uint8_t>(key[index]);    // 8bit左シフトしてORを取ることでsliceにkey[index]を挿入する
-                }
-                slice <<= (8 - i) * 8;    // 残りの部分を0埋め
-                slices.push_back(slice);
-                lastSliceSize = i;
+        /**
+         * @brief Split the key into big-endian 8-byte slices (the last one is zero padded)
+         * @note Whole slices are loaded at once and byte-swapped instead of being shifted in byte by byte.
+         */
+        void string_to_uint64t(std::string_view key) {
+            const size_t num_slices = (key.size() + 7) / 8;
+            slices.resize(num_slices);
+            uint64_t *out = slices.data();
+            const char *src = key.data();
+            for (size_t i = 0; i + 1 < num_slices; i++) {
+                uint64_t slice;
+                std::memcpy(&slice, src + i * 8, 8);
+                out[i] = __builtin_bswap64(slice);
+            }
+            lastSliceSize = 0;
+            if (num_slices != 0) {
+                lastSliceSize = key.size() - (num_slices - 1) * 8;
+                uint64_t slice = 0;     // 残りの部分を0埋め
+                std::memcpy(&slice, src + (num_slices - 1) * 8, lastSliceSize);
+                out[num_slices - 1] = __builtin_bswap64(slice);
             }
-
-            return std::make_pair(slices, lastSliceSize);
         }
 
-        std::string uint64t_to_string(const std::vector<uint64_t> &slices, size_t lastSliceSize) {
-            std::string result;
+        std::string uint64t_to_string(const KeySlices &slices, size_t lastSliceSize) const {
+            assert(!slices.empty());
+            std::string result((slices.size() - 1) * 8 + lastSliceSize, '\0');
+            char *dst = &result[0];
             // 最後のスライス以外の処理
-            for (size_t i = 0; i < slices.size() - 1; i++) {
-                for (int j = 7; j >= 0; j--) {  // jをsize_tにするとj=-1の時にオーバーフローが発生するよ！
-                    result.push_back(static_cast<char>((slices[i] >> (j * 8)) & 0xFF)); // AND 0xFFで下位8bitを取得する
-                }
+            for (size_t i = 0; i + 1 < slices.size(); i++) {
+                uint64_t slice = __builtin_bswap64(slices[i]);
+                std::memcpy(dst + i * 8, &slice, 8);
             }
             // 最後のスライスの処理(lastSliceSizeより後ろは0埋めされているので)
-            for (size_t i = 0; i < lastSliceSize; i++) {
-                result.push_back(static_cast<char>((slices.back() >> ((7 - i) * 8)) & 0xFF));
-            }
+            uint64_t slice = __builtin_bswap64(slices.back());
+            std::memcpy(dst + (slices.size() - 1) * 8, &slice, lastSliceSize);
             return result;
         }
-};
\ No newline at end of file
+};
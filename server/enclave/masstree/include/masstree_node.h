@@ -10,15 +10,26 @@
 #include <array>
 
 #include "../../cassa_common/atomic_wrapper.h"
+#include "../../cassa_common/consts.h"
 #include "../../cassa_common/db_value.h"
+#include "../../cassa_common/slab_allocator.hpp"
 #include "masstree_version.h"
 #include "masstree_key.h"
 #include "permutation.h"
+#include "masstree_simd.h"
 
 class InteriorNode;
 class BorderNode;
 
-class Node {
+// MASSTREE_ALIGNED_NODE_LAYOUTはノードをcache line境界に揃え、BorderNodeのpermutationをkey_lenの前に置く
+// (version, permutation, key_lenが先頭のcache lineに入る)。10M keyのnode_layout_benchでは検索・挿入とも
+// 差が誤差の範囲だったので、デフォルトは元のレイアウトのまま (make layoutで比較できる)
+#ifdef MASSTREE_ALIGNED_NODE_LAYOUT
+#define MASSTREE_NODE_ALIGN alignas(CACHE_LINE_SIZE)
+#else
+#define MASSTREE_NODE_ALIGN
+#endif
+class MASSTREE_NODE_ALIGN Node {
     public:
         static constexpr size_t ORDER = 16;
 
@@ -30,6 +41,22 @@ class Node {
         Node(Node&& other) = delete;
         Node &operator=(Node&& other) = delete;
 
+        // BorderNodeとInteriorNodeはSlabAllocatorのpoolから確保する
+        // GarbageCollectorでdeleteされるとpoolに戻り、次のsplitで再利用される
+        static void *operator new(size_t size) {
+            uint8_t size_class = SlabAllocator::size_class(size);
+            if (size_class == SlabAllocator::HEAP_CLASS) return ::operator new(size);
+            return SlabAllocator::instance().allocate(size_class);
+        }
+        static void operator delete(void *ptr, size_t size) {
+            uint8_t size_class = SlabAllocator::size_class(size);
+            if (size_class == SlabAllocator::HEAP_CLASS) {
+                ::operator delete(ptr);
+            } else {
+                SlabAllocator::instance().deallocate(ptr, size_class);
+            }
+        }
+
         // 挿入や分割中でない安定したバージョン((version.inserting || version.splitting) == 0)を取得する
         Version stableVersion() const {
             Version v = getVersion();
@@ -202,12 +229,11 @@ class InteriorNode : public Node {
     public:
         InteriorNode() : n_keys(0) {}
         // 指定されたスライスを持つ子ノードを検索する
+        // key_sliceはソート済みなので、slice以下のキーの数が辿る子ノードのindexになる
         Node *findChild(uint64_t slice) {
             uint8_t num_keys = getNumKeys();
-            for (size_t i = 0; i < num_keys; i++) {
-                if (slice < key_slice[i]) return getChild(i);
-            }
-            return getChild(num_keys);
+            uint32_t le_mask = masstree_simd::less_equal_mask(key_slice.data(), num_keys, slice);
+            return getChild(__builtin_popcount(le_mask));
         }
         // ノードが満杯でないか確認
         inline bool isNotFull() const {
@@ -301,82 +327,110 @@ union LinkOrValue {
     Value *value;               // 実際の値へのポインタ
 };
 
-// vectorの先頭要素を消す
-template<typename T>
-static void pop_front(std::vector<T> &v) {
-    if (!v.empty()) v.erase(v.begin());
-}
-
-// BigSuffixは、Suffixが8byteよりも大きい場合に使用されるクラス
-// 複数のスライス(8byteごと)としてSuffixを保存し、Suffixの長さや現在のスライスの情報、次のSuffixが存在するかどうかを管理する
+/**
+ * @class BigSuffix
+ * @brief Slices of a key beyond the slice stored in its BorderNode (keys longer than 8 bytes in the layer)
+ *
+ * @note  Immutable once published: the slices follow the header in the same block and are never
+ *        modified, so readers (get, scan) compare them with memcmp without taking any lock.
+ *        Creating or removing a layer builds a new BigSuffix (withoutTop(), withTop()) and retires
+ *        the old one through the GarbageCollector.
+ *        Allocated from the SlabAllocator like ValueBody, freed with destroy().
+ */
 class BigSuffix {
 public:
-    BigSuffix() = default;
-    // コピーコンストラクタ
-    BigSuffix(const BigSuffix &other) : slices(other.slices), lastSliceSize(other.lastSliceSize) {}
-    // コピーオペレータ、ムーブコンストラクタ、ムーブオペレータの削除
+    BigSuffix(const BigSuffix &other) = delete;
     BigSuffix &operator=(const BigSuffix &other) = delete;
     BigSuffix(BigSuffix &&other) = delete;
     BigSuffix &operator=(BigSuffix &&other) = delete;
-    // slicesとlastSliceSizeを指定して初期化するコンストラクタ
-    BigSuffix(std::vector<uint64_t> &&slices_, size_t lastSliceSize_) : slices(std::move(slices_)), lastSliceSize(lastSliceSize_) {}
 
-    // 現在のスライスを取得する(最後のスライスならそのスライスだけ、違うなら8byte)
-    SliceWithSize getCurrentSlice() {
-        if (hasNext()) {
-            std::lock_guard<std::mutex> lock(suffixMutex);
-            return SliceWithSize(slices[0], 8);
+    // num_slices個のスライスを持つBigSuffixを作成する (最後のスライスのサイズはlastSliceSize)
+    static BigSuffix *create(const uint64_t *slices, size_t num_slices, size_t lastSliceSize) {
+        BigSuffix *suffix = allocate(num_slices, lastSliceSize);
+        std::memcpy(suffix->data(), slices, num_slices * sizeof(uint64_t));
+        return suffix;
+    }
+
+    // 指定したキーと開始位置から新しいBigSuffixを作成
+    static BigSuffix *from(const Key &key, size_t from) {
+        assert(from < key.slices.size());
+        return create(key.slices.data() + from, key.slices.size() - from, key.lastSliceSize);
+    }
+
+    static void destroy(BigSuffix *suffix) {
+        if (suffix == nullptr) return;
+        if (suffix->slab_class_ == SlabAllocator::HEAP_CLASS) {
+            ::operator delete(suffix);
         } else {
-            std::lock_guard<std::mutex> lock(suffixMutex);
-            return SliceWithSize(slices[0], lastSliceSize);
+            SlabAllocator::instance().deallocate(suffix, suffix->slab_class_);
         }
     }
-    // 残りのスライスの長さを返す
-    size_t remainLength() {
-        std::lock_guard<std::mutex> lock(suffixMutex);
-        return (slices.size() - 1) * 8 + lastSliceSize;
+
+    // 先頭のスライスを除いたBigSuffixを新しく作る (キーを下のレイヤーに移すとき)
+    BigSuffix *withoutTop() const {
+        assert(hasNext());
+        return create(data() + 1, num_slices_ - 1, last_slice_size_);
     }
-    // 次のスライスが存在するかを返す、slicesが2より大きいなら次のスライスがある(slicesをpop_frontしていくのでここで気づける)
-    bool hasNext() {
-        std::lock_guard<std::mutex> lock(suffixMutex);
-        return slices.size() >= 2;
+
+    // 先頭にsliceを加えたBigSuffixを新しく作る (キーを上のレイヤーに戻すとき)
+    BigSuffix *withTop(uint64_t slice) const {
+        BigSuffix *suffix = allocate(num_slices_ + 1, last_slice_size_);
+        suffix->data()[0] = slice;
+        std::memcpy(suffix->data() + 1, data(), num_slices_ * sizeof(uint64_t));
+        return suffix;
     }
-    // 次のスライスに移動する
-    void next() {
-        assert(hasNext());
-        pop_front(slices);
+
+    // 現在のスライスを取得する(最後のスライスならそのスライスだけ、違うなら8byte)
+    SliceWithSize getCurrentSlice() const {
+        return SliceWithSize(data()[0], hasNext() ? 8 : last_slice_size_);
+    }
+    // 残りのスライスの長さを返す
+    size_t remainLength() const {
+        return (num_slices_ - 1) * 8 + last_slice_size_;
     }
-    // スライスの先頭に新しいスライスを追加する
-    // CHECK: これ何に使うんだ？
-    void insertTop(uint64_t slice) {
-        std::lock_guard<std::mutex> lock(suffixMutex);
-        slices.insert(slices.begin(), slice);
+    // 次のスライスが存在するかを返す
+    bool hasNext() const {
+        return num_slices_ >= 2;
     }
 
-    // 指定したキーとこのSuffixが一致するかを確認する
-    bool isSame(const Key &key, size_t from) {
-        if (key.remainLength(from) != this->remainLength()) return false;
-        std::lock_guard<std::mutex> lock(suffixMutex);
-        for (size_t i = 0; i < slices.size(); i++) {
-            if (key.slices[i + from] != slices[i]) return false;
-        }
-        return true;
+    // 指定したキーのfrom番目以降のスライスとこのSuffixが一致するかを確認する
+    bool isSame(const Key &key, size_t from) const {
+        if (key.remainLength(from) != remainLength()) return false;
+        return std::memcmp(key.slices.data() + from, data(), num_slices_ * sizeof(uint64_t)) == 0;
     }
 
-    // 指定したキーと開始位置から新しいBigSuffixを作成
-    static BigSuffix *from(const Key &key, size_t from) {
-        std::vector<uint64_t> temp{};
-        for(size_t i = from; i < key.slices.size(); i++) {
-            temp.push_back(key.slices[i]);
-        }
-        return new BigSuffix(std::move(temp), key.lastSliceSize);
+    // suffixのスライスをoutの末尾に追加して、最後のスライスのサイズを返す(scanで使う)
+    size_t appendTo(KeySlices &out) const {
+        for (size_t i = 0; i < num_slices_; i++) out.push_back(data()[i]);
+        return last_slice_size_;
     }
 
 private:
-    std::mutex suffixMutex{};
-    std::vector<uint64_t> slices = {};
-    const size_t lastSliceSize = 0;
+    uint32_t num_slices_;
+    uint8_t last_slice_size_;
+    uint8_t slab_class_;
+
+    BigSuffix(size_t num_slices, size_t lastSliceSize, uint8_t slab_class)
+        : num_slices_(static_cast<uint32_t>(num_slices)),
+          last_slice_size_(static_cast<uint8_t>(lastSliceSize)),
+          slab_class_(slab_class) {}
+
+    // スライスは未初期化のまま返すので、公開する前に書き込むこと
+    static BigSuffix *allocate(size_t num_slices, size_t lastSliceSize) {
+        assert(num_slices != 0 && 1 <= lastSliceSize && lastSliceSize <= 8);
+        const size_t block_size = sizeof(BigSuffix) + num_slices * sizeof(uint64_t);
+        uint8_t size_class = SlabAllocator::size_class(block_size);
+        void *block = (size_class == SlabAllocator::HEAP_CLASS)
+                    ? ::operator new(block_size)
+                    : SlabAllocator::instance().allocate(size_class);
+        return new (block) BigSuffix(num_slices, lastSliceSize, size_class);
+    }
+
+    // the slices follow the header
+    uint64_t *data() { return reinterpret_cast<uint64_t*>(this + 1); }
+    const uint64_t *data() const { return reinterpret_cast<const uint64_t*>(this + 1); }
 };
+static_assert(sizeof(BigSuffix) == 8, "the slices of a BigSuffix start right after its header");
 
 // KeySuffixはBorderNode内のすべてのkeyのSuffixへの参照を一元管理する
 // 各SuffixはBigSuffixオブジェクトへのポインタとして保持される
@@ -408,7 +462,7 @@ public:
     void delete_ptr(size_t i) {
         BigSuffix *ptr = get(i);
         assert(ptr != nullptr);
-        delete ptr;
+        BigSuffix::destroy(ptr);
         set(i, nullptr);
     }
     // すべてのSuffixを削除する
@@ -475,31 +529,34 @@ class BorderNode : public Node {
             SliceWithSize current = key.getCurrentSlice();
             Permutation permutation = getPermutation();
 
+            // permutationに含まれるスロットのうち、sliceが一致するもの(候補)をmaskで求める
+            uint32_t live_mask = 0;
+            for (size_t i = 0; i < permutation.getNumKeys(); i++) live_mask |= 1U << permutation(i);
+            uint32_t candidates = live_mask & masstree_simd::equal_mask(key_slice.data(), ORDER - 1, current.slice);
+
             if (!key.hasNext()) {   // 現在のkeyのスライスが最後の場合(current layerにValueがあるはず)
-                for (size_t i = 0; i < permutation.getNumKeys(); i++) {
-                    uint8_t trueIndex = permutation(i);
-                    if (getKeySlice(trueIndex) == current.slice && getKeyLen(trueIndex) == current.size) {
-                        return std::make_tuple(VALUE, getLV(trueIndex), trueIndex);
-                    }
+                // (slice, key_len)が一致するスロットは高々1つ
+                candidates &= masstree_simd::byte_equal_mask(key_len.data(), ORDER - 1, current.size);
+                if (candidates != 0) {
+                    uint8_t trueIndex = __builtin_ctz(candidates);
+                    return std::make_tuple(VALUE, getLV(trueIndex), trueIndex);
                 }
             } else {    // 次のスライスがある場合(current layerにはvalueがないので下位ノードを辿るためのLinkを探す)
-                for (size_t i = 0; i < permutation.getNumKeys(); i++) {
-                    uint8_t trueIndex = permutation(i);
-                    if (getKeySlice(trueIndex) == current.slice) {
-                        if (getKeyLen(trueIndex) == BorderNode::key_len_has_suffix) {
-                            // suffixの中を見る
-                            BigSuffix *suffix = getKeySuffixes().get(trueIndex);
-                            if (suffix != nullptr && suffix->isSame(key, key.cursor + 1)) {
-                                return std::make_tuple(VALUE, getLV(trueIndex), trueIndex);
-                            }
+                for (; candidates != 0; candidates &= candidates - 1) {
+                    uint8_t trueIndex = __builtin_ctz(candidates);
+                    if (getKeyLen(trueIndex) == BorderNode::key_len_has_suffix) {
+                        // suffixの中を見る
+                        BigSuffix *suffix = getKeySuffixes().get(trueIndex);
+                        if (suffix != nullptr && suffix->isSame(key, key.cursor + 1)) {
+                            return std::make_tuple(VALUE, getLV(trueIndex), trueIndex);
                         }
+                    }
 
-                        if (getKeyLen(trueIndex) == BorderNode::key_len_layer) {
-                            return std::make_tuple(LAYER, getLV(trueIndex), trueIndex);
-                        }
-                        if (getKeyLen(trueIndex) == BorderNode::key_len_unstable) {
-                            return std::make_tuple(UNSTABLE, LinkOrValue{}, 0);
-                        }
+                    if (getKeyLen(trueIndex) == BorderNode::key_len_layer) {
+                        return std::make_tuple(LAYER, getLV(trueIndex), trueIndex);
+                    }
+                    if (getKeyLen(trueIndex) == BorderNode::key_len_unstable) {
+                        return std::make_tuple(UNSTABLE, LinkOrValue{}, 0);
                     }
                 }
             }
@@ -690,9 +747,14 @@ class BorderNode : public Node {
 
 
     private:
+#ifdef MASSTREE_ALIGNED_NODE_LAYOUT
+        std::atomic<Permutation> permutation;                           // BorderNode内のキーの順序を管理するためのPermutationオブジェクト
+        std::array<std::atomic<uint8_t>, ORDER - 1> key_len = {};       // 各キーの長さを保持する配列、キーの長さは255まで
+#else
         std::array<std::atomic<uint8_t>, ORDER - 1> key_len = {};       // 各キーの長さを保持する配列、キーの長さは255まで
         // CHECK: permutation::sizeOne()をここで呼ぶことはできない(コピー代入をサポートしてないから)からborderNodeのコンストラクタでpermutationのコンストラクタを呼び出す
         std::atomic<Permutation> permutation;                           // BorderNode内のキーの順序を管理するためのPermutationオブジェクト
+#endif
         std::array<std::atomic<uint64_t>, ORDER - 1> key_slice = {};    // キーのスライスを保持する配列
         std::array<std::atomic<LinkOrValue>, ORDER - 1> lv = {};        // キーに関連付けられたLinkまたはValueを保持する配列
         std::atomic<BorderNode*> next{nullptr};                         // 隣接するBorderNodeへのリンク(next)
@@ -700,4 +762,8 @@ class BorderNode : public Node {
         KeySuffix key_suffixes = {};                                    // BorderNode内のすべてのキーのSuffixを一元管理するKeySuffixオブジェクト
 };
 
+// operator newのheapへのfallbackはalignmentを保証しないので、ノードは必ずslabから確保されるようにする (SlabAllocatorのblockは64byte境界)
+static_assert(sizeof(BorderNode) <= SLAB_MAX_BLOCK_SIZE && sizeof(InteriorNode) <= SLAB_MAX_BLOCK_SIZE,
+              "Masstree nodes must be served by the slab");
+
 std::pair<BorderNode*, Version> findBorder(Node *root, const Key &key);
\ No newline at end of file
@@ -1,13 +1,119 @@
 #pragma once
 
+#include <vector>
+#include <cstdint>
+
 #include "masstree_node.h"
 #include "../../cassa_common/status.h"
 
-void masstree_scan(Node* root,
-                   Status &scan_status,
-                   Key &current_key,
-                   Key &left_key,
+/**
+ * @class MasstreeIterator
+ * @brief Ordered iterator over the values of a Masstree (all layers), in both directions
+ *
+ * @note  Lower layers are not visited recursively: the iterator keeps an explicit stack with
+ *        one frame per layer. A frame holds a copy of the leaf (BorderNode) being visited,
+ *        taken under the leaf version and sorted by (slice, key length), and the position of
+ *        the last entry visited in the layer. When a leaf is split or removed concurrently,
+ *        only that layer is restarted: the leaf holding the position is searched again from
+ *        the layer root with findBorder(), and entries up to the position are skipped. An
+ *        entry is therefore never returned twice nor skipped, keys inserted concurrently may
+ *        or may not be returned.
+ *        The returned Value pointers follow the same rules as Masstree::get_value(), they stay
+ *        valid while the caller's epoch holds back the GarbageCollector.
+ *
+ * Usage:
+ *   MasstreeIterator itr = masstree.iterator();
+ *   for (itr.seek(left_key); itr.valid(); itr.next()) { ... itr.key(), itr.value() ... }
+ *   for (itr.seek_for_prev(right_key); itr.valid(); itr.prev()) { ... }
+ */
+class MasstreeIterator {
+    public:
+        explicit MasstreeIterator(Node *root) : root_(root) {}
+
+        // key以上(exclusiveならkeyより大きい)最初のエントリに移動する
+        void seek(const Key &key, bool exclusive = false);
+        // key以下(exclusiveならkeyより小さい)最後のエントリに移動する
+        void seek_for_prev(const Key &key, bool exclusive = false);
+        // 最初/最後のエントリに移動する
+        void seek_first();
+        void seek_last();
+
+        // 次/前のエントリに移動する (向きが変わる場合は現在のキーからseekし直す)
+        void next();
+        void prev();
+
+        // エントリを指しているか
+        bool valid() const { return value_ != nullptr; }
+        // 現在のエントリのキー (valid()の間のみ有効)
+        const Key &key() const { return key_; }
+        // 現在のエントリのValue (valid()の間のみ有効)
+        Value *value() const { return value_; }
+
+    private:
+        // レイヤー内の位置: slice, 同じslice内ではキーの長さ(1~8, suffixやlayerを持つものは9)の順
+        struct Position {
+            uint64_t slice;
+            uint8_t rank;
+
+            bool operator<(const Position &right) const {
+                return slice < right.slice || (slice == right.slice && rank < right.rank);
+            }
+            bool operator==(const Position &right) const {
+                return slice == right.slice && rank == right.rank;
+            }
+        };
+
+        // leafのコピーの1エントリ
+        struct Entry {
+            Position pos;
+            uint8_t key_len;
+            LinkOrValue lv;
+            BigSuffix *suffix;
+        };
+
+        // 1レイヤー分の走査状態
+        struct Frame {
+            Node *root;                             // レイヤーのroot
+            BorderNode *leaf;                       // 走査中のleaf (nullptrならboundからfindBorderする)
+            Entry entries[Node::ORDER - 1];         // leafのコピー (pos順)
+            size_t num_entries;
+            size_t index;                           // 次に見るentriesの位置 (reverseでは次に見る位置 + 1)
+            Position bound;                         // このレイヤーで最後に訪れた位置 (またはseekした位置)
+            bool has_bound;                         // falseならレイヤーの端から走査する
+            bool inclusive;                         // bound自体もまだ訪れていない
+            bool on_seek_path;                      // boundがseekしたキーのスライスである
+        };
+
+        Node *root_;
+        std::vector<Frame> stack_;  // stack_[i]はレイヤーiの状態
+        Key key_{std::vector<uint64_t>{0}, 1};
+        Value *value_ = nullptr;
+        bool reverse_ = false;
+
+        // seekしたキーと、最初のエントリを返すまでの絞り込み条件
+        Key target_{std::vector<uint64_t>{0}, 1};
+        bool target_exclusive_ = false;
+        bool filtering_ = false;
+
+        // findBorder()に渡すキー (findBorderは現在のスライスしか見ない)
+        Key probe_{std::vector<uint64_t>{0}, 8};
+
+        void start(const Key *key, bool exclusive, bool reverse);
+        void push_frame(Node *root, const Position *bound, bool on_seek_path);
+        Position target_position(size_t depth) const;
+        bool locate(Frame &frame);
+        bool load(Frame &frame);
+        bool advance_leaf(Frame &frame);
+        bool visible(const Frame &frame, const Position &pos) const;
+        void step();
+};
+
+// [left_key, right_key]の範囲のValueをキー順(reverseなら逆順)にresultへ格納する、limitが0でなければlimit件で打ち切る
+void masstree_scan(Node *root,
+                   const Key &left_key,
                    bool l_exclusive,
-                   Key &right_key,
+                   const Key &right_key,
                    bool r_exclusive,
-                   std::vector<std::pair<Key, Value*>> &result);
\ No newline at end of file
+                   std::vector<std::pair<Key, Value*>> &result,
+                   size_t limit,
+                   bool reverse);
@@ -0,0 +1,144 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+/*
+ * ノード内のkey sliceの比較をまとめて行い、結果をbit maskで返す
+ * 命令セットはコンパイル時に選択される (enclave/MakefileのMASSTREE_SIMD)
+ *   - AVX2   (-mavx2)   : 4スライスずつ比較
+ *   - SSE4.2 (-msse4.2) : 2スライスずつ比較
+ *   - それ以外          : スカラーのループ
+ * NOTE: SIMD版は配列を常に16要素分読む。ノードのスライス配列(15要素)の後ろには同じノードの別のメンバがあるので
+ *       範囲外アクセスにはならず、余分なlaneはmaskで落とす。読み込みはatomicではないが、
+ *       呼び出し側はノードのversionで結果を検証する(スカラー版と同じ楽観的な読み込み)。
+ *       intrinsicsのヘッダはenclaveのinclude pathにないので、GCCのvector extensionで書いている。
+ *       読み込みはaligned(8)のvector型で直接行う。__builtin_memcpyで読むとGCCが32byteの読み込みを
+ *       16byte x2に分割してstackを経由させ、store forwardingが失敗してAVX2版がスカラー版より遅くなる。
+ */
+namespace masstree_simd {
+
+// ノードのスライス配列を読む最大の要素数 (Node::ORDER)
+constexpr size_t LANES = 16;
+
+inline uint32_t lane_mask(size_t n) {
+    return (n >= 32) ? ~0U : ((1U << n) - 1);
+}
+
+#if defined(__AVX2__)
+
+typedef uint64_t u64x4 __attribute__((vector_size(32)));
+typedef uint64_t u64x4_unaligned __attribute__((vector_size(32), aligned(8), may_alias));
+typedef int64_t i64x4 __attribute__((vector_size(32)));
+typedef double f64x4 __attribute__((vector_size(32)));
+typedef uint8_t u8x16 __attribute__((vector_size(16)));
+typedef char i8x16 __attribute__((vector_size(16)));
+
+// 4 lanesの比較結果(全bit 1 / 0)を4bitのmaskにする
+inline uint32_t movemask(i64x4 cmp) {
+    return static_cast<uint32_t>(__builtin_ia32_movmskpd256(reinterpret_cast<f64x4>(cmp)));
+}
+
+inline u64x4 load4(const std::atomic<uint64_t> *slices, size_t offset) {
+    return *reinterpret_cast<const u64x4_unaligned*>(slices + offset);
+}
+
+// bit i: slices[i] == slice (i < n)
+inline uint32_t equal_mask(const std::atomic<uint64_t> *slices, size_t n, uint64_t slice) {
+    const u64x4 target = {slice, slice, slice, slice};
+    uint32_t mask = 0;
+    for (size_t i = 0; i < LANES; i += 4) mask |= movemask(load4(slices, i) == target) << i;
+    return mask & lane_mask(n);
+}
+
+// bit i: slices[i] <= slice (i < n)
+inline uint32_t less_equal_mask(const std::atomic<uint64_t> *slices, size_t n, uint64_t slice) {
+    const u64x4 target = {slice, slice, slice, slice};
+    uint32_t mask = 0;
+    for (size_t i = 0; i < LANES; i += 4) mask |= movemask(load4(slices, i) <= target) << i;
+    return mask & lane_mask(n);
+}
+
+#elif defined(__SSE4_2__)
+
+typedef uint64_t u64x2 __attribute__((vector_size(16)));
+typedef uint64_t u64x2_unaligned __attribute__((vector_size(16), aligned(8), may_alias));
+typedef int64_t i64x2 __attribute__((vector_size(16)));
+typedef double f64x2 __attribute__((vector_size(16)));
+typedef uint8_t u8x16 __attribute__((vector_size(16)));
+typedef char i8x16 __attribute__((vector_size(16)));
+
+// 2 lanesの比較結果(全bit 1 / 0)を2bitのmaskにする
+inline uint32_t movemask(i64x2 cmp) {
+    return static_cast<uint32_t>(__builtin_ia32_movmskpd(reinterpret_cast<f64x2>(cmp)));
+}
+
+inline u64x2 load2(const std::atomic<uint64_t> *slices, size_t offset) {
+    return *reinterpret_cast<const u64x2_unaligned*>(slices + offset);
+}
+
+// bit i: slices[i] == slice (i < n)
+inline uint32_t equal_mask(const std::atomic<uint64_t> *slices, size_t n, uint64_t slice) {
+    const u64x2 target = {slice, slice};
+    uint32_t mask = 0;
+    for (size_t i = 0; i < LANES; i += 2) mask |= movemask(load2(slices, i) == target) << i;
+    return mask & lane_mask(n);
+}
+
+// bit i: slices[i] <= slice (i < n)
+inline uint32_t less_equal_mask(const std::atomic<uint64_t> *slices, size_t n, uint64_t slice) {
+    const u64x2 target = {slice, slice};
+    uint32_t mask = 0;
+    for (size_t i = 0; i < LANES; i += 2) mask |= movemask(load2(slices, i) <= target) << i;
+    return mask & lane_mask(n);
+}
+
+#else
+
+// bit i: slices[i] == slice (i < n)
+inline uint32_t equal_mask(const std::atomic<uint64_t> *slices, size_t n, uint64_t slice) {
+    uint32_t mask = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (slices[i].load(std::memory_order_acquire) == slice) mask |= 1U << i;
+    }
+    return mask;
+}
+
+// bit i: slices[i] <= slice (i < n)
+inline uint32_t less_equal_mask(const std::atomic<uint64_t> *slices, size_t n, uint64_t slice) {
+    uint32_t mask = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (slices[i].load(std::memory_order_acquire) <= slice) mask |= 1U << i;
+    }
+    return mask;
+}
+
+#endif
+
+#if defined(__AVX2__) || defined(__SSE4_2__)
+
+// bit i: bytes[i] == byte (i < n)
+inline uint32_t byte_equal_mask(const std::atomic<uint8_t> *bytes, size_t n, uint8_t byte) {
+    u8x16 v;
+    __builtin_memcpy(&v, bytes, sizeof(v));
+    const u8x16 target = {byte, byte, byte, byte, byte, byte, byte, byte,
+                          byte, byte, byte, byte, byte, byte, byte, byte};
+    uint32_t mask = static_cast<uint32_t>(__builtin_ia32_pmovmskb128(reinterpret_cast<i8x16>(v == target)));
+    return mask & lane_mask(n);
+}
+
+#else
+
+// bit i: bytes[i] == byte (i < n)
+inline uint32_t byte_equal_mask(const std::atomic<uint8_t> *bytes, size_t n, uint8_t byte) {
+    uint32_t mask = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (bytes[i].load(std::memory_order_acquire) == byte) mask |= 1U << i;
+    }
+    return mask;
+}
+
+#endif
+
+} // namespace masstree_simd
@@ -1,5 +1,27 @@
 #include "include/masstree.h"
 
+/**
+ * @brief Rightmost border node of layer 0 this thread last inserted into.
+ *
+ * @note  Auto-increment or time-ordered keys always go to the rightmost border node, so
+ *        insert_internal() starts there instead of descending from the root. masstree_insert()
+ *        locks the node and checks that it is still the rightmost one and covers the key.
+ *        The node is only dereferenced while it cannot have been freed: it was alive at
+ *        GlobalEpoch epoch, so it is retired at that epoch or later, and reclaimableEpoch()
+ *        does not pass it before GlobalEpoch has moved on (the worker inserting holds its
+ *        ThLocalEpoch at most at the current epoch). GarbageCollector::run() frees everything
+ *        regardless of epochs, so the hint is dropped once it has been called.
+ *        Plain data so the enclave TLS needs no constructor.
+ */
+struct RightmostHint {
+    const Masstree *tree;
+    BorderNode *leaf;
+    uint64_t epoch;             // GlobalEpoch when leaf was recorded
+    uint64_t full_reclaims;     // GarbageCollector::full_reclaims() when leaf was recorded
+};
+
+static thread_local RightmostHint rightmost_hint = {};
+
 /**
  * @brief Insert a record into Masstree.
  * 
@@ -23,13 +45,46 @@
  *             WARN_ALREADY_EXISTS.
  */
 Status Masstree::insert_value(Key &key, Value *value, GarbageCollector &gc) {
+    Value *found = nullptr;
+    return insert_internal(key, value, gc, found);
+}
+
+/**
+ * @brief Insert a record unless the key already exists, in a single descent.
+ *
+ * @param key Key identifying the record to insert.
+ * @param value Value to insert.
+ * @param gc GarbageCollector object to manage the memory of deleted nodes.
+ *
+ * @return value if it was inserted, otherwise the Value already stored for the key
+ *         (value is then not linked into the tree and still belongs to the caller).
+ *
+ * @note Replaces the get_value() + insert_value() pair, which walked the tree twice
+ *       and could still lose the race between the two calls.
+ */
+Value *Masstree::insert_or_get(Key &key, Value *value, GarbageCollector &gc) {
+    Value *found = nullptr;
+    Status status = insert_internal(key, value, gc, found);
+    return (status == Status::OK) ? value : found;
+}
+
+// insert_value/insert_or_get の共通部分、keyが既に存在した場合はWARN_ALREADY_EXISTSを返す
+Status Masstree::insert_internal(Key &key, Value *value, GarbageCollector &gc, Value *&found) {
 RETRY:
     Node *old_root = root.load(std::memory_order_acquire);
-    std::pair<Status, Node*> resultPair = masstree_insert(old_root, key, value, gc);
+    // 前回と同じepochでなければ、hintのnodeは解放されている可能性があるので使わない
+    const uint64_t epoch = __atomic_load_n(&GlobalEpoch, __ATOMIC_ACQUIRE);
+    const uint64_t full_reclaims = GarbageCollector::full_reclaims();
+    BorderNode *hint = nullptr;
+    if (rightmost_hint.tree == this && rightmost_hint.epoch == epoch && rightmost_hint.full_reclaims == full_reclaims) {
+        hint = rightmost_hint.leaf;
+    }
+    std::pair<Status, Node*> resultPair = masstree_insert(old_root, key, value, gc, found, &hint);
+    rightmost_hint = RightmostHint{this, hint, epoch, full_reclaims};
     if (resultPair.first == Status::RETRY_FROM_UPPER_LAYER) goto RETRY;
+    key.reset();
     if (resultPair.first == Status::WARN_ALREADY_EXISTS) return resultPair.first;
     Node *new_root = resultPair.second;
-    key.reset();
     // old_rootがぬるぽならrootを作るけど他スレッドと争奪戦が起きるのでCASを使う
     if (old_root == nullptr) {
         bool CAS_success = root.compare_exchange_weak(old_root, new_root);
@@ -70,7 +125,8 @@ RETRY:
  * 
  * @note Initially, Silo marks the record as absent and, during the commit phase, 
  *       invokes `Masstree::remove_value` to delete the record from the tree.
- *       The GarbageCollector functionality is not yet implemented.
+ *       The removed Value itself is retired to gc by this call (freed once no reader
+ *       can still reach it), so the caller must not delete it.
  */
 
 Status Masstree::remove_value(Key &key, GarbageCollector &gc) {
@@ -121,16 +177,80 @@ Value *Masstree::get_value(Key &key) {
 }
 
 
-// Scan results will be stored in a vector of <Key, Value> pairs, provided as an argument.
+/**
+ * @brief Collect the values between left_key and right_key.
+ *
+ * @param result Filled with <Key, Value> pairs in key order (descending if reverse).
+ * @param limit Stop after this many pairs, 0 for no limit.
+ * @param reverse Scan from right_key down to left_key, so that limit keeps the largest keys.
+ * @return Status::OK, an empty tree yields no pairs.
+ */
 Status Masstree::scan(Key &left_key, bool l_exclusive,
                       Key &right_key, bool r_exclusive,
-                      std::vector<std::pair<Key, Value*>> &result) {
+                      std::vector<std::pair<Key, Value*>> &result,
+                      size_t limit, bool reverse) {
     Node *root_ = root.load(std::memory_order_acquire);
-    Key current_key = left_key;
-    Status scan_status = Status::OK;
-    masstree_scan(root_, scan_status, current_key, left_key, l_exclusive, right_key, r_exclusive, result);
+    masstree_scan(root_, left_key, l_exclusive, right_key, r_exclusive, result, limit, reverse);
     left_key.reset();
     right_key.reset();
 
-    return scan_status;
-}
\ No newline at end of file
+    return Status::OK;
+}
+
+/**
+ * @brief Create an iterator over the current tree.
+ * @note The iterator keeps the root of Layer0 at the time of the call,
+ *       create a new one if the tree was empty and has been inserted into since.
+ */
+MasstreeIterator Masstree::iterator() const {
+    return MasstreeIterator(root.load(std::memory_order_acquire));
+}
+
+/**
+ * @brief Build the whole tree at once from sorted records.
+ *
+ * @param records Keys in strictly ascending order (Key::operator<) with their Values.
+ *
+ * @return Status::OK if the tree was built,
+ *         Status::WARN_ALREADY_EXISTS if the tree is not empty or a key is not
+ *         greater than the previous one (nothing is inserted in that case).
+ *
+ * @details Border nodes are packed full and the interior nodes are stacked on top
+ *          of them bottom-up (see masstree_bulk_load.h), so no descent, lock or
+ *          split is done per key. Keys sharing an 8-byte slice with more than one
+ *          other key get their own layer, built the same way.
+ *
+ * @note No other thread may access the tree during bulk_load (recovery, initial load).
+ *       A packed border node splits on the next insert into it.
+ */
+Status Masstree::bulk_load(const std::vector<std::pair<Key, Value*>> &records) {
+    if (root.load(std::memory_order_acquire) != nullptr) return Status::WARN_ALREADY_EXISTS;
+    for (size_t i = 1; i < records.size(); i++) {
+        if (!(records[i - 1].first < records[i].first)) return Status::WARN_ALREADY_EXISTS;
+    }
+    if (records.empty()) return Status::OK;
+    root.store(masstree_bulk_load(records), std::memory_order_release);
+    return Status::OK;
+}
+
+/**
+ * @brief Carve the node pools ahead of time.
+ *
+ * @param border_nodes Free BorderNodes the pool should hold.
+ * @param interior_nodes Free InteriorNodes the pool should hold.
+ *
+ * @details Splits then take their nodes from pre-touched chunks instead of the
+ *          enclave heap. Nodes freed by the GarbageCollector go back to the pools.
+ */
+void Masstree::reserve_nodes(size_t border_nodes, size_t interior_nodes) {
+    SlabAllocator::instance().reserve(SlabAllocator::size_class(sizeof(BorderNode)), border_nodes);
+    SlabAllocator::instance().reserve(SlabAllocator::size_class(sizeof(InteriorNode)), interior_nodes);
+}
+
+SlabAllocator::Stats Masstree::border_node_pool_stats() {
+    return SlabAllocator::instance().stats(SlabAllocator::size_class(sizeof(BorderNode)));
+}
+
+SlabAllocator::Stats Masstree::interior_node_pool_stats() {
+    return SlabAllocator::instance().stats(SlabAllocator::size_class(sizeof(InteriorNode)));
+}
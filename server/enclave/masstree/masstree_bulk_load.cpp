@@ -0,0 +1,103 @@
+#include "include/masstree_bulk_load.h"
+
+// 子ノードの列の上にInteriorNodeを積んで、1つのrootにまとめる
+static Node *build_interior_levels(std::vector<Node*> &level, std::vector<uint64_t> &lows) {
+    assert(!level.empty() && level.size() == lows.size());
+    while (level.size() > 1) {
+        // 最後のノードだけが小さくならないように、子ノードを均等に配る
+        const size_t num_parents = (level.size() + Node::ORDER - 1) / Node::ORDER;
+        std::vector<Node*> parents;
+        std::vector<uint64_t> parent_lows;
+        parents.reserve(num_parents);
+        parent_lows.reserve(num_parents);
+
+        size_t pos = 0;
+        for (size_t p = 0; p < num_parents; p++) {
+            const size_t count = level.size() / num_parents + (p < level.size() % num_parents ? 1 : 0);
+            assert(2 <= count && count <= Node::ORDER);
+            InteriorNode *parent = new InteriorNode{};
+            parent->lock();     // setParentのassert用
+            for (size_t c = 0; c < count; c++) {
+                if (c != 0) parent->setKeySlice(c - 1, lows[pos + c]);
+                parent->setChild(c, level[pos + c]);
+                level[pos + c]->setParent(parent);
+            }
+            parent->setNumKeys(count - 1);
+            parent->unlock();
+            parents.push_back(parent);
+            parent_lows.push_back(lows[pos]);
+            pos += count;
+        }
+        level.swap(parents);
+        lows.swap(parent_lows);
+    }
+    return level.front();
+}
+
+Node *bulk_load_layer(const std::vector<std::pair<Key, Value*>> &records, size_t begin, size_t end, size_t depth) {
+    assert(begin < end);
+    std::vector<Node*> level;       // このレイヤーのBorderNode(左から順)
+    std::vector<uint64_t> lows;     // 各ノードの最小のslice
+    BorderNode *leaf = nullptr;
+    size_t num_keys = 0;
+
+    for (size_t i = begin; i < end;) {
+        // [i, j)が同じslice, そのうち[i, l)はこのレイヤーで終わるキー(key_lenの昇順), [l, j)は9byte以上残るキー
+        const uint64_t slice = records[i].first.slices[depth];
+        size_t j = i;
+        while (j < end && records[j].first.slices[depth] == slice) j++;
+        size_t l = i;
+        while (l < j && records[l].first.slices.size() == depth + 1) l++;
+        const size_t group_keys = (l - i) + (l < j ? 1 : 0);
+        assert(group_keys <= Node::ORDER - 1);
+
+        if (leaf == nullptr || num_keys + group_keys > Node::ORDER - 1) {
+            BorderNode *next = new BorderNode{};
+            if (leaf != nullptr) {
+                leaf->setPermutation(Permutation::fromSorted(num_keys));
+                leaf->setNext(next);
+                next->setPrev(leaf);
+            }
+            leaf = next;
+            num_keys = 0;
+            level.push_back(leaf);
+            lows.push_back(slice);
+        }
+
+        for (size_t k = i; k < l; k++) {
+            leaf->setKeyLen(num_keys, records[k].first.lastSliceSize);
+            leaf->setKeySlice(num_keys, slice);
+            leaf->setLV(num_keys, LinkOrValue(records[k].second));
+            num_keys++;
+        }
+        if (l + 1 == j) {
+            // 残りが1つだけならsuffixに入れる
+            leaf->setKeyLen(num_keys, BorderNode::key_len_has_suffix);
+            leaf->setKeySlice(num_keys, slice);
+            leaf->getKeySuffixes().set(num_keys, records[l].first, depth + 1);
+            leaf->setLV(num_keys, LinkOrValue(records[l].second));
+            num_keys++;
+        } else if (l < j) {
+            // 複数あるなら次のレイヤーを作る
+            Node *next_layer = bulk_load_layer(records, l, j, depth + 1);
+            leaf->lock();   // setUpperLayerのassert用
+            next_layer->setUpperLayer(leaf);
+            leaf->unlock();
+            leaf->setKeyLen(num_keys, BorderNode::key_len_layer);
+            leaf->setKeySlice(num_keys, slice);
+            leaf->setLV(num_keys, LinkOrValue(next_layer));
+            num_keys++;
+        }
+        i = j;
+    }
+    leaf->setPermutation(Permutation::fromSorted(num_keys));
+
+    Node *root = build_interior_levels(level, lows);
+    root->setIsRoot(true);
+    return root;
+}
+
+Node *masstree_bulk_load(const std::vector<std::pair<Key, Value*>> &records) {
+    assert(!records.empty());
+    return bulk_load_layer(records, 0, records.size(), 0);
+}
@@ -63,16 +63,16 @@ void handle_break_invariant(BorderNode *node, Key &key, size_t old_index, Garbag
         n1->setIsRoot(true);
         n1->setUpperLayer(node);
         Value *k2_value = node->getLV(old_index).value;
-        BigSuffix *k2_suffix_copy = new BigSuffix(*node->getKeySuffixes().get(old_index));
-        if (k2_suffix_copy->hasNext()) {                                // [3] 適切なkey sliceの下にk2をinsertする
+        BigSuffix *k2_suffix = node->getKeySuffixes().get(old_index);  // readerが読んでいる可能性があるので書き換えない
+        SliceWithSize k2_slice = k2_suffix->getCurrentSlice();
+        if (k2_suffix->hasNext()) {                                     // [3] 適切なkey sliceの下にk2をinsertする
             n1->setKeyLen(0, BorderNode::key_len_has_suffix);
-            n1->setKeySlice(0, k2_suffix_copy->getCurrentSlice().slice);
-            k2_suffix_copy->next();
-            n1->getKeySuffixes().set(0, k2_suffix_copy);
+            n1->setKeySlice(0, k2_slice.slice);
+            n1->getKeySuffixes().set(0, k2_suffix->withoutTop());
             n1->setLV(0, LinkOrValue(k2_value));
         } else {
-            n1->setKeyLen(0,k2_suffix_copy->getCurrentSlice().size);
-            n1->setKeySlice(0, k2_suffix_copy->getCurrentSlice().slice);
+            n1->setKeyLen(0, k2_slice.size);
+            n1->setKeySlice(0, k2_slice.slice);
             n1->setLV(0, LinkOrValue(k2_value));
         }
         /*
@@ -112,12 +112,12 @@ void insert_to_border(BorderNode *border, const Key &key, Value *value, GarbageC
     bool reuse = pair.second;
 
     if (reuse) {
-        // key_len = 0ではないスロット(すなわちremoved slot)を再利用するので、古いValueとSuffixが残っている可能性がある
+        // key_len = 0ではないスロット(すなわちremoved slot)を再利用するので、古いSuffixが残っている可能性がある
+        // (古いValueはremoveの時点でretire済み)
         // w-w conflitはlockで対処、readerはinsertingをtrueにしておけばretryするのでOKのはず
         border->setInserting(true);
         BigSuffix *suffix = border->getKeySuffixes().get(insertion_point_trueIndex);
         if (suffix != nullptr) gc.add(suffix);  // ぬるぽじゃないならgcに投げておく
-        gc.add(border->getLV(insertion_point_trueIndex).value);
     }
     border->getKeySuffixes().set(insertion_point_trueIndex, nullptr);   // suffixをclearしておく
 
@@ -160,14 +160,16 @@ void insert_to_border(BorderNode *border, const Key &key, Value *value, GarbageC
  * @param node1      挿入する新しい子ノード
  * @param node_index node1とsliceを挿入する位置
  * @param k_prime    分割後に上位ノードに引き上げるキー、関数内で更新される
+ * @param append     レイヤーの右端へのinsertによる分割か(parentにMASSTREE_APPEND_SPLIT_PERCENT%の子ノードを残す)
  */
-void split_keys_among(InteriorNode *parent, InteriorNode *parent1, uint64_t slice, Node *node1, size_t node_index, std::optional<uint64_t> &k_prime) {
+void split_keys_among(InteriorNode *parent, InteriorNode *parent1, uint64_t slice, Node *node1, size_t node_index, std::optional<uint64_t> &k_prime, bool append) {
     assert(!parent->isNotFull());
     assert(parent->isLocked());
     assert(parent->getSplitting());
     assert(parent1->isLocked());
     assert(parent1->getSplitting());
 
+    assert(!append || node_index == parent->getNumKeys());    // 右端への追加なら分割されるのは最後の子ノード
     uint64_t temp_key_slice[Node::ORDER] = {};
     Node *temp_child[Node::ORDER + 1] = {};
 
@@ -188,6 +190,11 @@ void split_keys_among(InteriorNode *parent, InteriorNode *parent1, uint64_t slic
     parent->resetChildren();
 
     size_t split = (Node::ORDER%2 == 0) ? Node::ORDER/2 : Node::ORDER/2 + 1;    // InteriorNodeはバランスの関係上ORDERの半分がsplit pointになる、関数で定義されていたけど参照しているのがここしかなかった
+    if (append) {
+        // 右端に子ノードが増え続ける場合、半分で分割すると左のノードは半分空いたままになるので、parentに多く残す
+        // (parent1には最低でもキー1つと子ノード2つを残す)
+        split = std::max(split, std::min<size_t>(Node::ORDER - 1, (Node::ORDER + 1) * MASSTREE_APPEND_SPLIT_PERCENT / 100));
+    }
     size_t i = 0, j = 0;
     for (i = 0; i < split - 1; i++) {
         parent->setChild(i, temp_child[i]);
@@ -227,7 +234,7 @@ void create_slice_table(BorderNode *const node, std::vector<std::pair<uint64_t,
 
 // BorderNodeにてSplitする位置を決める
 // CHECK: これの挙動がいまいちわかっていない
-size_t split_point(uint64_t new_slice, const std::vector<std::pair<uint64_t, size_t>> &table, const std::vector<uint64_t> &found) {
+size_t split_point(uint64_t new_slice, const std::vector<std::pair<uint64_t, size_t>> &table, const std::vector<uint64_t> &found, bool append) {
     uint64_t min_slice = *std::min_element(found.begin(), found.end());
     uint64_t max_slice = *std::max_element(found.begin(), found.end());
     if (new_slice < min_slice) {    // 最小より小さいならsplit pointは1
@@ -250,14 +257,33 @@ size_t split_point(uint64_t new_slice, const std::vector<std::pair<uint64_t, siz
         }
     } else {    // 最大よりデカいなら一番最後(15)
         assert(new_slice > max_slice);
+        if (append) {
+            // レイヤーの右端への追加なら、左にMASSTREE_APPEND_SPLIT_PERCENT%を残して、少し遅れて来るキーのための空きを右に作る
+            // 同じsliceのキーは分けられないので、目標以下で最も右のsliceの境目で分割する
+            const size_t target = Node::ORDER * MASSTREE_APPEND_SPLIT_PERCENT / 100;
+            for (size_t i = table.size(); i-- > 1;) {
+                if (table[i].second > target) continue;
+                if (table[i].second >= Node::ORDER / 2) return table[i].second;
+                break;
+            }
+        }
         return 15;
     }
     assert(false);
     return 0;
 }
 
+// nodeがレイヤーの右端のBorderNodeで、keyがnodeのどのキーよりも大きいか(連番のキーの追加)
+bool is_append_to_border(BorderNode *const node, const Key &key) {
+    assert(node->isLocked());
+    if (node->getNext() != nullptr) return false;
+    Permutation permutation = node->getPermutation();
+    if (permutation.getNumKeys() == 0) return false;
+    return node->getKeySlice(permutation(permutation.getNumKeys() - 1)) < key.getCurrentSlice().slice;
+}
+
 // BorderNodeのnodeを分割してnode1を作成する
-void split_keys_among(BorderNode *node, BorderNode *node1, const Key &key, Value *value) {
+void split_keys_among(BorderNode *node, BorderNode *node1, const Key &key, Value *value, bool append) {
     Permutation permutation = node->getPermutation();
     assert(permutation.isFull());
     assert(node->isLocked());
@@ -298,7 +324,7 @@ void split_keys_among(BorderNode *node, BorderNode *node1, const Key &key, Value
         if (key.hasNext()) {
             // キーが9byte以上の場合残りはSuffixに保存されるため、キースライスが全て使用されていてもノードを分割する必要がない -> splitは発生しない
             // CHECK: っていう話らしいんだけど、Suffixに保存されるからSplitされないっていうのはわかる、その処理はどこで書いているんだ？
-            temp_key_slice[insertion_index] = cursor.size;
+            temp_key_slice[insertion_index] = cursor.slice;
             temp_key_len[insertion_index] = BorderNode::key_len_has_suffix;
             temp_suffix[insertion_index] = BigSuffix::from(key, key.cursor + 1);
             temp_lv[insertion_index].value = value;
@@ -312,7 +338,7 @@ void split_keys_among(BorderNode *node, BorderNode *node1, const Key &key, Value
     std::vector<std::pair<uint64_t, size_t>> table{};
     std::vector<uint64_t> found{};
     create_slice_table(node, table, found);
-    size_t split = split_point(cursor.slice, table, found);
+    size_t split = split_point(cursor.slice, table, found, append);
     // nodeとnode1を初期化する
     node->resetKeyLen();
     node->resetKeySlice();
@@ -410,10 +436,12 @@ void insert_into_parent(InteriorNode *parent, Node *node1, uint64_t slice, size_
 
 Node *split(Node *node, const Key &key, Value *value) {
     assert(node->isLocked());
+    // 右端への追加による分割なら、祖先のInteriorNodeも右端で分割されるので同じように偏らせる
+    const bool append = is_append_to_border(reinterpret_cast<BorderNode *>(node), key);
     Node *node1 = new BorderNode{};
     node->setSplitting(true);
     node1->setVersion(node->getVersion());
-    split_keys_among(reinterpret_cast<BorderNode *>(node), reinterpret_cast<BorderNode *>(node1), key, value);  // nodeとnode1でsplitする
+    split_keys_among(reinterpret_cast<BorderNode *>(node), reinterpret_cast<BorderNode *>(node1), key, value, append);  // nodeとnode1でsplitする
     std::optional<uint64_t> pull_up = std::nullopt; // CHECK: 本当は使いたくないけどuint64_tでエラーを回収するの大変そうだからこっちにしておく  TODO: pairとかでoptionalを回避する
 ASCEND:
     // 親ノードが一杯かどうかを調べて、一杯ならsplitしてその親ノードに再帰的にアクセスしに行く
@@ -462,7 +490,7 @@ ASCEND:
         } else {
             up = reinterpret_cast<BorderNode *>(node1)->getKeySlice(0);
         }
-        split_keys_among(reinterpret_cast<InteriorNode *>(parent), reinterpret_cast<InteriorNode *>(parent1), up, node1, node_index, pull_up);
+        split_keys_among(reinterpret_cast<InteriorNode *>(parent), reinterpret_cast<InteriorNode *>(parent1), up, node1, node_index, pull_up, append);
         node1->unlock();
         // assert(node->getParent()->debug_contain_child(node));
         // assert(node1->getParent()->debug_contain_child(node1));
@@ -472,14 +500,40 @@ ASCEND:
     }
 }
 
-std::pair<Status, Node*> masstree_insert(Node *root, Key &key, Value *value, GarbageCollector &gc) {
+// lock済みのnodeが、keyの入るLayer0の右端のBorderNodeか(rightmost_hintの検証)
+bool rightmost_leaf_covers(BorderNode *const node, const Key &key) {
+    assert(node->isLocked());
+    assert(key.cursor == 0);
+    if (node->getDeleted() || node->getNext() != nullptr) return false;
+    // 右端のBorderNodeには、その最小のslice以上の全てのキーが入る
+    Permutation permutation = node->getPermutation();
+    return permutation.getNumKeys() != 0 && node->lowestKey() <= key.getCurrentSlice().slice;
+}
+
+std::pair<Status, Node*> masstree_insert(Node *root, Key &key, Value *value, GarbageCollector &gc, Value *&found,
+                                         BorderNode **rightmost_hint) {
     // Layer0がemptyの場合
     if (root == nullptr) return std::make_pair(Status::OK, start_new_tree(key, value));
+    BorderNode *node;
+    Version version;
+    if (rightmost_hint != nullptr && *rightmost_hint != nullptr) {
+        // 連番のキーは常に右端のBorderNodeに入るので、hintが使えればrootからの降下を省略する
+        node = *rightmost_hint;
+        node->lock();
+        if (rightmost_leaf_covers(node, key)) {
+            version = node->getVersion();
+            goto FORWARD;
+        }
+        node->unlock();
+        *rightmost_hint = nullptr;
+    }
 RETRY:
     // BorderNodeを探してロックする
-    std::pair<BorderNode *, Version> node_version = findBorder(root, key);
-    BorderNode *node = node_version.first;
-    Version version  = node_version.second;
+    {
+        std::pair<BorderNode *, Version> node_version = findBorder(root, key);
+        node    = node_version.first;
+        version = node_version.second;
+    }
     node->lock();   // お目当てのnodeを見つけたら即ロック
     // lockした上で最新のversionを取得する、findBorder→lockの間で更新されている可能性があるから
     version = node->getVersion();
@@ -501,7 +555,6 @@ FORWARD:
     std::tuple<SearchResult, LinkOrValue, size_t> result_lv_index = node->searchLinkOrValueWithIndex(key);
     SearchResult result = std::get<0>(result_lv_index);
     LinkOrValue lv      = std::get<1>(result_lv_index);
-    size_t index        = std::get<2>(result_lv_index);
 
     if (Version::splitHappened(version, node->getVersion())) {
         // findBorder -> lockの間に他スレッドによってsplit処理が起きた場合
@@ -528,33 +581,41 @@ FORWARD:
             Node *next_layer = node->getLV(old_index).next_layer;
             node->unlock();
             key.next();
-            std::pair<Status, Node *> pair = masstree_insert(next_layer, key, value, gc);
+            std::pair<Status, Node *> pair = masstree_insert(next_layer, key, value, gc, found, nullptr);
             if (pair.first == Status::RETRY_FROM_UPPER_LAYER) {
                 key.back();
                 goto RETRY;
             }
+            if (pair.first == Status::WARN_ALREADY_EXISTS) return std::make_pair(pair.first, root);
         } else {    // BorderNodeにinsertすると違反が発生しない場合
             if (permutation.isNotFull()) {
                 insert_to_border(node, key, value, gc);
+                // Layer0の右端のBorderNodeなら次のinsertのためにhintとして残す
+                if (rightmost_hint != nullptr && node->getNext() == nullptr) *rightmost_hint = node;
                 node->unlock();
             } else {    // permutationが一杯の状態
+                const bool rightmost = (node->getNext() == nullptr);
                 Node *may_new_root = split(node, key, value);
+                // 右端のBorderNodeが分割されたら、新しい右端(node1)をhintにする(使う時にlockして検証する)
+                if (rightmost_hint != nullptr && rightmost) *rightmost_hint = node->getNext();
                 if (may_new_root != nullptr) return std::make_pair(Status::OK, may_new_root);
             }
         }
     } else if (result == VALUE) {
-        // 本来ならここでValueを更新するが、Masstree_putはSiloのinsertでしか呼ばない
-        // そのため、更新処理ではなく、WARN_ALREADY_EXISTを返す
+        // keyが既に存在するので、既存のValueを返す
+        found = lv.value;
         node->unlock();
         return std::make_pair(Status::WARN_ALREADY_EXISTS, root);
     } else if (result == LAYER) {
         node->unlock();
         key.next();
-        std::pair<Status, Node*> pair = masstree_insert(lv.next_layer, key, value, gc);
+        std::pair<Status, Node*> pair = masstree_insert(lv.next_layer, key, value, gc, found, nullptr);
         if (pair.first == Status::RETRY_FROM_UPPER_LAYER) {
             key.back();
             goto RETRY;
         }
+        // 下位レイヤーにkeyが既に存在した場合 (このレイヤーのrootは変わっていない)
+        if (pair.first == Status::WARN_ALREADY_EXISTS) return std::make_pair(pair.first, root);
     } else {
         // result == UNSTABLE;  ここに来ることはないのでassert(false)で落としておく
         assert(false);
@@ -16,15 +16,17 @@ void handle_delete_layer_in_remove(BorderNode *borderNode, GarbageCollector &gc)
     assert(borderNode->isLocked());
 
     BigSuffix *upper_suffix;
+    BigSuffix *old_suffix = nullptr;
+    uint64_t slice = borderNode->getKeySlice(permutation(0));
     if (borderNode->getKeyLen(permutation(0)) == BorderNode::key_len_has_suffix) {
-        // borderNodeがsuffixを持っているのなら、そのままsuffixを再利用
-        BigSuffix *old_suffix = borderNode->getKeySuffixes().get(permutation(0));
-        old_suffix->insertTop(borderNode->getKeySlice(permutation(0))); // 1つ上のレイヤに行くのでsliceを回収しておく
-        upper_suffix = old_suffix;
+        // borderNodeがsuffixを持っているのなら、1つ上のレイヤに行くのでsliceを先頭に加えたsuffixを作る
+        // (BigSuffixはimmutableなので、古い方はreaderがいなくなってから回収する)
+        old_suffix = borderNode->getKeySuffixes().get(permutation(0));
+        upper_suffix = old_suffix->withTop(slice);
     } else {
         // この処理は単一キー(suffixなし)のBorderNode対する処理なので、key_len_layerにはなりえない(key_len_unstableも)
         assert(1 <= borderNode->getKeyLen(permutation(0)) && borderNode->getKeyLen(permutation(0)) <= 8);
-        upper_suffix = new BigSuffix({borderNode->getKeySlice(permutation(0))}, borderNode->getKeyLen(permutation(0)));
+        upper_suffix = BigSuffix::create(&slice, 1, borderNode->getKeyLen(permutation(0)));
     }
     // hand-over-handの要領で、下から上に処理を行う
     BorderNode *upper = borderNode->lockedUpperNode();
@@ -43,6 +45,7 @@ void handle_delete_layer_in_remove(BorderNode *borderNode, GarbageCollector &gc)
     borderNode->setLV(permutation(0), LinkOrValue{});   // NOTE: これ実体なのが気に食わないな
     borderNode->getKeySuffixes().set(permutation(0), nullptr);
     // GarbageCollectorに渡す
+    if (old_suffix != nullptr) gc.add(old_suffix);
     borderNode->setDeleted(true);
     gc.add(borderNode);
     // 処理が終わったので下からunlockする
@@ -50,6 +53,26 @@ void handle_delete_layer_in_remove(BorderNode *borderNode, GarbageCollector &gc)
     upper->unlock();
 }
 
+/**
+ * @brief removeで消去済みになったスロットに残っているBigSuffixをGCに渡す。
+ * @param borderNode 削除されるBorderNodeへのポインタ。
+ * @param gc ガベージコレクタへの参照。
+ * @note 消去済みスロットのValueはremoveの時点でretire済み(ポインタだけが残っている)なので、ここではクリアするだけ。
+ *       suffixは、スロットが再利用される(insert_to_border)かBorderNodeごと消える時に回収される。
+ */
+static void retire_removed_slots(BorderNode *borderNode, GarbageCollector &gc) {
+    assert(borderNode->isLocked());
+    for (size_t i = 0; i < Node::ORDER - 1; i++) {
+        if (!borderNode->isKeyRemoved(i)) continue;
+        BigSuffix *suffix = borderNode->getKeySuffixes().get(i);
+        if (suffix != nullptr) {
+            gc.add(suffix);
+            borderNode->getKeySuffixes().unreferenced(i);
+        }
+        borderNode->setLV(i, LinkOrValue{});
+    }
+}
+
 /**
  * @brief 指定されたBorderNodeを削除し、必要に応じてツリーを再構成する。
  * @param borderNode 削除するBorderNodeへのポインタ。
@@ -61,6 +84,7 @@ std::pair<RootChange, Node*> delete_borderNode_in_remove(BorderNode *borderNode,
     assert(borderNode->isLocked());
     Permutation permutation = borderNode->getPermutation();
     assert(permutation.getNumKeys() == 0);  // borderNodeの中身は既に消去済み
+    retire_removed_slots(borderNode, gc);
     if (borderNode->getIsRoot()) {  // Layer0のルートノードの場合
         assert(borderNode->getParent() == nullptr);
         assert(borderNode->getUpperLayer() == nullptr);
@@ -237,6 +261,9 @@ FORWARD:
         borderNode->markKeyRemoved(index);
         permutation.removeIndex(index);
         borderNode->setPermutation(permutation);
+        // Valueはここでretireする。古いpermutationを読んだreaderがまだ辿れるので、スロットのポインタは残しておく
+        // (readerのいるepochの間はgcが解放しない、スロットが再利用されるまでポインタは読まれない)
+        gc.add(lv.value);
         // [3]
         uint8_t currentNumKeys = permutation.getNumKeys();
         if (currentNumKeys == 0) {
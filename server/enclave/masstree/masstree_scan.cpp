@@ -1,83 +1,268 @@
 #include "include/masstree_scan.h"
 
-void masstree_scan(Node* root,
-                   Status &scan_status,
-                   Key &current_key,
-                   Key &left_key,
-                   bool l_exclusive,
-                   Key &right_key,
-                   bool r_exclusive,
-                   std::vector<std::pair<Key, Value*>> &result) {
+void MasstreeIterator::seek(const Key &key, bool exclusive) {
+    start(&key, exclusive, false);
+}
 
-    // RootがnullptrまたはステータスがOKでない場合は処理を中断
-    if (root == nullptr || scan_status != Status::OK) {
-        scan_status = Status::ERROR_CONCURRENT_WRITE_OR_DELETE;
-        return;
+void MasstreeIterator::seek_for_prev(const Key &key, bool exclusive) {
+    start(&key, exclusive, true);
+}
+
+void MasstreeIterator::seek_first() {
+    start(nullptr, false, false);
+}
+
+void MasstreeIterator::seek_last() {
+    start(nullptr, false, true);
+}
+
+void MasstreeIterator::next() {
+    assert(valid());
+    if (reverse_) {
+        start(&key_, true, false);  // 向きが変わったので現在のキーの次からseekし直す
+    } else {
+        step();
     }
+}
 
-    // Rootからleft_keyに関連するBorderNodeを探す
-    std::pair<BorderNode*, Version> node_version = findBorder(root, left_key);
-    BorderNode *border = node_version.first;
-    Version version = node_version.second;
-
-    // BorderNode内を走査し、指定された範囲の値を探索する
-    while (border != nullptr) {
-        Permutation perm = border->getPermutation();
-        for (size_t i = 0; i < perm.getNumKeys(); i++) {
-            uint8_t trueIndex = perm(i);
-
-            // 削除されたキーは無視する
-            if (border->isKeyRemoved(trueIndex)) continue;
-
-            // レイヤが変わるタイミングで不必要なデータが残っている可能性があるので、cursor以降のスライスを削除する
-            current_key.slices.resize(current_key.cursor + 1);
-
-            // 新しいスライスとキーの長さを取得
-            uint64_t new_slice = border->getKeySlice(trueIndex);
-            uint8_t key_len = border->getKeyLen(trueIndex);
-
-            // current_keyのカーソル位置に新しいスライスを設定し、lastSliceSizeを更新
-            current_key.slices[current_key.cursor] = new_slice;
-            if (key_len == BorderNode::key_len_has_suffix || key_len == BorderNode::key_len_layer) {
-                current_key.lastSliceSize = 8;
-            } else if (key_len < BorderNode::key_len_has_suffix) {
-                current_key.lastSliceSize = key_len;
-            }
+void MasstreeIterator::prev() {
+    assert(valid());
+    if (!reverse_) {
+        start(&key_, true, true);
+    } else {
+        step();
+    }
+}
 
-            // Suffixの処理
-            if (key_len == BorderNode::key_len_has_suffix) {
-                BigSuffix* suffix = border->getKeySuffixes().get(trueIndex);
-                if (suffix != nullptr) {
-                    size_t suffixIndex = 0;
-                    while (suffix->hasNext()) {
-                        current_key.slices.push_back(suffix->getCurrentSlice().slice);
-                        suffix->next();
-                        suffixIndex++;
-                    }
-                    // 最後のスライスを追加
-                    current_key.slices.push_back(suffix->getCurrentSlice().slice);
-                    current_key.lastSliceSize = suffix->getCurrentSlice().size;
-                }
+// keyがnullptrならレイヤー0の端から走査する
+void MasstreeIterator::start(const Key *key, bool exclusive, bool reverse) {
+    if (key != nullptr) {
+        target_ = *key;     // keyはkey_の場合もあるので先にコピーする
+        target_.reset();
+        target_exclusive_ = exclusive;
+    }
+    filtering_ = (key != nullptr);
+    reverse_ = reverse;
+    value_ = nullptr;
+    stack_.clear();
+    if (root_ == nullptr) return;   // Layer0がempty
+
+    if (key != nullptr) {
+        Position pos = target_position(0);
+        push_frame(root_, &pos, true);
+    } else {
+        push_frame(root_, nullptr, false);
+    }
+    step();
+}
+
+void MasstreeIterator::push_frame(Node *root, const Position *bound, bool on_seek_path) {
+    stack_.emplace_back();
+    Frame &frame = stack_.back();
+    frame.root = root;
+    frame.leaf = nullptr;
+    frame.num_entries = 0;
+    frame.index = 0;
+    frame.has_bound = (bound != nullptr);
+    if (bound != nullptr) frame.bound = *bound;
+    frame.inclusive = true;
+    frame.on_seek_path = on_seek_path;
+}
+
+// seekしたキーのレイヤーdepthでの位置
+MasstreeIterator::Position MasstreeIterator::target_position(size_t depth) const {
+    assert(depth < target_.slices.size());
+    Position pos;
+    pos.slice = target_.slices[depth];
+    pos.rank = (depth + 1 < target_.slices.size()) ? 9 : static_cast<uint8_t>(target_.lastSliceSize);
+    return pos;
+}
+
+bool MasstreeIterator::visible(const Frame &frame, const Position &pos) const {
+    if (!frame.has_bound) return true;
+    if (frame.inclusive && pos == frame.bound) return true;
+    return reverse_ ? (pos < frame.bound) : (frame.bound < pos);
+}
+
+/**
+ * @brief Find the leaf holding the bound of the frame (or the first/last leaf) and copy it
+ * @return false if the layer has become empty
+ */
+bool MasstreeIterator::locate(Frame &frame) {
+    uint64_t slice = frame.has_bound ? frame.bound.slice : (reverse_ ? UINT64_MAX : 0);
+    probe_.slices[0] = slice;
+    for (;;) {
+        std::pair<BorderNode*, Version> node_version = findBorder(frame.root, probe_);
+        BorderNode *leaf = node_version.first;
+        Version version = node_version.second;
+        if (version.deleted) {
+            if (version.is_root) return false;  // レイヤーがemptyにされた
+            continue;
+        }
+        // findBorderの後にsplitされていれば右に進む (masstree_get()と同じ)
+        BorderNode *next = leaf->getNext();
+        while (next != nullptr && slice >= next->lowestKey()) {
+            leaf = next;
+            next = leaf->getNext();
+        }
+        frame.leaf = leaf;
+        if (load(frame)) return true;
+    }
+}
+
+/**
+ * @brief Copy the entries of frame.leaf under its version
+ * @return false if the leaf has been removed
+ */
+bool MasstreeIterator::load(Frame &frame) {
+    BorderNode *leaf = frame.leaf;
+RETRY:
+    Version version = leaf->stableVersion();
+    if (version.deleted) return false;
+
+    Permutation permutation = leaf->getPermutation();
+    size_t n = 0;
+    for (size_t i = 0; i < permutation.getNumKeys(); i++) {
+        uint8_t trueIndex = permutation(i);
+        uint8_t key_len = leaf->getKeyLen(trueIndex);
+        if (key_len == BorderNode::key_len_unstable) goto RETRY;    // レイヤーの作成中
+        if (leaf->isKeyRemoved(trueIndex)) continue;
+        Entry &entry = frame.entries[n++];
+        entry.pos.slice = leaf->getKeySlice(trueIndex);
+        entry.pos.rank = (key_len <= 8) ? key_len : 9;
+        entry.key_len = key_len;
+        entry.lv = leaf->getLV(trueIndex);
+        entry.suffix = (key_len == BorderNode::key_len_has_suffix) ? leaf->getKeySuffixes().get(trueIndex) : nullptr;
+    }
+    // コピー中にinsertやsplitがあればやり直す
+    if ((leaf->getVersion() ^ version) > Version::has_locked) goto RETRY;
+
+    // permutationは同じsliceの中ではキーの長さ順になっていないので並べ直す
+    std::sort(frame.entries, frame.entries + n, [](const Entry &left, const Entry &right) {
+        return left.pos < right.pos;
+    });
+    frame.num_entries = n;
+    frame.index = reverse_ ? n : 0;
+    return true;
+}
+
+/**
+ * @brief Move the frame to the neighbouring leaf
+ * @return false if the frame has reached the end of the layer
+ */
+bool MasstreeIterator::advance_leaf(Frame &frame) {
+    BorderNode *leaf = frame.leaf;
+    if (leaf->stableVersion().deleted) return locate(frame);
+
+    if (!reverse_) {
+        BorderNode *next = leaf->getNext();
+        if (next == nullptr) return false;
+        frame.leaf = next;
+        if (!load(frame)) return locate(frame);
+    } else {
+        BorderNode *prev = leaf->getPrev();
+        if (prev == nullptr) return false;
+        frame.leaf = prev;
+        // prevがsplitされて間に新しいleafが入っていれば、boundから探し直す
+        if (!load(frame) || prev->getNext() != leaf) return locate(frame);
+    }
+    return true;
+}
+
+/**
+ * @brief Move to the next entry in the scan direction that holds a value
+ */
+void MasstreeIterator::step() {
+    value_ = nullptr;
+    while (!stack_.empty()) {
+        const size_t depth = stack_.size() - 1;
+        Frame &frame = stack_.back();
+        if (frame.leaf == nullptr && !locate(frame)) {
+            stack_.pop_back();
+            continue;
+        }
+
+        // leafのコピーの中でまだ訪れていないエントリを探す
+        const Entry *entry = nullptr;
+        if (!reverse_) {
+            while (entry == nullptr && frame.index < frame.num_entries) {
+                const Entry &e = frame.entries[frame.index++];
+                if (visible(frame, e.pos)) entry = &e;
+            }
+        } else {
+            while (entry == nullptr && frame.index > 0) {
+                const Entry &e = frame.entries[--frame.index];
+                if (visible(frame, e.pos)) entry = &e;
             }
+        }
+        if (entry == nullptr) {
+            if (!advance_leaf(frame)) stack_.pop_back();    // このレイヤーは終わり
+            continue;
+        }
 
-            // 範囲外のキーは無視する
-            if (current_key < left_key || (l_exclusive && current_key == left_key)) continue;
-            if (right_key < current_key || (r_exclusive && current_key == right_key)) return;
+        // seekしたキーのスライスを辿っている間は、下位レイヤーもseekしたキーの位置から始める
+        const bool seek_path = frame.on_seek_path && frame.inclusive && entry->pos == frame.bound;
+        frame.bound = entry->pos;
+        frame.has_bound = true;
+        frame.inclusive = false;
+        frame.on_seek_path = false;
 
-            LinkOrValue lv = border->getLV(trueIndex);
+        key_.slices.resize(depth + 1);
+        key_.slices[depth] = entry->pos.slice;
 
-            if (lv.value) {
-                // Valueを見つけた場合はresultに追加
-                result.emplace_back(current_key, lv.value);
-            } else if (lv.next_layer) {
-                // Linkを見つけた場合は再帰的に探索
-                current_key.next(); // レイヤを降下するためカーソルを進める
-                masstree_scan(lv.next_layer, scan_status, current_key, left_key, l_exclusive, right_key, r_exclusive, result);
-                current_key.back(); // DFSから戻ってきたのでカーソルを戻す
+        if (entry->key_len == BorderNode::key_len_layer) {
+            Node *next_layer = entry->lv.next_layer;
+            if (next_layer == nullptr) continue;
+            // push_frame()でframeとentryは無効になる
+            if (seek_path) {
+                Position pos = target_position(depth + 1);
+                push_frame(next_layer, &pos, true);
+            } else {
+                push_frame(next_layer, nullptr, false);
             }
+            continue;
         }
 
-        // 次のBorderNodeへ移動
-        border = border->getNext();
+        if (entry->lv.value == nullptr) continue;
+        if (entry->key_len == BorderNode::key_len_has_suffix) {
+            if (entry->suffix == nullptr) continue;
+            key_.lastSliceSize = entry->suffix->appendTo(key_.slices);
+        } else {
+            key_.lastSliceSize = entry->key_len;
+        }
+
+        // suffixを持つキーはseekしたキーとの大小がキー全体を見るまでわからない
+        if (filtering_) {
+            bool before = reverse_ ? (target_ < key_) : (key_ < target_);
+            if (before || (target_exclusive_ && key_ == target_)) continue;
+            filtering_ = false;
+        }
+        value_ = entry->lv.value;
+        return;
+    }
+}
+
+void masstree_scan(Node *root,
+                   const Key &left_key,
+                   bool l_exclusive,
+                   const Key &right_key,
+                   bool r_exclusive,
+                   std::vector<std::pair<Key, Value*>> &result,
+                   size_t limit,
+                   bool reverse) {
+    MasstreeIterator itr(root);
+    if (!reverse) {
+        itr.seek(left_key, l_exclusive);
+    } else {
+        itr.seek_for_prev(right_key, r_exclusive);
+    }
+
+    for (; itr.valid(); reverse ? itr.prev() : itr.next()) {
+        if (limit != 0 && result.size() >= limit) break;
+        const Key &key = itr.key();
+        // 範囲の反対側の端を越えたら終わり
+        if (!reverse && (right_key < key || (r_exclusive && key == right_key))) break;
+        if (reverse && (key < left_key || (l_exclusive && key == left_key))) break;
+        result.emplace_back(key, itr.value());
     }
-}
\ No newline at end of file
+}
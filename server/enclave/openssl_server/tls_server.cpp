@@ -39,6 +39,7 @@
 #include "../../../common/log_macros.h"
 
 #include "../cassa_server.h"
+#include "../cassa_common/consts.h"
 
 int verify_callback(int preverify_ok, X509_STORE_CTX* ctx);
 
@@ -85,16 +86,32 @@ exit:
     return ret;
 }
 
-SSL *accept_client_connection(int server_socket_fd, SSL_CTX* ssl_server_ctx) {
+/**
+ * @brief Accept a client connection and complete the TLS handshake.
+ * @param server_socket_fd non-blocking listener socket
+ * @param listener_epoll_fd readiness wait instance to which server_socket_fd is registered
+ * @param ssl_server_ctx SSL context of the server
+ * @return SSL session of the accepted client, or nullptr on failure
+ * @note While no connection is pending, the thread sleeps in the host (epoll_wait)
+ *       instead of spinning on accept().
+*/
+SSL *accept_client_connection(int server_socket_fd, int listener_epoll_fd, SSL_CTX* ssl_server_ctx) {
     int ret = -1; // dummy variable for ocall_close()
     struct sockaddr_in addr;
     uint len = sizeof(addr);
     int client_socket_fd;
+    int ready_fd;
 
     t_print(LOG_INFO "Waiting for client connection ...\n");
     while (true) {
         client_socket_fd = accept(server_socket_fd, (struct sockaddr*)&addr, &len);
         if (client_socket_fd >= 0) break;
+
+        // no pending connection, wait until the listener becomes readable
+        if (epoll_wait_ready_fds(listener_epoll_fd, &ready_fd, 1, ACCEPTOR_WAIT_TIMEOUT_MS) < 0) {
+            t_print(LOG_ERROR "Failed to wait for client connection\n");
+            return nullptr;
+        }
     }
 
     // create a new SSL structure for a connection
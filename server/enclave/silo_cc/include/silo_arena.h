@@ -0,0 +1,98 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <cassert>
+#include <string_view>
+
+#include "../../cassa_common/consts.h"
+
+/**
+ * @class TransactionArena
+ * @brief Worker-local bump allocator for the data staged by a transaction
+ *
+ * @note  TxExecutor::begin() rewinds the arena, everything allocated during the
+ *        previous transaction is released at once. The chunks themselves are kept,
+ *        so once the arena has grown to the size of the typical transaction the hot
+ *        path never calls the enclave heap allocator. If a large transaction made the
+ *        arena grow beyond TX_ARENA_MAX_RETAINED_SIZE, the extra chunks are given back
+ *        on the next reset() (the enclave heap is small).
+ *        Not thread-safe, owned by one worker.
+ */
+class TransactionArena {
+public:
+    TransactionArena() = default;
+    TransactionArena(const TransactionArena&) = delete;
+    TransactionArena& operator=(const TransactionArena&) = delete;
+
+    ~TransactionArena() {
+        for (Chunk &chunk : chunks_) delete[] chunk.data;
+    }
+
+    /**
+     * @brief Allocate size bytes aligned to align (power of two), valid until reset()
+     */
+    void *allocate(size_t size, size_t align = alignof(std::max_align_t)) {
+        assert((align & (align - 1)) == 0);
+        while (current_ < chunks_.size()) {
+            Chunk &chunk = chunks_[current_];
+            uintptr_t base = reinterpret_cast<uintptr_t>(chunk.data);
+            size_t offset = ((base + used_ + align - 1) & ~(uintptr_t)(align - 1)) - base;
+            if (offset + size <= chunk.size) {
+                used_ = offset + size;
+                return chunk.data + offset;
+            }
+            // the rest of this chunk is wasted until the next reset()
+            current_++;
+            used_ = 0;
+        }
+
+        // no retained chunk is large enough
+        size_t chunk_size = TX_ARENA_CHUNK_SIZE;
+        while (chunk_size < size + align) chunk_size *= 2;
+        chunks_.push_back(Chunk{new char[chunk_size], chunk_size});
+        retained_size_ += chunk_size;
+        current_ = chunks_.size() - 1;
+        used_ = 0;
+        return allocate(size, align);
+    }
+
+    /**
+     * @brief Copy bytes (e.g. a value taken from the request) into the arena
+     * @return View of the copy, valid until reset()
+     */
+    std::string_view copy(std::string_view bytes) {
+        if (bytes.empty()) return std::string_view();
+        char *dst = static_cast<char*>(allocate(bytes.size(), 1));
+        std::memcpy(dst, bytes.data(), bytes.size());
+        return std::string_view(dst, bytes.size());
+    }
+
+    /**
+     * @brief Release everything allocated since the last reset()
+     */
+    void reset() {
+        if (retained_size_ > TX_ARENA_MAX_RETAINED_SIZE) {
+            while (chunks_.size() > 1) {
+                retained_size_ -= chunks_.back().size;
+                delete[] chunks_.back().data;
+                chunks_.pop_back();
+            }
+        }
+        current_ = 0;
+        used_ = 0;
+    }
+
+private:
+    struct Chunk {
+        char *data;
+        size_t size;
+    };
+
+    std::vector<Chunk> chunks_;
+    size_t current_ = 0;        // chunk being filled
+    size_t used_ = 0;           // bytes used in chunks_[current_]
+    size_t retained_size_ = 0;  // total size of chunks_
+};
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <cstdint>
+#include <algorithm>
+
+#include "silo_tsc.h"
+#include "../../cassa_common/consts.h"
+#include "../../cassa_common/random.h"
+#include "../../../../common/transaction_routing.h"
+
+/**
+ * @struct ContentionPolicy
+ * @brief How a worker reacts to conflicting transactions
+ *
+ * @note  lock_wait_spins bounds how long lockWriteSet() waits for a record locked by
+ *        another transaction (0 = no-wait, abort at once). write_set_ is sorted before it
+ *        is locked, so every worker takes its locks in the same order and waiting on a
+ *        lock cannot deadlock; the bound only keeps a worker from waiting behind a long
+ *        commit. backoff_base_us and backoff_max_us configure AbortBackoff
+ *        (backoff_base_us = 0 retries an aborted transaction immediately).
+ *        The policy of the workers is selected on the host (-contention:<mode>, fromMode()).
+ */
+struct ContentionPolicy {
+    uint32_t lock_wait_spins = LOCK_WAIT_SPIN_COUNT;
+    uint32_t backoff_base_us = ABORT_BACKOFF_BASE_US;
+    uint32_t backoff_max_us = ABORT_BACKOFF_MAX_US;
+
+    // ContentionModeに対応するpolicy (待つ場合/backoffする場合の値はconsts.hのもの)
+    static ContentionPolicy fromMode(ContentionMode mode) {
+        ContentionPolicy policy;
+        if (mode == CONTENTION_BACKOFF || mode == CONTENTION_NO_WAIT) policy.lock_wait_spins = 0;
+        if (mode == CONTENTION_WAIT || mode == CONTENTION_NO_WAIT) policy.backoff_base_us = 0;
+        return policy;
+    }
+};
+
+/**
+ * @class AbortBackoff
+ * @brief Randomized exponential backoff between the retries of an aborted transaction
+ *
+ * @note  The n-th consecutive abort of a transaction waits a uniformly random time in
+ *        [0, min(backoff_max_us, backoff_base_us * 2^(n-1))] before the retry, so workers
+ *        that abort each other on a hot key do not retry in lockstep. reset() before
+ *        executing the next transaction. Owned by one worker.
+ */
+class AbortBackoff {
+    public:
+        explicit AbortBackoff(const ContentionPolicy &policy) : policy_(policy) {}
+
+        // 連続したabortの回数に応じて待つ
+        void wait() {
+            if (policy_.backoff_base_us == 0) return;
+            const uint64_t limit_us = std::min<uint64_t>(policy_.backoff_max_us,
+                                                         static_cast<uint64_t>(policy_.backoff_base_us) << std::min<uint32_t>(aborts_, 20));
+            aborts_++;
+            const uint64_t wait_clocks = (rng_.next() % (limit_us + 1)) * CLOCKS_PER_US;
+            const uint64_t start = rdtscp();
+            while (rdtscp() - start < wait_clocks) {
+                __builtin_ia32_pause();
+            }
+        }
+
+        // 次のトランザクションのために連続abort回数を戻す
+        void reset() { aborts_ = 0; }
+
+    private:
+        const ContentionPolicy &policy_;
+        uint32_t aborts_ = 0;
+        Xoroshiro128Plus rng_;
+};
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <string_view>
+
 #include "../../cassa_common/db_key.h"
 #include "../../cassa_common/db_value.h"
 #include "../../cassa_common/structures.h"
@@ -34,15 +36,25 @@ private:
     TIDword tidword_;
 };
 
+/**
+ * @brief Write of a transaction, the new value is staged in the TransactionArena of the executor
+ * @note Move-only, the staged value is never copied until it is logged and installed.
+ */
 class WriteElement : public OpElement {
 public:
     using OpElement::OpElement;
 
     WriteElement(const Key &key, Value *value, 
-                 std::string new_value_body, OpType op)
+                 std::string_view new_value_body, OpType op)
         : OpElement(key, value, op), new_value_body_(new_value_body) {}
 
-    std::string get_new_value_body() const {
+    WriteElement(const WriteElement &) = delete;
+    WriteElement &operator=(const WriteElement &) = delete;
+    WriteElement(WriteElement &&) noexcept = default;
+    WriteElement &operator=(WriteElement &&) noexcept = default;
+
+    // valid until the next TxExecutor::begin()
+    std::string_view get_new_value_body() const {
         return new_value_body_;
     }
 
@@ -51,5 +63,5 @@ public:
     }
 
 private:
-    std::string new_value_body_;
+    std::string_view new_value_body_;
 };
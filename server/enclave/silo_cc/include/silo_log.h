@@ -3,6 +3,7 @@
 #include <vector>
 #include <cstdint>
 #include <string>
+#include <string_view>
 
 class LogHeader {
 public:
@@ -27,9 +28,9 @@ public:
 
     // コンストラクタ
     LogRecord(uint64_t tid, OpType op_type, 
-              const std::string &key, const std::string &value)
+              std::string key, std::string_view value)
         : tid_(tid), op_type_(op_type), 
-          key_(key), value_(value) {}
+          key_(std::move(key)), value_(value) {}
 };
 
 class LogPackage {
@@ -9,6 +9,7 @@
 #include <openssl/sha.h>    // For SHA-256 specific constants like SHA256_DIGEST_LENGTH
 
 #include "../../cassa_common/consts.h"
+#include "../../cassa_common/idle_strategy.hpp"
 
 #include "silo_element.h"
 #include "silo_log_queue.h"
@@ -72,6 +73,7 @@ public:
     LogBufferPool();
     
     bool is_ready();
+    void wait_ready();
     void push(std::uint64_t tid, NotificationId &nid, std::vector<WriteElement> &write_set, bool new_epoch_begins);
     void publish();
     void return_buffer(LogBuffer *lb);
@@ -79,6 +81,7 @@ public:
 
 private:
     std::atomic<unsigned int> my_mutex_;
+    ParkingSpot spot_;  // the worker sleeps here while every buffer is held by the logger
 
     void my_lock();
     void my_unlock();
@@ -4,6 +4,7 @@
 #include <map>
 
 #include "../../cassa_common/consts.h"
+#include "../../cassa_common/idle_strategy.hpp"
 #include "silo_util.h"
 #include "silo_log_buffer.h"
 
@@ -21,7 +22,7 @@ public:
     void terminate();
 
 private:
-    std::atomic<bool> data_added_; // condition_variableの代用
+    ParkingSpot spot_;  // condition_variableの代用, the logger sleeps here until enq() or terminate()
     std::mutex mutex_;
     std::map<uint64_t, std::vector<LogBuffer*>> queue_; // epoch : [log_buffer1, log_buffer2, ...]
     std::size_t capacity_ = 1000;
@@ -5,10 +5,13 @@
 #include <string>
 #include <mutex>
 #include <unordered_set>
+#include <unordered_map>
 #include <condition_variable>
 
 #include "silo_tsc.h"
 #include "../../cassa_common/db_tid.h"
+#include "../../cassa_common/structures.h"
+#include "../../../../common/binary_protocol.hpp"  // for WireFormat
 
 #include <openssl/ssl.h>
 
@@ -25,8 +28,8 @@ private:
 class NotificationId {
 public:
     // session info
-    std::string session_id_;
-    uint64_t session_tx_id_;    // in-session transaction ID
+    SessionHandle session_handle_;
+    uint64_t session_tx_id_;    // in-session transaction ID (sequence number sent by the client, echoed in the response)
 
     // TID used for comparing with DurableEpoch
     uint64_t tid_;
@@ -39,9 +42,9 @@ public:
     uint64_t tx_logging_time_ = 0;  // transaction logging time
     uint64_t tx_commit_time_ = 0;   // transaction commit time
 
-    NotificationId(std::string session_id, uint64_t session_tx_id, uint64_t tx_start_time)
-        : session_id_(session_id), session_tx_id_(session_tx_id), tx_start_time_(tx_start_time) {}
-    NotificationId() { NotificationId("", 0, 0); }
+    NotificationId(SessionHandle session_handle, uint64_t session_tx_id, uint64_t tx_start_time)
+        : session_handle_(session_handle), session_tx_id_(session_tx_id), tx_start_time_(tx_start_time) {}
+    NotificationId() : NotificationId(INVALID_SESSION_HANDLE, 0, 0) {}
 
     // NOTE: NotificationIdのtidはLogBufferPool::push()のタイミングで書き込まれる
     uint64_t epoch() {
@@ -62,6 +65,15 @@ public:
     NidBufferItem(uint64_t epoch) : epoch_(epoch) { buffer_.reserve(512); } // TODO: ここメモリ領域確保しすぎて爆発していたけど、なんでreserveしているんだっけ？
 };
 
+/**
+ * @brief Notifications of one session released by NidBuffer::notify()
+*/
+struct SessionBatch {
+    WireFormat wire_format = WireFormat::JSON;
+    std::string framed_messages;    // messages framed by append_framed_message()
+    size_t num_messages = 0;
+};
+
 // TODO:コピペだから理解する、というか要らないかも
 class NidBuffer {
 public:
@@ -91,6 +103,7 @@ private:
     size_t size_ = 0;
     uint64_t max_epoch_ = 0;
     std::mutex mutex_;
+    std::unordered_map<SessionHandle, SessionBatch> batches_;  // per-session notifications of notify()
 };
 
 class Notifier {
@@ -0,0 +1,137 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <limits>
+
+#include "../../cassa_common/consts.h"
+#include "../../cassa_common/db_key.h"
+
+/**
+ * @brief Hash of a key for OpSetIndex
+ * @note Equal keys (Key::operator==) always have the same hash, the cursor is not part of it.
+ */
+inline uint64_t op_set_key_hash(const Key &key) {
+    uint64_t h = key.lastSliceSize;
+    for (uint64_t slice : key.slices) {
+        h = (h ^ slice) * 0x9e3779b97f4a7c15ULL;
+        h ^= h >> 32;
+    }
+    // fmix64 (MurmurHash3)
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+/**
+ * @class OpSetIndex
+ * @brief Hash index over a read/write set of TxExecutor
+ *
+ * @note  Sets smaller than OP_SET_INDEX_THRESHOLD are searched linearly, which is the
+ *        fastest for the usual short transactions. Once a set reaches the threshold the
+ *        index is built, and from then on every element appended to the set must be
+ *        registered with add(). Slots hold the position of the element in the set
+ *        (so the set may reallocate) and its key hash, linear probing, load factor <= 1/2.
+ *        Like the linear search, find() returns the first element with the key if the
+ *        set holds duplicates. Reordering the set (e.g. sorting) requires rebuild().
+ */
+template <class Element>
+class OpSetIndex {
+public:
+    /**
+     * @brief Find the first element of the set with the key
+     * @return Pointer into the set, nullptr if not found
+     */
+    Element *find(std::vector<Element> &set, const Key &key) const {
+        if (slots_.empty()) {
+            for (auto &element : set) {
+                if (element.key_ == key) return &element;
+            }
+            return nullptr;
+        }
+
+        const uint64_t hash = op_set_key_hash(key);
+        for (size_t i = hash & mask_; slots_[i].pos != EMPTY_SLOT; i = (i + 1) & mask_) {
+            if (slots_[i].hash == hash && set[slots_[i].pos].key_ == key) return &set[slots_[i].pos];
+        }
+        return nullptr;
+    }
+
+    /**
+     * @brief Register the element just appended to the set (set.back())
+     */
+    void add(const std::vector<Element> &set) {
+        if (slots_.empty()) {
+            if (set.size() >= OP_SET_INDEX_THRESHOLD) rebuild(set);
+            return;
+        }
+        if ((num_indexed_ + 1) * 2 > slots_.size()) grow();
+        insert(op_set_key_hash(set.back().key_), static_cast<uint32_t>(set.size() - 1), set);
+    }
+
+    /**
+     * @brief Index every element of the set again (after the set has been reordered)
+     * @note Does nothing while the set is below the threshold.
+     */
+    void rebuild(const std::vector<Element> &set) {
+        slots_.clear();
+        num_indexed_ = 0;
+        if (set.size() < OP_SET_INDEX_THRESHOLD) return;
+
+        size_t capacity = 1;
+        while (capacity < set.size() * 4) capacity <<= 1;
+        slots_.assign(capacity, Slot());
+        mask_ = capacity - 1;
+        for (size_t pos = 0; pos < set.size(); pos++) {
+            insert(op_set_key_hash(set[pos].key_), static_cast<uint32_t>(pos), set);
+        }
+    }
+
+    /**
+     * @brief Forget the index, call together with set.clear()
+     */
+    void clear() {
+        slots_.clear();
+        num_indexed_ = 0;
+    }
+
+private:
+    static constexpr uint32_t EMPTY_SLOT = std::numeric_limits<uint32_t>::max();
+
+    struct Slot {
+        uint64_t hash = 0;
+        uint32_t pos = EMPTY_SLOT;  // position in the set
+    };
+
+    std::vector<Slot> slots_;   // empty while the set is searched linearly
+    size_t mask_ = 0;
+    size_t num_indexed_ = 0;
+
+    void insert(uint64_t hash, uint32_t pos, const std::vector<Element> &set) {
+        size_t i = hash & mask_;
+        for (; slots_[i].pos != EMPTY_SLOT; i = (i + 1) & mask_) {
+            // keep the first element with the key, as the linear search would find it
+            if (slots_[i].hash == hash && set[slots_[i].pos].key_ == set[pos].key_) return;
+        }
+        slots_[i].hash = hash;
+        slots_[i].pos = pos;
+        num_indexed_++;
+    }
+
+    // double the table, the cached hashes avoid rehashing the keys
+    void grow() {
+        std::vector<Slot> old_slots;
+        old_slots.swap(slots_);
+        slots_.assign(old_slots.size() * 2, Slot());
+        mask_ = slots_.size() - 1;
+        for (const Slot &slot : old_slots) {
+            if (slot.pos == EMPTY_SLOT) continue;
+            size_t i = slot.hash & mask_;
+            while (slots_[i].pos != EMPTY_SLOT) i = (i + 1) & mask_;
+            slots_[i] = slot;
+        }
+    }
+};
@@ -1,31 +1,43 @@
 #pragma once
 
+#include <string_view>
+
 #include "../../cassa_common/db_key.h"
 #include "../../cassa_common/db_value.h"
 #include "../../cassa_common/structures.h"
 
+/**
+ * @note Keys and values are views into the received request buffer
+ *       (TransactionRequest::payload_), which outlives the transaction.
+ *       Copy them into std::string before storing them anywhere else.
+*/
 class Procedure {
 public:
     OpType ope_;
-    std::string key_;   // Key for WRITE, READ, DELETE, INSERT
-    std::string value_; // Value for WRITE, INSERT
+    std::string_view key_;   // Key for WRITE, READ, DELETE, INSERT
+    std::string_view value_; // Value for WRITE, INSERT
 
     // for SCAN
-    std::string left_key_;
-    std::string right_key_;
+    std::string_view left_key_;
+    std::string_view right_key_;
     bool l_exclusive_;
     bool r_exclusive_;
+    uint32_t limit_;    // maximum number of rows, 0 for no limit
+    bool reverse_;      // descending order (from right_key)
 
     // Default constructor
-    Procedure(OpType ope, std::string key, std::string value)
-        : ope_(ope), key_(key), value_(value), l_exclusive_(false), r_exclusive_(false) {}
+    Procedure(OpType ope, std::string_view key, std::string_view value)
+        : ope_(ope), key_(key), value_(value), l_exclusive_(false), r_exclusive_(false),
+          limit_(0), reverse_(false) {}
 
     // SCAN constructor
     Procedure(OpType ope,
-              std::string left_key, bool l_exclusive,
-              std::string right_key, bool r_exclusive)
-        : ope_(ope), left_key_(left_key), l_exclusive_(l_exclusive),
-          right_key_(right_key), r_exclusive_(r_exclusive) {}
+              std::string_view left_key, bool l_exclusive,
+              std::string_view right_key, bool r_exclusive,
+              uint32_t limit = 0, bool reverse = false)
+        : ope_(ope), left_key_(left_key), right_key_(right_key),
+          l_exclusive_(l_exclusive), r_exclusive_(r_exclusive),
+          limit_(limit), reverse_(reverse) {}
 
 
     // bool operator<(const Procedure &right) const {
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "../../cassa_common/db_key.h"
+#include "../../cassa_common/db_value.h"
+#include "../../cassa_common/db_tid.h"
+
+/**
+ * @struct Tombstone
+ * @brief Record deleted by a committed transaction, waiting to be removed from Masstree
+ *
+ * @note  writePhase() only marks a deleted record absent. The worker that committed the
+ *        delete keeps a Tombstone of it, and TxExecutor::purgeTombstones() removes the
+ *        record from Masstree once the delete epoch is older than every worker epoch.
+ *        tidword_ is the TID word stored by the delete, if the record has been locked or
+ *        written since then, the tombstone is no longer valid.
+ */
+struct Tombstone {
+    Key key_;
+    Value *value_;
+    TIDword tidword_;
+
+    Tombstone(const Key &key, Value *value, const TIDword &tidword)
+        : key_(key), value_(value), tidword_(tidword) {}
+};
@@ -1,7 +1,9 @@
 #pragma once
 
 #include <vector>
+#include <deque>
 #include <cstdint>
+#include <string_view>
 #include <algorithm>
 
 #include "../../cassa_common/status.h"
@@ -9,6 +11,7 @@
 #include "../../cassa_common/db_value.h"
 #include "../../cassa_common/db_tid.h"
 #include "../../cassa_common/atomic_wrapper.h"
+#include "../../cassa_common/structures.h"
 
 
 #include "silo_element.h"
@@ -16,6 +19,10 @@
 #include "silo_log.h"
 #include "silo_notifier.h"
 #include "silo_log_buffer.h"
+#include "silo_op_set_index.h"
+#include "silo_arena.h"
+#include "silo_tombstone.h"
+#include "silo_contention.h"
 
 #include <openssl/ssl.h>
 
@@ -31,15 +38,23 @@ public:
     // operation sets
     std::vector<ReadElement> read_set_;
     std::vector<WriteElement> write_set_;
+    // hash indexes of large operation sets, every emplace_back to a set must be followed by add()
+    OpSetIndex<ReadElement> read_set_index_;
+    OpSetIndex<WriteElement> write_set_index_;
+    // staged new values of write_set_, rewound by begin()
+    // NOTE: the sets are cleared (not freed) between transactions, so they keep their capacity
+    TransactionArena arena_;
 
     // procedure sets
     std::vector<Procedure> pro_set_;
 
-    // session id
-    std::string session_id_;
+    // session handle
+    SessionHandle session_handle_;
+    uint64_t session_tx_id_ = 0;    // per-session sequence number of the request (0 = not pipelined)
 
     // transaction status
     TransactionStatus status_;
+    AbortReason abort_reason_;      // why validationPhase() aborted the transaction
     size_t worker_thid_;
     size_t logger_thid_;
     // should I implement result object?
@@ -54,38 +69,47 @@ public:
     // for logging
     LogBufferPool log_buffer_pool_;
     NotificationId nid_;
-    uint32_t nid_counter_ = 0;
 
     // for garbage collection
     GarbageCollector gc_;
+    // records deleted by this worker, in order of the delete epoch
+    std::deque<Tombstone> tombstones_;
+    uint64_t last_purge_epoch_ = 0;
 
-    TxExecutor(size_t worker_thid) : worker_thid_(worker_thid) {
+    // for contention management
+    ContentionPolicy contention_policy_;
+    AbortBackoff backoff_{contention_policy_};
+    uint64_t lock_waits_ = 0;       // records lockWriteSet() locked after waiting, read and cleared by the caller
+
+    TxExecutor(size_t worker_thid, const ContentionPolicy &contention_policy)
+        : worker_thid_(worker_thid), contention_policy_(contention_policy) {
         read_set_.clear();
         write_set_.clear();
         pro_set_.clear();
-        session_id_ = "";
+        session_handle_ = INVALID_SESSION_HANDLE;
 
         max_rset_.obj_ = 0;
         max_wset_.obj_ = 0;
     }
 
     // トランザクションのライフサイクル管理
-    void begin(std::string session_id); // トランザクションの開始
+    void begin(SessionHandle session_handle, uint64_t session_tx_id); // トランザクションの開始
     void abort(); // トランザクションの中止
     bool commit(); // トランザクションのコミット
     
     // トランザクションの操作
-    Status insert(std::string &str_key, std::string &str_value);
-    Status tx_delete(std::string &str_key); // deleteは予約語なのでtx_delete
-    Status read(std::string &str_key, std::string &retrun_value);
+    Status insert(std::string_view str_key, std::string_view str_value);
+    Status tx_delete(std::string_view str_key); // deleteは予約語なのでtx_delete
+    Status read(std::string_view str_key, std::string &retrun_value);
     Status read_internal(Key &key, Value *value);
-    Status write(std::string &str_key, std::string &str_value);
-    Status scan(std::string str_left_key, bool l_exclusive,
-                std::string str_right_key, bool r_exclusive,
-                std::vector<std::pair<std::string, std::string>> &result);
+    Status write(std::string_view str_key, std::string_view str_value);
+    Status scan(std::string_view str_left_key, bool l_exclusive,
+                std::string_view str_right_key, bool r_exclusive,
+                std::vector<std::pair<std::string, std::string>> &result,
+                size_t limit = 0, bool reverse = false);
     
     // 並行制御とロック管理
-    void lockWriteSet(); // 書き込みセットのロック
+    void lockWriteSet(); // 書き込みセットのロック (ロックされていれば一定時間待つ)
     void unlockWriteSet(); // 書き込みセットのアンロック
     void unlockWriteSet(std::vector<WriteElement>::iterator end); // 指定位置までの書き込みセットのアンロック
     bool validationPhase(); // 検証フェーズの実行
@@ -99,8 +123,9 @@ public:
     void leaderWork(); // リーダーの作業
     void epochWork(uint64_t &epoch_timer_start, uint64_t &epoch_timer_stop); // エポックの作業
     void durableEpochWork(uint64_t &epoch_timer_start, uint64_t &epoch_timer_stop, const bool &quit); // 永続的なエポックの作業
+    void purgeTombstones(WorkerResult &result); // 削除済みレコードのMasstreeからの除去
     
     // 内部処理とヘルパーメソッド
-    ReadElement *searchReadSet(Key &key); // 読み取りセットの検索
-    WriteElement *searchWriteSet(Key &key); // 書き込みセットの検索
+    ReadElement *searchReadSet(Key &key); // 読み取りセットの検索 (OpSetIndex)
+    WriteElement *searchWriteSet(Key &key); // 書き込みセットの検索 (OpSetIndex)
 };
\ No newline at end of file
@@ -60,4 +60,5 @@ inline static void waitTime_ns(const uint64_t time) {
 }
 
 extern bool chkEpochLoaded();
+extern uint64_t reclaimableEpoch();
 extern void siloLeaderWork(uint64_t &epoch_timer_start, uint64_t &epoch_timer_stop);
\ No newline at end of file
@@ -13,9 +13,9 @@
 void LogBuffer::push(std::uint64_t tid, NotificationId &nid, std::vector<WriteElement> &write_set) {
     // create log records
     for (auto &itr : write_set) {
-        std::string key = itr.key_.uint64t_to_string(itr.key_.slices, itr.key_.lastSliceSize);
-        std::string val = itr.get_new_value_body();
-        log_set_.emplace_back(tid, itr.op_, key, val);
+        // the staged value is copied once, the log buffer outlives the transaction
+        log_set_.emplace_back(tid, itr.op_, itr.key_.uint64t_to_string(itr.key_.slices, itr.key_.lastSliceSize),
+                              itr.get_new_value_body());
         log_set_size_++;
     }
 
@@ -278,6 +278,19 @@ bool LogBufferPool::is_ready() {
     return r;
 }
 
+/**
+ * @brief Waits until `is_ready()` holds.
+ * 
+ * @details All the buffers are held by the logger while it writes them, so the worker
+ * spins, backs off and then parks until `return_buffer()` wakes it (`IdleStrategy`).
+ */
+void LogBufferPool::wait_ready() {
+    IdleStrategy idle_strategy;
+    while (!is_ready()) {
+        idle_strategy.idle(spot_, [this]{ return is_ready(); }, WORKER_PARK_TIMEOUT_US);
+    }
+}
+
 /**
  * @brief Pushes a set of write operations into the current buffer.
  * 
@@ -285,8 +298,7 @@ bool LogBufferPool::is_ready() {
  * (`MAX_BUFFERED_LOG_ENTRIES`) or if a new epoch is beginning (`new_epoch_begins`). If either condition is 
  * true, the `publish()` method is called.
  * 
- * Subsequently, the method waits until the `current_buffer_` is available and ready for use by repeatedly 
- * checking `is_ready()` and pausing for 10,000 ns (10 ms) if not ready. 
+ * Subsequently, the method waits until the `current_buffer_` is available and ready for use (`wait_ready()`).
  * 
  * If the `LogBufferPool` is in a quitting state (`quit_` is true), the method returns early. 
  * Otherwise, the set of write operations (`write_set`) is pushed into the `current_buffer_`.
@@ -307,8 +319,8 @@ void LogBufferPool::push(std::uint64_t tid, NotificationId &nid, std::vector<Wri
         publish();
     }
 
-    // Pause and wait for 10,000 ns (10 ms) until current_buffer_ is available and ready for use
-    while (!is_ready()) waitTime_ns(10*1000);
+    // Wait until current_buffer_ is available and ready for use
+    wait_ready();
 
     // If the LogBufferPool is quitting, return
     if (quit_) return;
@@ -327,7 +339,7 @@ void LogBufferPool::push(std::uint64_t tid, NotificationId &nid, std::vector<Wri
  * Any analysis-related operations are omitted in this implementation.
  */
 void LogBufferPool::publish() {
-    while (!is_ready()) waitTime_ns(5*1000);
+    wait_ready();
     assert(current_buffer_ != NULL);
 
     // enqueue
@@ -347,6 +359,7 @@ void LogBufferPool::return_buffer(LogBuffer *lb) {
     my_lock();
     pool_.emplace_back(lb);
     my_unlock();
+    spot_.wake();
 }
 
 /**
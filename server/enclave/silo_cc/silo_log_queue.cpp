@@ -2,7 +2,6 @@
 
 LogQueue::LogQueue() {
     quit_.store(false);
-    data_added_.store(false);
     // timeout_ = std::chrono::microseconds((int)(EPOCH_TIME*1000));
     timeout_us_ = (int)EPOCH_TIME*1000;
 }
@@ -34,8 +33,8 @@ void LogQueue::enq(LogBuffer* x) {
         std::lock_guard<std::mutex> lock(mutex_);
         auto &v = queue_[x->min_epoch_];
         v.emplace_back(x);
-        data_added_.store(true);
     }
+    spot_.wake();
 }
 
 /**
@@ -44,6 +43,9 @@ void LogQueue::enq(LogBuffer* x) {
  * @details Checks for available `LogBuffer` in the `queue_` or whether `quit_` 
  * is set, returning `true` if either condition is met. If neither condition 
  * is met within a specified timeout duration, it returns `false`.
+ * While waiting, the logger spins, backs off and then parks until `enq()` or
+ * `terminate()` wakes it (`IdleStrategy`), but never beyond the timeout since
+ * the caller has to advance the durable epoch.
  * 
  * @return True if a `LogBuffer` is ready to be dequeued or `quit_` is set; 
  * false if the operation times out.
@@ -52,22 +54,20 @@ bool LogQueue::wait_deq() {
     uint64_t start_time = rdtscp();
     uint64_t elapsed_time = 0;
     uint64_t timeout_cycles = timeout_us_ * CLOCKS_PER_US;
+    IdleStrategy idle_strategy;
+    auto ready = [this]{ return quit_.load() || !queue_.empty(); };
 
     // cv_deq_.wait_for(lock, timeout_us_, [this]{return quit_.load() || !queue_.empty();}); を自前で実装
     while (true) {
         // 終了条件
-        if (quit_.load() || !queue_.empty()) return true;
+        if (ready()) return true;
 
         // タイムアウト
         elapsed_time = rdtscp() - start_time;
         if (elapsed_time > timeout_cycles) return false;
-        // LogQueue::enq()によってデータが追加されたかどうか(notify_one()の代わり)
-        if (data_added_.load()) {
-            if (quit_.load() || !queue_.empty()) {
-                data_added_.store(false);
-                return true;
-            }
-        }
+
+        // LogQueue::enq()によってデータが追加されるまで待機する(notify_one()の代わり)
+        idle_strategy.idle(spot_, ready, (timeout_cycles - elapsed_time) / CLOCKS_PER_US);
     }
 }
 
@@ -156,10 +156,9 @@ uint64_t LogQueue::min_epoch() {
 /**
  * @brief Initiates the termination of the log queue's operation.
  * 
- * @details Sets the `quit_` flag to `true` and unlocks the logging mutex. 
- *          Note that notification to any waiting threads is commented out.
+ * @details Sets the `quit_` flag to `true` and wakes the logger if it is parked.
  */
 void LogQueue::terminate() {
     quit_.store(true);
-    data_added_.store(true);    // TODO: 元々notify_all()があった場所なんだけど、これで十分か？
+    spot_.wake();   // 元々notify_all()があった場所
 }
\ No newline at end of file
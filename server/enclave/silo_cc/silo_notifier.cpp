@@ -12,8 +12,8 @@
 #include "../cassa_server.h"    // for ssl_session_handler
 #include "../../../common/openssl_utility_enclave.h" // for tls communication
 #include "../../../common/common.h" // for t_print
-#include "../cassa_common/ssl_session_handler.hpp" // for SSLSession
-#include "../cassa_common/json_message_formats.hpp" // for create_message
+#include "../cassa_common/ssl_session_handler.hpp" // for SSLSessionHandler
+#include "../cassa_common/json_message_formats.hpp" // for serialize_message
 
 /**
  * @brief Writes the (durable) epoch to the file.
@@ -47,29 +47,40 @@ void NidBuffer::store(std::vector<NotificationId> &nid_buffer, std::uint64_t epo
 }
 
 // NOTE: NotifyStatsはデータ取得用なので削除
+/**
+ * @brief Notifies the clients of all transactions whose epoch is durable.
+ * 
+ * @param min_dl The minimum durable epoch.
+ * 
+ * @details
+ * The messages of the released epochs are grouped per session and written
+ * with a single TLS write per session (see append_framed_message()), instead
+ * of one encryption and one send OCALL per committed transaction.
+ * Within a session the messages keep the order of their epochs.
+ */
 void NidBuffer::notify(std::uint64_t min_dl) {
     if (front_ == NULL) return;
 
+    // each logger owns its NidBuffer, so batches_ is only touched by the logger thread
+    batches_.clear();
+
     NidBufferItem *orig_front = front_;
     while (front_->epoch_ <= min_dl) {
         for (auto &nid : front_->buffer_) {
             // notify client here
             nid.tx_commit_time_ = rdtscp();
-            SSLSession *session = ssl_session_handler.getSession(nid.session_id_);
-            if (session == nullptr) {
-                // TODO: Notify if the client's session does not exist on the server
-                t_print("session == nullptr\n");
-                continue;
-            } else {
-                // create json format of message
-                nlohmann::json json_message = create_message(0, "Notifier: OK", nid.read_key_value_pairs);
-                std::string json_message_dump = json_message.dump();
-
-                // send message to client
-                SSL *ssl = session->ssl_session;
-                std::lock_guard<std::mutex> lock(*session->ssl_session_mutex);
-                tls_write_to_session_peer(ssl, json_message_dump); 
+
+            // look up the session once per batch
+            auto result = batches_.try_emplace(nid.session_handle_);
+            SessionBatch &batch = result.first->second;
+            if (result.second) {
+                batch.wire_format = ssl_session_handler.getWireFormat(nid.session_handle_);
             }
+
+            // create message in the format negotiated by the session
+            append_framed_message(batch.framed_messages,
+                                  serialize_message(batch.wire_format, 0, "Notifier: OK", nid.read_key_value_pairs, nid.session_tx_id_));
+            batch.num_messages++;
         }
 
         // clear buffer
@@ -87,6 +98,15 @@ void NidBuffer::notify(std::uint64_t min_dl) {
         end_->next_ = NULL;                 // end_(最後尾の元front_)の次をnullにする
         if (front_ == orig_front) break;
     }
+
+    // send messages to clients, one TLS write per session (O(1) lookup by session handle)
+    for (auto &entry : batches_) {
+        if (!ssl_session_handler.writeFramedToSession(entry.first, entry.second.framed_messages,
+                                                       static_cast<uint32_t>(entry.second.num_messages))) {
+            // TODO: Notify if the client's session does not exist on the server
+            t_print("session == nullptr, %zu notifications dropped\n", entry.second.num_messages);
+        }
+    }
 }
 
 
@@ -1,27 +1,32 @@
 #include "include/silo_transaction.h"
 
 // トランザクションのライフサイクル管理
-void TxExecutor::begin(std::string session_id) {
+void TxExecutor::begin(SessionHandle session_handle, uint64_t session_tx_id) {
     status_ = TransactionStatus::InFlight;
     max_wset_.obj_ = 0;
     max_rset_.obj_ = 0;
     read_set_.clear();
     write_set_.clear();
+    read_set_index_.clear();
+    write_set_index_.clear();
+    arena_.reset();     // the write set referring to the arena has been cleared
 
-    nid_ = NotificationId(session_id, nid_counter_++, rdtscp());
+    nid_ = NotificationId(session_handle, session_tx_id, rdtscp());
 }
 
 void TxExecutor::abort() {
     // remove inserted records
     for (auto &we : write_set_) {
         if (we.op_ == OpType::INSERT) {
+            // NOTE: concurrent readers may have found the value, masstree retires it to gc_ instead of deleting it here
             masstree.remove_value(we.key_, gc_);
-            delete we.value_;  // insertでwrite_set_に作成したvalue_を渡しているのでここでdeleteできる
         }
     }
 
     read_set_.clear();
     write_set_.clear();
+    read_set_index_.clear();
+    write_set_index_.clear();
 }
 
 bool TxExecutor::commit() {
@@ -35,36 +40,36 @@ bool TxExecutor::commit() {
 
 // トランザクションの操作
 
-Status TxExecutor::insert(std::string &str_key, std::string &str_value) {
+Status TxExecutor::insert(std::string_view str_key, std::string_view str_value) {
     Key key(str_key);
 
     // If the key already exists in write_sets_, return WARN_ALREADY_EXISTS.
     if (searchWriteSet(key)) return Status::WARN_ALREADY_EXISTS;
 
-    // If the key already exists in masstree, return WARN_ALREADY_EXISTS.
-    Value *found_value = masstree.get_value(key);
-    if (found_value != nullptr) return Status::WARN_ALREADY_EXISTS;
-
     // absent bitが立っているvalueを作成して、Masstreeに挿入する
-    Value *value = new Value(str_value);
+    // If the key already exists in masstree, the existing value is returned and WARN_ALREADY_EXISTS is returned.
+    Value *value = Value::create(str_value);
     value->tidword_.init();
 
-    Status status = masstree.insert_value(key, value, gc_);
-    if (status == Status::WARN_ALREADY_EXISTS) {
-        delete value;
-        return status;
+    Value *found_value = masstree.insert_or_get(key, value, gc_);
+    if (found_value != value) {
+        Value::destroy(value);
+        return Status::WARN_ALREADY_EXISTS;
     }
 
     // `absent state and with TID 0`としてread_set_に追加する(横取り防止のため)
     read_set_.emplace_back(key, value, value->tidword_);
+    read_set_index_.add(read_set_);
     // write_set_は指定したvalueのbody_(std::string)をstr_valueで更新する
     // insertの場合、value->body_ == str_valueだけど、write_set_の形式に合わせることで、writePhase()での処理を共通化してる
-    write_set_.emplace_back(key, value, str_value, OpType::INSERT);
+    // NOTE: the new record already holds the value, stage a view of it instead of a copy
+    write_set_.emplace_back(key, value, value->body(), OpType::INSERT);
+    write_set_index_.add(write_set_);
 
     return Status::OK;
 }
 
-Status TxExecutor::tx_delete(std::string &str_key) {
+Status TxExecutor::tx_delete(std::string_view str_key) {
     Key key(str_key);
     Value *found_value = nullptr;
 
@@ -91,12 +96,13 @@ Status TxExecutor::tx_delete(std::string &str_key) {
         }
     }
 
-    write_set_.emplace_back(key, found_value, "", OpType::DELETE);
+    write_set_.emplace_back(key, found_value, std::string_view(), OpType::DELETE);
+    write_set_index_.add(write_set_);
 
     return Status::OK;
 }
 
-Status TxExecutor::read(std::string &str_key, std::string &retrun_value) {
+Status TxExecutor::read(std::string_view str_key, std::string &retrun_value) {
     // Place variables before the first goto instruction to avoid "crosses initialization of ..." error under -fpermissive.
     Key key(str_key);
     Value *found_value; // TODO: found_valueを返すべきか？
@@ -127,7 +133,7 @@ Status TxExecutor::read(std::string &str_key, std::string &retrun_value) {
         return status;
     }
 
-    retrun_value = found_value->body_;
+    retrun_value = found_value->body();
 
 FINISH_READ:
     return Status::OK;
@@ -170,6 +176,7 @@ Status TxExecutor::read_internal(Key &key, Value *value) {
     }
 
     read_set_.emplace_back(key, value, expected);
+    read_set_index_.add(read_set_);
     return Status::OK;
 }
 
@@ -180,61 +187,66 @@ Status TxExecutor::read_internal(Key &key, Value *value) {
  * @param l_exclusive Flag indicating whether the starting key is exclusive (true) or inclusive (false).
  * @param str_right_key The ending key of the scan range, as a string.
  * @param r_exclusive Flag indicating whether the ending key is exclusive (true) or inclusive (false).
- * @param result Reference to a vector where the scan results will be stored as pairs of strings.
+ * @param result Reference to a vector where the scan results will be stored as pairs of strings, in key order.
+ * @param limit The maximum number of pairs to return, 0 for no limit.
+ * @param reverse Scan from str_right_key down to str_left_key (descending order), e.g. for "top N" queries.
  * @return Status::OK if the scan operation completes successfully, or an appropriate error status otherwise.
+ *
+ * @note The tree is walked with a MasstreeIterator and the walk stops as soon as limit pairs have been
+ *       collected, so a limited scan only reads the records it returns. Records deleted by this or
+ *       another transaction are skipped and do not count towards the limit.
  */
-Status TxExecutor::scan(std::string str_left_key, bool l_exclusive,
-                        std::string str_right_key, bool r_exclusive,
-                        std::vector<std::pair<std::string, std::string>> &result) {
+Status TxExecutor::scan(std::string_view str_left_key, bool l_exclusive,
+                        std::string_view str_right_key, bool r_exclusive,
+                        std::vector<std::pair<std::string, std::string>> &result,
+                        size_t limit, bool reverse) {
     // Clear any existing results
     result.clear();
-    auto read_set_init_size = read_set_.size();
 
     // Convert string keys to Key objects for scanning
     Key left_key_obj(str_left_key);
     Key right_key_obj(str_right_key);
 
-    // Store scan results temporarily
-    std::vector<std::pair<Key, Value*>> scan_result;
+    MasstreeIterator itr = masstree.iterator();
+    if (!reverse) {
+        itr.seek(left_key_obj, l_exclusive);
+    } else {
+        itr.seek_for_prev(right_key_obj, r_exclusive);
+    }
 
-    // Perform the scan operation on the masstree
-    masstree.scan(left_key_obj, l_exclusive, right_key_obj, r_exclusive, scan_result);
+    for (; itr.valid(); reverse ? itr.prev() : itr.next()) {
+        if (limit != 0 && result.size() >= limit) break;
+        Key key = itr.key();
+        // Stop at the other end of the range
+        if (!reverse && (right_key_obj < key || (r_exclusive && key == right_key_obj))) break;
+        if (reverse && (key < left_key_obj || (l_exclusive && key == left_key_obj))) break;
 
-    for (auto &pair : scan_result) {
         // Check if the key is in the read set
-        ReadElement *readElement = searchReadSet(pair.first);
+        ReadElement *readElement = searchReadSet(key);
         if (readElement) {
             // If found, use the value from the read set
-            std::string key_str = pair.first.uint64t_to_string(pair.first.slices, pair.first.lastSliceSize);
-            result.emplace_back(key_str, readElement->value_->body_);
+            result.emplace_back(key.uint64t_to_string(key.slices, key.lastSliceSize), readElement->value_->body());
             continue;
         }
 
         // Check if the key is in the write set
-        WriteElement *writeElement = searchWriteSet(pair.first);
+        WriteElement *writeElement = searchWriteSet(key);
         if (writeElement) {
-            // If found, use the new value from the write set
-            std::string key_str = pair.first.uint64t_to_string(pair.first.slices, pair.first.lastSliceSize);
-            result.emplace_back(key_str, writeElement->get_new_value_body());
+            // If found, use the new value from the write set (a record deleted by this transaction is skipped)
+            if (writeElement->op_ != OpType::DELETE) {
+                result.emplace_back(key.uint64t_to_string(key.slices, key.lastSliceSize), writeElement->get_new_value_body());
+            }
             continue;
         }
 
-        // If not found in local sets, check the actual value and add to results and read_set_ (read_set_では重複が許容されているっぽい？)
-        Status status = read_internal(pair.first, pair.second);
-        if (status != Status::OK && status != Status::WARN_NOT_FOUND) {
-            return status;
-        }
-    }
-
-    // Add any new entries from the read set to the result if read set was modified during the scan
-    if (read_set_init_size != read_set_.size()) {
-        for (auto itr = read_set_.begin() + read_set_init_size; itr != read_set_.end(); itr++) {
-            std::string key_str = itr->key_.uint64t_to_string(itr->key_.slices, itr->key_.lastSliceSize);
-            result.emplace_back(key_str, itr->value_->body_);
-        }
+        // If not found in local sets, check the actual value and add it to read_set_
+        Status status = read_internal(key, itr.value());
+        if (status == Status::WARN_NOT_FOUND) continue;     // absent (deleted) record
+        if (status != Status::OK) return status;
+        result.emplace_back(key.uint64t_to_string(key.slices, key.lastSliceSize), read_set_.back().value_->body());
     }
 
-  return Status::OK;
+    return Status::OK;
 }
 
 /**
@@ -246,7 +258,7 @@ Status TxExecutor::scan(std::string str_left_key, bool l_exclusive,
  * 
  * @note In this implementation, records are registered in TxExecutor's write_set_, and during the commit phase, the records are updated based on the information in write_set_
  */
-Status TxExecutor::write(std::string &str_key, std::string &str_value) {
+Status TxExecutor::write(std::string_view str_key, std::string_view str_value) {
     Key key(str_key);
     Value *found_value;
 
@@ -261,7 +273,8 @@ Status TxExecutor::write(std::string &str_key, std::string &str_value) {
         if (found_value == nullptr) return Status::WARN_NOT_FOUND;
     }
 
-    write_set_.emplace_back(key, found_value, str_value, OpType::WRITE);
+    write_set_.emplace_back(key, found_value, arena_.copy(str_value), OpType::WRITE);
+    write_set_index_.add(write_set_);
 
     return Status::OK;
 }
@@ -273,7 +286,10 @@ Status TxExecutor::write(std::string &str_key, std::string &str_value) {
  * of INSERT.
  * 
  * @note If a write-write conflict is detected (i.e. another transaction has
- * already locked the object), this transaction is immediately aborted.
+ * already locked the object), the method waits for the lock at most
+ * contention_policy_.lock_wait_spins pause iterations and then aborts the
+ * transaction. The write set is sorted, so all workers lock records in the
+ * same order and waiting cannot deadlock.
  */
 void TxExecutor::lockWriteSet() {
     TIDword expected, desired;
@@ -281,15 +297,24 @@ void TxExecutor::lockWriteSet() {
     for (auto itr = write_set_.begin(); itr != write_set_.end(); itr++) {
         if (itr->op_ == OpType::INSERT) continue;
         expected.obj_ = loadAcquire((*itr).value_->tidword_.obj_);
+        uint32_t spins = 0;
         for (;;) {
-            if (expected.lock) {
-                status_ = TransactionStatus::Aborted; // write-write conflict is immediately aborted
+            if (expected.lock && expected.latest && spins < contention_policy_.lock_wait_spins) {
+                // write-write conflict, wait a little for the other transaction to release the lock
+                spins++;
+                __builtin_ia32_pause();
+                expected.obj_ = loadAcquire((*itr).value_->tidword_.obj_);
+            } else if (expected.lock || !expected.latest) {
+                // the lock has not been released in time, or the record has been purged from masstree (purgeTombstones)
+                status_ = TransactionStatus::Aborted;
+                abort_reason_ = AbortReason::ValidationPhase1;
                 if (itr != write_set_.begin()) unlockWriteSet(itr);
                 return;
             } else {
                 desired = expected;
                 desired.lock = 1;
                 if (compareExchange((*itr).value_->tidword_.obj_, expected.obj_, desired.obj_)) {
+                    if (spins != 0) lock_waits_++;
                     break;
                 }
             }
@@ -332,7 +357,9 @@ bool TxExecutor::validationPhase() {
     // === Phase 1 ===
     // sort and lock write_set_
     sort(write_set_.begin(), write_set_.end());
+    write_set_index_.rebuild(write_set_);   // positions have changed
     lockWriteSet();
+    if (status_ == TransactionStatus::Aborted) return false;   // lockWriteSet() has released its locks
 
     // update thread local epoch
     asm volatile("":: : "memory");
@@ -353,16 +380,24 @@ bool TxExecutor::validationPhase() {
             (*itr).get_tidword().epoch != check.epoch || 
             (*itr).get_tidword().TID != check.TID) {
             status_ = TransactionStatus::Aborted;
+            abort_reason_ = AbortReason::ValidationPhase2;
             unlockWriteSet();
             return false;
         }
 
         // [2]
-        // if (!check.latest) return false;
+        // the record has been purged from masstree (purgeTombstones)
+        if (!check.latest) {
+            status_ = TransactionStatus::Aborted;
+            abort_reason_ = AbortReason::ValidationPhase2;
+            unlockWriteSet();
+            return false;
+        }
 
         // [3]
         if (check.lock && !searchWriteSet((*itr).key_)) {
             status_ = TransactionStatus::Aborted;
+            abort_reason_ = AbortReason::ValidationPhase3;
             unlockWriteSet();
             return false;
         }
@@ -404,13 +439,13 @@ void TxExecutor::writePhase() {
     // write ahead logging
     wal(maxtid.obj_);
 
-    // TODO: old_valueはnewでヒープ領域に作成しているから、garbage collectionに回さないといけないのでは？
     // write
     for (auto itr = write_set_.begin(); itr != write_set_.end(); itr++) {
         // update and unlock
         switch ((*itr).op_) {
             case OpType::WRITE:
-                itr->value_->body_ = itr->get_new_value_body();
+                // an inline body is rewritten in place (readers validate the TID word), a separate one is replaced and retired
+                gc_.add(itr->value_->update_body(itr->get_new_value_body()));
                 storeRelease(itr->value_->tidword_.obj_, maxtid.obj_);
                 break;
             case OpType::INSERT:
@@ -420,6 +455,7 @@ void TxExecutor::writePhase() {
             case OpType::DELETE:
                 maxtid.absent = true;
                 storeRelease(itr->value_->tidword_.obj_, maxtid.obj_);
+                tombstones_.emplace_back(itr->key_, itr->value_, maxtid);   // removed from masstree by purgeTombstones()
                 break;
             default:
                 assert(false);  // unreachable
@@ -483,6 +519,8 @@ void TxExecutor::durableEpochWork(uint64_t &epoch_timer_start, uint64_t &epoch_t
             // Publish the log buffer.
             log_buffer_pool_.publish();
         }
+        // Free the objects this worker retired that no worker can reach anymore.
+        gc_.run(reclaimableEpoch());
     }
 
     // Wait until the log buffer pool is ready, performing epoch work in the meantime.
@@ -499,16 +537,71 @@ void TxExecutor::durableEpochWork(uint64_t &epoch_timer_start, uint64_t &epoch_t
     // sres_lg_->local_wait_depoch_latency_ += rdtscp() - t;
 }
 
-ReadElement* TxExecutor::searchReadSet(Key& key) {
-    for (auto& re : read_set_) {
-        if (re.key_ == key) return &re;
+/**
+ * @brief Remove the records deleted by this worker from Masstree
+ *
+ * @param result Worker statistics, the purged records and the bytes retired with them are added to it
+ *
+ * @note  A tombstone is purged once its delete epoch is older than reclaimableEpoch(), i.e.
+ *        no worker is running a transaction that started before the delete committed.
+ *        The record is locked, removed from Masstree and unlocked with latest = 0, so a
+ *        transaction that still holds it in its read or write set aborts in validationPhase().
+ *        remove_value() retires the Value and the body is exchanged for the empty one and
+ *        retired as well, so both are freed by gc_ once no reader can reach them (the purged
+ *        bytes are retired, not yet freed, when they are counted).
+ *        Runs at most once per reclamation epoch and purges at most
+ *        TOMBSTONE_PURGE_BATCH_SIZE records, so it never stalls the worker for long.
+ */
+void TxExecutor::purgeTombstones(WorkerResult &result) {
+    if (tombstones_.empty()) return;
+    uint64_t reclaim_epoch = reclaimableEpoch();
+    if (reclaim_epoch == last_purge_epoch_) return;
+    last_purge_epoch_ = reclaim_epoch;
+
+    uint64_t purged_records = 0;
+    uint64_t purged_bytes = 0;
+    while (!tombstones_.empty() && purged_records < TOMBSTONE_PURGE_BATCH_SIZE) {
+        Tombstone &tombstone = tombstones_.front();
+        if (tombstone.tidword_.epoch >= reclaim_epoch) break;   // the rest is newer
+
+        TIDword expected, desired;
+        expected.obj_ = loadAcquire(tombstone.value_->tidword_.obj_);
+        if (expected.lock) break;   // a transaction is writing it, retry in the next epoch
+        if (expected != tombstone.tidword_) {
+            // written again since the delete, whoever did it is responsible for the record now
+            tombstones_.pop_front();
+            continue;
+        }
+        desired = expected;
+        desired.lock = 1;
+        if (!compareExchange(tombstone.value_->tidword_.obj_, expected.obj_, desired.obj_)) break;
+
+        // remove_value() retires the Value, count its bytes only if this purge removed it
+        const size_t footprint = tombstone.value_->footprint();
+        const bool removed = (masstree.remove_value(tombstone.key_, gc_) == Status::OK);
+        gc_.add(tombstone.value_->exchange_body(ValueBody::empty()));
+        if (removed) purged_bytes += footprint;
+
+        desired.lock = 0;
+        desired.latest = 0;
+        storeRelease(tombstone.value_->tidword_.obj_, desired.obj_);
+
+        tombstones_.pop_front();
+        purged_records++;
     }
-    return nullptr;
+
+    if (purged_records == 0) return;
+    WorkerResult::add(result.local_purged_record_count_, purged_records);
+    WorkerResult::add(result.local_purged_byte_count_, purged_bytes);
+    t_print(LOG_DEBUG "wID: %lu | Purged %lu deleted records (%lu bytes), total: %lu records (%lu bytes), pending: %lu\n",
+            worker_thid_, purged_records, purged_bytes,
+            result.local_purged_record_count_, result.local_purged_byte_count_, tombstones_.size());
+}
+
+ReadElement* TxExecutor::searchReadSet(Key& key) {
+    return read_set_index_.find(read_set_, key);
 }
 
 WriteElement *TxExecutor::searchWriteSet(Key &key) {
-    for (auto& we : write_set_) {
-        if (we.key_ == key) return &we;
-    }
-    return nullptr;
+    return write_set_index_.find(write_set_, key);
 }
\ No newline at end of file
@@ -1,5 +1,7 @@
 #include "include/silo_util.h"
 
+#include <algorithm>
+
 bool chkEpochLoaded() {
     uint64_t nowepo = atomicLoadGE();
     // leader_workを実行しているのはthid:0だからforは1から回している？
@@ -9,6 +11,23 @@ bool chkEpochLoaded() {
     return true;
 }
 
+/**
+ * @brief Epoch before which retired objects can be freed (GarbageCollector::run())
+ * @note  A worker stores GlobalEpoch to its ThLocalEpoch before each transaction (epochWork)
+ *        and once more in validationPhase, while it may still hold pointers from its read phase.
+ *        A pointer that was reachable when an object was retired at epoch e can therefore be
+ *        held by a worker whose ThLocalEpoch is at most e + 1, and GlobalEpoch cannot pass e + 1
+ *        until that worker has finished the transaction. Objects retired at an epoch lower
+ *        than (min ThLocalEpoch) - 1 are unreachable for every worker.
+ */
+uint64_t reclaimableEpoch() {
+    uint64_t min_epoch = __atomic_load_n(&(ThLocalEpoch[0]), __ATOMIC_ACQUIRE);
+    for (unsigned int i = 1; i < num_worker_threads; i++) {
+        min_epoch = std::min(min_epoch, __atomic_load_n(&(ThLocalEpoch[i]), __ATOMIC_ACQUIRE));
+    }
+    return min_epoch == 0 ? 0 : min_epoch - 1;
+}
+
 void siloLeaderWork(uint64_t &epoch_timer_start, uint64_t &epoch_timer_stop) {
     epoch_timer_stop = rdtscp();
     if (chkClkSpan(epoch_timer_start, epoch_timer_stop, EPOCH_TIME * CLOCKS_PER_US * 1000) && chkEpochLoaded()) {
@@ -2,6 +2,8 @@
 
 #include <cstdint>
 #include <vector>
+#include <string>
+#include <unordered_map>
 
 #include "../../../../common/common.h" // for t_print()
 #include "../../../../common/log_macros.h"
@@ -23,9 +25,16 @@ public:
 
     std::vector<RecoveryLogArchive> log_archives_;
     std::vector<RecoveryLogRecord> current_epoch_log_records_;
+    std::unordered_map<std::string, Value*> recovered_records_;    // latest value of every live key, loaded into Masstree at the end
+
+    ~RecoveryManager() {
+        // records staged by a recovery that failed before load_recovered_records()
+        for (auto &record : recovered_records_) Value::destroy(record.second);
+    }
 
     // recovery function
     int execute_recovery();
+    int load_recovered_records();
 
     bool is_valid_hex_string(const std::string &str);
 
@@ -96,21 +96,20 @@ int RecoveryManager::execute_recovery() {
             return a.tid_ < b.tid_;
         });
 
-        // Replay log records for the current epoch to reconstruct the database state
-        GarbageCollector gc;    // Placeholder for garbage collection
+        // Replay log records for the current epoch into the staged database state
         for (auto &log_record : this->current_epoch_log_records_) {
             this->processed_operation_num_++;
-            if (log_record.operation_type_ == "INSERT") {
-                Key key(log_record.key_);
-                Value *value = new Value(log_record.value_);
-                masstree.insert_value(key, value, gc);
-            } else if (log_record.operation_type_ == "WRITE") {
-                Key key(log_record.key_);
-                Value *found_value = masstree.get_value(key);
-                found_value->body_ = log_record.value_;
+            if (log_record.operation_type_ == "INSERT" || log_record.operation_type_ == "WRITE") {
+                // stage the record as the Value Masstree will hold, an overwritten value is freed at once
+                Value *&staged = this->recovered_records_[log_record.key_];
+                Value::destroy(staged);
+                staged = Value::create(log_record.value_);
             } else if (log_record.operation_type_ == "DELETE") {
-                Key key(log_record.key_);
-                masstree.remove_value(key, gc);
+                auto itr = this->recovered_records_.find(log_record.key_);
+                if (itr != this->recovered_records_.end()) {
+                    Value::destroy(itr->second);
+                    this->recovered_records_.erase(itr);
+                }
             } else {
                 t_print(BRED "Unknown operation_type_: %s\n" CRESET, log_record.operation_type_.c_str());
                 return -1;
@@ -128,6 +127,9 @@ int RecoveryManager::execute_recovery() {
         }
     }
 
+    // Build Masstree at once from the recovered records
+    if (this->load_recovered_records() != 0) return -1;
+
     // Set the global epoch to the durable epoch after recovery completion
     GlobalEpoch = this->durable_epoch_;
     t_print("\n" LOG_INFO BGRN "Recovery finished. GlobalEpoch: %lu, %lu operations successfully replayed.\n" CRESET, GlobalEpoch, this->processed_operation_num_);
@@ -167,4 +169,36 @@ uint64_t RecoveryManager::read_durable_epoch(std::string file_name) {
     }
 
     return durable_epoch;
-}
\ No newline at end of file
+}
+
+/**
+ * @brief Build Masstree from the records staged by the replay
+ *
+ * @return 0 on success, -1 if Masstree is not empty.
+ *
+ * @note The replay only keeps the latest value of each key, so the final state is known
+ *       before the tree is touched. Sorting it and building Masstree bottom-up avoids the
+ *       descent, locking and splits that inserting the records one by one would pay.
+ *       The staged Values are handed to the tree as they are, and every map entry is
+ *       erased as soon as its key has been moved to the sorted vector, so each record
+ *       exists about once (plus its key) while the tree is built.
+*/
+int RecoveryManager::load_recovered_records() {
+    std::vector<std::pair<Key, Value*>> records;
+    records.reserve(this->recovered_records_.size());
+    for (auto itr = this->recovered_records_.begin(); itr != this->recovered_records_.end();) {
+        records.emplace_back(Key(itr->first), itr->second);
+        itr = this->recovered_records_.erase(itr);
+    }
+    std::unordered_map<std::string, Value*>().swap(this->recovered_records_);   // release the buckets too
+    std::sort(records.begin(), records.end(), [](const std::pair<Key, Value*> &a, const std::pair<Key, Value*> &b) {
+        return a.first < b.first;
+    });
+
+    if (masstree.bulk_load(records) != Status::OK) {
+        t_print(LOG_ERROR "Failed to load %zu recovered records: Masstree is not empty.\n", records.size());
+        for (auto &record : records) Value::destroy(record.second);
+        return -1;
+    }
+    return 0;
+}